@@ -3,191 +3,578 @@
 
 #include "Actors/ClusterFoliageActor.h"
 
+#include "FeatureCache.h"
 #include "GenericFoliage.h"
+#include "GenericFoliageSettings.h"
+#include "GeoJSONReader.h"
+#include "GeographicTangentPlane.h"
+#include "MultiClassPoissonSampler.h"
+#include "PoissonCornerTiles.h"
 #include "SamplerLibrary.h"
+#include "VariablePoissonSampler.h"
 #include "Actors/Components/FoliageInstancedMeshPool.h"
 #include "Async/Async.h"
+#include "Async/FoliageWorkerPool.h"
 #include "Components/HierarchicalInstancedStaticMeshComponent.h"
-#include "GeometryScript/MeshSpatialFunctions.h"
+#include "GameFramework/PlayerController.h"
 #include "Kismet/KismetMathLibrary.h"
 #include "Spatial/MeshAABBTree3.h"
 
-
-class FClusterFoliageSpawnerThread : public FRunnable
+#if WITH_EDITOR
+#include "Editor.h"
+#include "EditorViewportClient.h"
+#endif
+
+/** Width of a block in sampling grid cells, about a thousand points */
+#define CLUSTER_BLOCK_CELLS 64
+
+/** Sampling grids with more cells than this are split into blocks sampled as separate jobs */
+#define CLUSTER_SPLIT_CELLS (4 * CLUSTER_BLOCK_CELLS * CLUSTER_BLOCK_CELLS)
+
+/** Points placed between checks for cancellation */
+#define CLUSTER_CANCEL_CHECK_POINTS 1024
+
+/** Parsed features handed to the game thread per task, a batch is also sent once it holds this many points */
+#define CLUSTER_LOAD_BATCH_FEATURES 256
+#define CLUSTER_LOAD_BATCH_POINTS 65536
+
+/**
+ * Spawns the foliage of one feature. The points are sampled on the foliage worker pool, large features as one job
+ * per block of their sampling grid so the work follows their area. The terrain under all of the points is queried
+ * in one batch from the game thread, then the transforms are built on the pool again.
+ *
+ * A cancelled task stops at its next check, between foliage types, blocks and batches of points, and never calls
+ * back. The actor only touches the task on the game thread and isn't destroyed while any of its jobs are in flight.
+ */
+class FClusterFoliageSpawnerTask : public TSharedFromThis<FClusterFoliageSpawnerTask, ESPMode::ThreadSafe>
 {
 public:
-	FClusterFoliageSpawnerThread(AClusterFoliageActor* InClusterFoliageActor, int32 InFeatureId,
-	                             TFunction<void(int32, TMap<FGuid, TArray<FTransform>>)> InCallback
+	FClusterFoliageSpawnerTask(AClusterFoliageActor* InClusterFoliageActor, const FSpatialFeature& InFeature,
+	                           int32 InFeatureIndex,
+	                           TFunction<void(int32, TMap<FGuid, TArray<FTransform>>)> InCallback
 	)
-		: ClusterFoliageActor(InClusterFoliageActor), FeatureId(InFeatureId),
+		: ClusterFoliageActor(InClusterFoliageActor), Feature(InFeature), FeatureIndex(InFeatureIndex),
 		  Callback(InCallback)
 	{
-		bIsRunning = true;
-		Thread = MakeShareable(FRunnableThread::Create(
-			this, TEXT("ClusterFoliageSpawnerThread")
-		));
 	}
 
-	virtual bool Init() override
+	void Start()
 	{
-		return true;
+		bEstimationTransform = ClusterFoliageActor->bEstimationTransform;
+		bUseTiledSampling = ClusterFoliageActor->bUseTiledSampling;
+		bSampleTypesJointly = ClusterFoliageActor->bSampleTypesJointly && !bUseTiledSampling;
+		Types = ClusterFoliageActor->Collection->Collection[Feature.Type].FoliageTypes;
+
+		Submit([This = AsShared()]()
+		{
+			This->Project();
+
+			if (This->bSampleTypesJointly)
+			{
+				This->SampleJointly();
+				return;
+			}
+
+			This->Sample(0);
+		});
 	}
 
-	virtual uint32 Run() override
+	/**
+	 * Samples the points of the foliage types from TypeIndex on, then asks the game thread for the terrain under
+	 * them. A type with a large sampling grid is split into blocks sampled as separate jobs, and the job finishing
+	 * its last block carries on with the next type.
+	 */
+	void Sample(int32 TypeIndex)
 	{
-		if (!IsValid(ClusterFoliageActor))
+		for (; TypeIndex < Types.Num(); ++TypeIndex)
 		{
-			bIsRunning = false;
-			return 1;
+			if (bIsCancelled)
+			{
+				return;
+			}
+
+			if (!Feature.Polygon.IsValid())
+			{
+				Finish({});
+				return;
+			}
+
+			TypeOffsets.Add(Points.Num());
+
+			const double Radius = GetTypeRadius(TypeIndex);
+			if (Radius <= 0.0)
+			{
+				continue;
+			}
+
+			if (bUseTiledSampling)
+			{
+				SampleTiles(TypeIndex, Radius);
+				continue;
+			}
+
+			if (Types[TypeIndex]->EdgeFalloffDistance > 0.f)
+			{
+				SampleFalloff(TypeIndex, Radius);
+				continue;
+			}
+
+			const TSharedRef<FPolygonPoissonSampler, ESPMode::ThreadSafe> Sampler = MakeSampler(TypeIndex, Radius);
+
+			if (Sampler->GetNumCells() > CLUSTER_SPLIT_CELLS)
+			{
+				SamplePhase(Sampler, 0, TypeIndex);
+				return;
+			}
+
+			Sampler->SampleAll();
+			AppendPoints(Sampler->GetPoints());
 		}
+		TypeOffsets.Add(Points.Num());
 
-		const FSpatialFeature Feature = ClusterFoliageActor->GetFeatureById(FeatureId);
-		TMap<FGuid, TArray<FTransform>> FoliageTransforms;
+		QueryTerrain();
+	}
+
+	/**
+	 * Samples every foliage type in one pass of the multi-class sampler, each keeping its radius from its own points
+	 * and the larger of both clearances from the other types', then asks the game thread for the terrain. The pass
+	 * can't be split into blocks, as every class depends on all of the others, so it checks for cancellation as it
+	 * grows instead
+	 */
+	void SampleJointly()
+	{
+		if (bIsCancelled)
+		{
+			return;
+		}
 
-		const bool bEstimationTransform = ClusterFoliageActor->bEstimationTransform; 
+		if (!Feature.Polygon.IsValid() || Types.Num() == 0)
+		{
+			Finish({});
+			return;
+		}
 
-		Feature.Geometry->ProcessMesh([&](const FDynamicMesh3& Mesh)
+		// Types with an edge falloff have a radius of their own over the polygon, they keep to their own sampler
+		TArray<double> Radii;
+		for (int32 TypeIndex = 0; TypeIndex < Types.Num(); ++TypeIndex)
 		{
-			const auto Bounds = Mesh.GetBounds();
-			const auto Bounds2d = FBox2d(FVector2D(Bounds.Min.X, Bounds.Min.Y), FVector2D(Bounds.Max.X, Bounds.Max.Y));
-			const double Width = Bounds.Width();
-			const double Height = Bounds.Height();
+			Radii.Add(Types[TypeIndex]->EdgeFalloffDistance > 0.f ? 0.0 : GetTypeRadius(TypeIndex));
+		}
 
-			for (const auto Type : ClusterFoliageActor->Collection->Collection[Feature.Type].FoliageTypes)
+		// One stream serves every type, so it follows the feature alone
+		FMultiClassPoissonSampler Sampler(GetSamplingPolygon(), Radii, 30,
+		                                  static_cast<int32>(GetTypeHash(Feature.Hash)));
+
+		for (int32 TypeA = 0; TypeA < Types.Num(); ++TypeA)
+		{
+			for (int32 TypeB = TypeA + 1; TypeB < Types.Num(); ++TypeB)
 			{
+				Sampler.SetClassDistance(TypeA, TypeB, FMath::Max(Types[TypeA]->Clearance, Types[TypeB]->Clearance));
+			}
+		}
 
-				TArray<FVector2D> Points;
+		if (!Sampler.Sample(&bIsCancelled))
+		{
+			return;
+		}
 
-				if (bEstimationTransform)
-				{
-					// Estimate our cell size based on the radius in metres
-					FVector2D Delta = USpatialLibrary::HaversineDeltaDegrees(
-						Bounds2d.Min, Type->Density
-					);
-				
-					Points = USamplerLibrary::PoissonDiscSampling(
-						FMath::Abs(Delta.Length()),
-						FVector2D(Width, Height),
-						30,
-						{
-							true,
-							Bounds2d.Min,
-							Type->Density
-						}
-					);
-				} else
+		for (int32 TypeIndex = 0; TypeIndex < Types.Num(); ++TypeIndex)
+		{
+			if (bIsCancelled)
+			{
+				return;
+			}
+
+			TypeOffsets.Add(Points.Num());
+
+			if (Radii[TypeIndex] > 0.0)
+			{
+				AppendPoints(Sampler.GetPoints(TypeIndex));
+				continue;
+			}
+
+			const double Radius = GetTypeRadius(TypeIndex);
+			if (Radius > 0.0 && Types[TypeIndex]->EdgeFalloffDistance > 0.f)
+			{
+				SampleFalloff(TypeIndex, Radius);
+			}
+		}
+		TypeOffsets.Add(Points.Num());
+
+		QueryTerrain();
+	}
+
+	/** Submits a job per block of the phase, the last one to finish starts the next phase */
+	void SamplePhase(const TSharedRef<FPolygonPoissonSampler, ESPMode::ThreadSafe>& Sampler, int32 Phase,
+	                 int32 TypeIndex)
+	{
+		while (Phase < FPolygonPoissonSampler::NumPhases && Sampler->GetPhaseBlocks(Phase).Num() == 0)
+		{
+			++Phase;
+		}
+
+		if (Phase == FPolygonPoissonSampler::NumPhases)
+		{
+			AppendPoints(Sampler->GetPoints());
+			Sample(TypeIndex + 1);
+			return;
+		}
+
+		if (bIsCancelled)
+		{
+			return;
+		}
+
+		const TArrayView<const int32> Blocks = Sampler->GetPhaseBlocks(Phase);
+		const TSharedRef<std::atomic<int32>, ESPMode::ThreadSafe> NumRemaining = MakeShared<
+			std::atomic<int32>, ESPMode::ThreadSafe>(Blocks.Num());
+
+		for (const int32 BlockIndex : Blocks)
+		{
+			Submit([This = AsShared(), Sampler, Phase, TypeIndex, BlockIndex, NumRemaining]()
+			{
+				if (!This->bIsCancelled)
 				{
-					Points = USamplerLibrary::PoissonDiscSampling(
-						Type->Density,
-						FVector2D(Width, Height),
-						30,
-						{
-							false,
-						}
-					);
+					Sampler->SampleBlock(BlockIndex);
 				}
 
-				for (FVector2D& Point : Points)
+				if (--*NumRemaining == 0)
 				{
-					Point += Bounds2d.Min;
+					This->SamplePhase(Sampler, Phase + 1, TypeIndex);
 				}
+			});
+		}
+	}
 
-				if (!IsValid(ClusterFoliageActor) || !IsValid(Feature.Geometry)) { return; }
+	/**
+	 * Seed of a foliage type within the feature. It follows the feature's content and the type's own seed, so the
+	 * feature spawns the same way every time it is loaded or streamed back in
+	 */
+	int32 GetTypeSeed(int32 TypeIndex) const
+	{
+		return static_cast<int32>(HashCombine(HashCombine(GetTypeHash(Feature.Hash), Types[TypeIndex]->RandomSeed),
+		                                      TypeIndex));
+	}
 
-				TArray<FVector2D> FilteredPoints;
-				TArray<FTransform> PointsWorld;
+	/**
+	 * Radius between the points of a foliage type, its density scaled by the feature's density property. The points
+	 * per area follow the property, so the radius goes with one over its square root. 0 for no points
+	 */
+	double GetTypeRadius(int32 TypeIndex) const
+	{
+		const UGenericFoliageType* Type = Types[TypeIndex];
+		const FString* Value = Type->DensityProperty.IsEmpty()
+			                       ? nullptr
+			                       : Feature.Properties.Find(Type->DensityProperty);
 
-				for (const FVector2d& Point : Points)
-				{
-					FVector Normal = FVector::Zero();
-					const double Altitude = ClusterFoliageActor->GetTerrainBaseHeight(
-						FVector(Point.X, Point.Y, 0), Normal);
+		if (Value == nullptr)
+		{
+			return Type->Density;
+		}
 
-					bool bInside = false;
+		const double Scale = FCString::Atod(**Value);
+		return Scale > 0.0 ? Type->Density / FMath::Sqrt(Scale) : 0.0;
+	}
 
-					TEnumAsByte<EGeometryScriptContainmentOutcomePins> Outcome;
+	/**
+	 * With geographic coordinates the feature is sampled in metres on its tangent plane, projected once here rather
+	 * than measuring every candidate on the sphere
+	 */
+	void Project()
+	{
+		if (bEstimationTransform && Feature.Polygon.IsValid())
+		{
+			Plane = MakeUnique<FGeographicTangentPlane>(Feature.Polygon->GetBounds().GetCenter());
+			Plane->ToLocal(*Feature.Polygon, LocalPolygon);
+		}
+	}
 
-					// Filter out points which don't intersect the geometry
-					UGeometryScriptLibrary_MeshSpatial::IsPointInsideMesh(
-						Feature.Geometry, Feature.BVH, FVector(Point.X, Point.Y, 100), {}, bInside,
-						Outcome);
+	/** The polygon the points are sampled in, the feature's own or its projection */
+	const FSpatialPolygon& GetSamplingPolygon() const
+	{
+		return Plane.IsValid() ? LocalPolygon : *Feature.Polygon;
+	}
 
-					if (!bInside)
-					{
-						continue;
-					}
+	/** Adds sampled points, mapped back to the feature's coordinates */
+	void AppendPoints(TArray<FVector2D>&& NewPoints)
+	{
+		if (Plane.IsValid())
+		{
+			for (FVector2D& Point : NewPoints)
+			{
+				Point = Plane->ToGeographic(Point);
+			}
+		}
 
-					FVector EngineLocation = ClusterFoliageActor->GeographicToEngineLocation(
-							FVector(Point.X, Point.Y, Altitude)) +
-						Type->GetRandomLocalOffset();
+		Points.Append(MoveTemp(NewPoints));
+	}
 
-					FVector UpVector = ClusterFoliageActor->GetUpVectorFromEngineLocation(EngineLocation);
-					FRotator RotationAtPoint = Type->bAlignToSurfaceNormal
-						                           ? Normal.Rotation()
-						                           : UKismetMathLibrary::MakeRotFromZ(UpVector);
+	/**
+	 * Lays the corner tiles, scaled to the type's radius, over the cells of the polygon's scanline spans. Only the
+	 * points of tiles crossing the edge are tested against the polygon
+	 */
+	void SampleTiles(int32 TypeIndex, double Radius)
+	{
+		const FSpatialPolygon& Polygon = GetSamplingPolygon();
+		const FVector2D Origin = Polygon.GetBounds().Min;
 
-					const double Angle = FMath::RadiansToDegrees(FMath::Acos(
-						Normal | UpVector
-					));
+		if (Radius <= 0.0 || Polygon.IsEmpty())
+		{
+			return;
+		}
 
-					if (Angle > Type->SlopeAngleThreshold)
-					{
-						continue;
-					}
+		TArray<FSpatialPolygonSpan> Spans;
+		int32 NumX = 0;
+		int32 NumY = 0;
+		if (!Polygon.GetScanlineSpans(FPoissonCornerTiles::GetTileSize() * Radius, Spans, NumX, NumY))
+		{
+			return;
+		}
 
-					if (Type->bEnableRandomRotation)
-					{
-						RotationAtPoint = (Type->GetRandomRotator().Quaternion() * RotationAtPoint.Quaternion()).
-							Rotator();
-					}
+		TArray<FVector2D> TilePoints;
+		TArray<FVector2D> BoundaryPoints;
+		if (!FPoissonCornerTiles::Get().FillSpans(Spans, GetTypeSeed(TypeIndex), TilePoints, &BoundaryPoints))
+		{
+			return;
+		}
+
+		for (FVector2D& Point : BoundaryPoints)
+		{
+			Point = Origin + Point * Radius;
+		}
+		Polygon.RemoveOutside(BoundaryPoints);
+
+		for (FVector2D& Point : TilePoints)
+		{
+			Point = Origin + Point * Radius;
+		}
+		TilePoints.Append(MoveTemp(BoundaryPoints));
 
-					FTransform Transform;
-					Transform.SetLocation(
-						EngineLocation
-					);
-					Transform.SetScale3D(Type->GetRandomScale());
-					Transform.SetRotation(RotationAtPoint.Quaternion());
+		AppendPoints(MoveTemp(TilePoints));
+	}
 
-					PointsWorld.Emplace(MoveTemp(Transform));
-				}
+	/**
+	 * Thins the type out towards the polygon's edge, from its radius inside to the one of its edge density at the
+	 * edge. Sampled in one go within the current job, the variable radius sampler isn't split into blocks
+	 */
+	void SampleFalloff(int32 TypeIndex, double Radius)
+	{
+		const UGenericFoliageType* Type = Types[TypeIndex];
+		const FSpatialPolygon& Polygon = GetSamplingPolygon();
+		const double EdgeRadius = Radius / FMath::Sqrt(FMath::Clamp<double>(Type->EdgeDensity, 0.01, 1.0));
+
+		FVariablePoissonSampler Sampler(
+			Polygon,
+			Radius,
+			EdgeRadius,
+			FVariablePoissonSampler::MakeEdgeFalloff(Polygon, Radius, EdgeRadius, Type->EdgeFalloffDistance),
+			30,
+			GetTypeSeed(TypeIndex)
+		);
+		Sampler.Sample();
+
+		TArray<FVector2D> SampledPoints = Sampler.GetPoints();
+		AppendPoints(MoveTemp(SampledPoints));
+	}
+
+	TSharedRef<FPolygonPoissonSampler, ESPMode::ThreadSafe> MakeSampler(int32 TypeIndex, double Radius) const
+	{
+		// Only the polygon's own spans are sampled, no points are generated just to be thrown away
+		return MakeShared<FPolygonPoissonSampler, ESPMode::ThreadSafe>(
+			GetSamplingPolygon(),
+			Radius,
+			30,
+			FPoissonDiscSamplingSettings{
+				false,
+				FVector2D::ZeroVector,
+				Radius,
+				GetTypeSeed(TypeIndex)
+			},
+			CLUSTER_BLOCK_CELLS
+		);
+	}
 
-				FoliageTransforms.Emplace(Type->GetGuid(), MoveTemp(PointsWorld));
+	/** Hands every sampled point to the game thread for its terrain, the transforms are built on the pool after */
+	void QueryTerrain()
+	{
+		AsyncTask(ENamedThreads::GameThread, [This = AsShared()]()
+		{
+			if (This->bIsCancelled)
+			{
+				return;
 			}
-		});
 
-		AsyncTask(ENamedThreads::GameThread,
-		          [Callback = this->Callback, FeatureId = this->FeatureId, FoliageTransforms]()
-		          {
-			          Callback(FeatureId, FoliageTransforms);
-		          });
-		return 0;
+			This->ClusterFoliageActor->QueryTerrainHeights(This->Points, [This](FClusterTerrainSamples&& Samples)
+			{
+				if (This->bIsCancelled)
+				{
+					return;
+				}
+
+				This->Submit([This, Samples = MoveTemp(Samples)]()
+				{
+					This->Place(Samples);
+				});
+			});
+		});
 	}
 
-	void Cancel()
+	/** Turns the points and their terrain into instance transforms and hands them to the game thread */
+	void Place(const FClusterTerrainSamples& Samples)
 	{
-		if (Thread.IsValid())
+		if (bIsCancelled)
+		{
+			return;
+		}
+
+		if (Samples.Heights.Num() != Points.Num() || Samples.Normals.Num() != Points.Num())
+		{
+			Finish({});
+			return;
+		}
+
+		TMap<FGuid, TArray<FTransform>> FoliageTransforms;
+		int32 NumMissed = 0;
+
+		for (int32 TypeIndex = 0; TypeIndex < Types.Num(); ++TypeIndex)
+		{
+			const UGenericFoliageType* Type = Types[TypeIndex];
+			TArray<FTransform> PointsWorld;
+
+			// The type's own stream is shared by every task spawning it, this one only by the type's points here
+			const FRandomStream RandomStream(GetTypeSeed(TypeIndex));
+
+			for (int32 PointIndex = TypeOffsets[TypeIndex]; PointIndex < TypeOffsets[TypeIndex + 1]; ++PointIndex)
+			{
+				if (PointIndex % CLUSTER_CANCEL_CHECK_POINTS == 0 && bIsCancelled)
+				{
+					return;
+				}
+
+				const FVector2D& Point = Points[PointIndex];
+				const FVector& Normal = Samples.Normals[PointIndex];
+				const double Altitude = Samples.Heights[PointIndex];
+
+				// The trace missed the terrain, there is no height or surface to place the instance on
+				if (Normal.IsNearlyZero())
+				{
+					++NumMissed;
+					continue;
+				}
+
+				FVector EngineLocation = ClusterFoliageActor->GeographicToEngineLocation(
+						FVector(Point.X, Point.Y, Altitude)) +
+					Type->GetRandomLocalOffset(RandomStream);
+
+				FVector UpVector = ClusterFoliageActor->GetUpVectorFromEngineLocation(EngineLocation);
+				FRotator RotationAtPoint = Type->bAlignToSurfaceNormal
+					                           ? Normal.Rotation()
+					                           : UKismetMathLibrary::MakeRotFromZ(UpVector);
+
+				const double Angle = FMath::RadiansToDegrees(FMath::Acos(
+					Normal | UpVector
+				));
+
+				if (Angle > Type->SlopeAngleThreshold)
+				{
+					continue;
+				}
+
+				if (Type->bEnableRandomRotation)
+				{
+					RotationAtPoint = (Type->GetRandomRotator(RandomStream).Quaternion() * RotationAtPoint.Quaternion()).
+						Rotator();
+				}
+
+				FTransform Transform;
+				Transform.SetLocation(
+					EngineLocation
+				);
+				Transform.SetScale3D(Type->GetRandomScale(RandomStream));
+				Transform.SetRotation(RotationAtPoint.Quaternion());
+
+				PointsWorld.Emplace(MoveTemp(Transform));
+			}
+
+			FoliageTransforms.Emplace(Type->GetGuid(), MoveTemp(PointsWorld));
+		}
+
+		if (NumMissed > 0)
 		{
-			this->Thread->Kill();
-			bIsCancelled = true;
+			UE_LOG(LogGenericFoliage, Verbose, TEXT("Skipped %i points of feature %i without terrain under them"),
+			       NumMissed, FeatureIndex);
 		}
+
+		Finish(MoveTemp(FoliageTransforms));
 	}
 
-	virtual void Exit() override
+	/** Stops the task at its next check and drops its results, game thread */
+	void Cancel()
 	{
+		bIsCancelled = true;
 	}
 
-	bool IsRunning() const
+	/** Whether any of the task's jobs are queued or running on the pool */
+	bool HasJobsInFlight() const
 	{
-		return bIsRunning;
+		return NumJobs > 0;
 	}
 
 private:
+	/** Runs a job on the pool, counted until it returns */
+	void Submit(TFunction<void()>&& Job)
+	{
+		++NumJobs;
+		FFoliageWorkerPool::Get().Submit([This = AsShared(), Job = MoveTemp(Job)]()
+		{
+			Job();
+			--This->NumJobs;
+		});
+	}
+
+	/**
+	 * Hands the transforms to the game thread. Every task that isn't cancelled ends here exactly once, with no
+	 * transforms when it couldn't spawn anything, so the actor always hears back from it
+	 */
+	void Finish(TMap<FGuid, TArray<FTransform>>&& FoliageTransforms)
+	{
+		if (bIsCancelled)
+		{
+			return;
+		}
+
+		AsyncTask(ENamedThreads::GameThread,
+		          [This = AsShared(), FoliageTransforms = MoveTemp(FoliageTransforms)]() mutable
+		          {
+			          if (!This->bIsCancelled)
+			          {
+				          This->Callback(This->FeatureIndex, MoveTemp(FoliageTransforms));
+			          }
+		          });
+	}
+
 	std::atomic<bool> bIsCancelled = false;
-	std::atomic<bool> bIsRunning = false;
-	TSharedPtr<FRunnableThread> Thread;
+	std::atomic<int32> NumJobs = 0;
+
+	// Only dereferenced while the task isn't cancelled, the actor cancels its tasks before it is torn down
 	AClusterFoliageActor* ClusterFoliageActor;
-	int32 FeatureId;
+	// Copied in, the actor's feature list keeps growing on the game thread while features stream in
+	FSpatialFeature Feature;
+	int32 FeatureIndex;
 	TFunction<void(int32, TMap<FGuid, TArray<FTransform>>)> Callback;
+
+	bool bEstimationTransform = true;
+	bool bUseTiledSampling = false;
+	bool bSampleTypesJointly = false;
+	TArray<UGenericFoliageType*> Types;
+
+	/** Tangent plane of a geographic feature and the feature projected onto it, in metres */
+	TUniquePtr<FGeographicTangentPlane> Plane;
+	FSpatialPolygon LocalPolygon;
+
+	/** Points of every foliage type back to back, type i owns [TypeOffsets[i], TypeOffsets[i + 1]) */
+	TArray<FVector2D> Points;
+	TArray<int32> TypeOffsets;
 };
 
 // Sets default values
@@ -204,18 +591,54 @@ AClusterFoliageActor::AClusterFoliageActor()
 void AClusterFoliageActor::BeginPlay()
 {
 	Super::BeginPlay();
+
+	// Streamed levels bring or take terrain with them
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &AClusterFoliageActor::OnLevelsChanged);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &AClusterFoliageActor::OnLevelsChanged);
+}
+
+void AClusterFoliageActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+
+	CancelLoad();
+	CancelAllTasks();
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void AClusterFoliageActor::BeginDestroy()
 {
+	CancelLoad();
+	CancelAllTasks();
+
 	Super::BeginDestroy();
-	KillAllThreads();
+}
+
+bool AClusterFoliageActor::IsReadyForFinishDestroy()
+{
+	// Cancelled jobs still on the pool may be using the actor, they return at their next check
+	return Super::IsReadyForFinishDestroy() && !AnyJobsInFlight();
 }
 
 // Called every frame
 void AClusterFoliageActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
+
+	InstancedMeshPool->FlushStagedInstances(InstanceApplyBudgetMs / 1000.0);
+	PruneRetiredTasks();
+
+	if (bStreamFeatures)
+	{
+		StreamingUpdateTime += DeltaTime;
+		if (StreamingUpdateTime >= StreamingUpdateInterval)
+		{
+			StreamingUpdateTime = 0.f;
+			UpdateStreaming();
+		}
+	}
 }
 
 
@@ -255,139 +678,807 @@ double AClusterFoliageActor::GetTerrainBaseHeight(const FVector& GeographicLocat
 	return 0.0;
 }
 
-void AClusterFoliageActor::SetupInstancedMeshPool()
+void AClusterFoliageActor::QueryTerrainHeights(TArrayView<const FVector2D> GeographicPoints,
+                                               TFunction<void(FClusterTerrainSamples&& Samples)> OnComplete)
 {
-	if (!IsValid(Collection))
+	if (!bCacheTerrain || TerrainCacheSpacing <= 0.0 || GeographicPoints.Num() == 0)
 	{
+		TraceTerrainHeights(GeographicPoints, MoveTemp(OnComplete));
 		return;
 	}
 
-	InstancedMeshPool->bEnableCollision = true;
-	TArray<UGenericFoliageType*> FoliageTypes;
+	if (!TerrainCache.IsInitialized() || TerrainCache.GetResolution() != TerrainCacheResolution ||
+		TerrainCache.GetMaxTiles() != TerrainCacheMaxTiles || TerrainCacheLayoutSpacing != TerrainCacheSpacing)
+	{
+		// Tiles are sized once, at the first point, degrees per metre drift too slowly to matter within a dataset
+		const double TileSize = TerrainCacheSpacing * (TerrainCacheResolution - 1);
+		TerrainCache.Reset(
+			bEstimationTransform
+				? USpatialLibrary::HaversineDeltaDegrees(GeographicPoints[0], TileSize)
+				: FVector2D(TileSize),
+			TerrainCacheResolution,
+			TerrainCacheMaxTiles
+		);
+		TerrainCacheLayoutSpacing = TerrainCacheSpacing;
+	}
 
-	for (auto CollectionPair : Collection->Collection)
+	TSet<FIntPoint> MissingTiles;
+	for (const FVector2D& Point : GeographicPoints)
 	{
-		for (auto FoliageType : CollectionPair.Value.FoliageTypes)
+		const FIntPoint TileKey = TerrainCache.GetTileKey(Point);
+		if (!TerrainCache.Contains(TileKey))
 		{
-			FoliageTypes.AddUnique(FoliageType);
+			MissingTiles.Add(TileKey);
 		}
 	}
 
-	InstancedMeshPool->RebuildHISMPool(FoliageTypes);
-}
-
-FSpatialFeature AClusterFoliageActor::GetFeatureById(int32 Id)
-{
-	FSpatialFeature* FoundFeature = Features.FindByPredicate([Id](const FSpatialFeature& Feature)
+	if (MissingTiles.Num() == 0)
 	{
-		return Feature.Id == Id;
-	});
-
-	return *FoundFeature;
-}
+		SampleTerrainCache(GeographicPoints, MoveTemp(OnComplete));
+		return;
+	}
 
-void AClusterFoliageActor::LoadGeoJSON(const FString& Data)
-{
-	if (AnyThreadsRunning())
+	// The batch wouldn't fit, tiles would be evicted before they are read
+	if (MissingTiles.Num() > TerrainCache.GetMaxTiles() / 2)
 	{
-		UE_LOG(LogGenericFoliage, Warning, TEXT("Foliage still building, not loading GeoJSON!"));
+		TraceTerrainHeights(GeographicPoints, MoveTemp(OnComplete));
 		return;
 	}
 
-	for (auto DMC : MeshComponents)
+	TArray<FIntPoint> TileKeys = MissingTiles.Array();
+	TArray<FVector2D> TilePoints;
+	for (const FIntPoint& TileKey : TileKeys)
 	{
-		DMC->DestroyComponent();
+		TerrainCache.GetTileSamplePoints(TileKey, TilePoints);
 	}
-	MeshComponents.Empty();
 
-	MeshPool->ReturnAllMeshes();
+	TWeakObjectPtr<AClusterFoliageActor> WeakThis(this);
+	TraceTerrainHeights(TilePoints,
+		[WeakThis, TileKeys = MoveTemp(TileKeys), Points = TArray<FVector2D>(GeographicPoints),
+			Generation = TerrainCache.GetGeneration(), OnComplete = MoveTemp(OnComplete)](FClusterTerrainSamples&& Samples)
+		{
+			AClusterFoliageActor* This = WeakThis.Get();
+			if (!This)
+			{
+				return;
+			}
 
-	Features = USpatialLibrary::ParseGeoJSON(Data, MeshPool);
+			const int32 NumTileSamples = This->TerrainCache.GetResolution() * This->TerrainCache.GetResolution();
+			for (int32 Index = 0; Index < TileKeys.Num(); ++Index)
+			{
+				This->TerrainCache.AddTile(
+					TileKeys[Index],
+					TArrayView<const double>(Samples.Heights).Slice(Index * NumTileSamples, NumTileSamples),
+					TArrayView<const FVector>(Samples.Normals).Slice(Index * NumTileSamples, NumTileSamples),
+					Generation
+				);
+			}
 
-	SetupInstancedMeshPool();
+			This->SampleTerrainCache(Points, OnComplete);
+		});
+}
 
-	for (FSpatialFeature& Feature : Features)
-	{
-		if (!IsValid(Feature.Geometry))
-		{
-			continue;
-		}
+void AClusterFoliageActor::InvalidateTerrainCache()
+{
+	TerrainCache.Invalidate();
+}
 
-		int32 FeatureType = Feature.Type;
+void AClusterFoliageActor::InvalidateTerrainCacheInBounds(const FBox2D& GeographicBounds)
+{
+	TerrainCache.Invalidate(GeographicBounds);
+}
 
-		if (!Collection->Collection.Contains(FeatureType))
-		{
-			continue;
+void AClusterFoliageActor::OnLevelsChanged(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld())
+	{
+		TerrainCache.Invalidate();
+	}
+}
+
+void AClusterFoliageActor::SampleTerrainCache(TArrayView<const FVector2D> GeographicPoints,
+                                              TFunction<void(FClusterTerrainSamples&& Samples)> OnComplete)
+{
+	FClusterTerrainSamples Samples;
+	Samples.Heights.SetNumUninitialized(GeographicPoints.Num());
+	Samples.Normals.SetNumUninitialized(GeographicPoints.Num());
+
+	TArray<int32> MissedIndices;
+	TArray<FVector2D> MissedPoints;
+
+	for (int32 Index = 0; Index < GeographicPoints.Num(); ++Index)
+	{
+		if (!TerrainCache.Sample(GeographicPoints[Index], Samples.Heights[Index], Samples.Normals[Index]))
+		{
+			MissedIndices.Add(Index);
+			MissedPoints.Add(GeographicPoints[Index]);
 		}
+	}
+
+	if (MissedIndices.Num() == 0)
+	{
+		OnComplete(MoveTemp(Samples));
+		return;
+	}
+
+	TraceTerrainHeights(MissedPoints,
+		[Samples = MoveTemp(Samples), MissedIndices = MoveTemp(MissedIndices), OnComplete = MoveTemp(OnComplete)](
+		FClusterTerrainSamples&& MissedSamples) mutable
+		{
+			for (int32 Index = 0; Index < MissedIndices.Num(); ++Index)
+			{
+				Samples.Heights[MissedIndices[Index]] = MissedSamples.Heights[Index];
+				Samples.Normals[MissedIndices[Index]] = MissedSamples.Normals[Index];
+			}
+
+			OnComplete(MoveTemp(Samples));
+		});
+}
+
+void AClusterFoliageActor::TraceTerrainHeights(TArrayView<const FVector2D> GeographicPoints,
+                                               TFunction<void(FClusterTerrainSamples&& Samples)> OnComplete)
+{
+	struct FTraceBatch
+	{
+		FClusterTerrainSamples Samples;
+		int32 NumPending = 0;
+		TFunction<void(FClusterTerrainSamples&& Samples)> OnComplete;
+	};
+
+	if (GeographicPoints.Num() == 0)
+	{
+		OnComplete(FClusterTerrainSamples());
+		return;
+	}
+
+	const TSharedRef<FTraceBatch> Batch = MakeShared<FTraceBatch>();
+	Batch->Samples.Heights.Init(0.0, GeographicPoints.Num());
+	Batch->Samples.Normals.Init(FVector::ZeroVector, GeographicPoints.Num());
+	Batch->NumPending = GeographicPoints.Num();
+	Batch->OnComplete = MoveTemp(OnComplete);
+
+	// Every trace of the batch shares the delegate, the point index rides along as user data
+	TWeakObjectPtr<AClusterFoliageActor> WeakThis(this);
+	const FTraceDelegate OnTrace = FTraceDelegate::CreateLambda(
+		[Batch, WeakThis](const FTraceHandle& Handle, FTraceDatum& Datum)
+		{
+			AClusterFoliageActor* This = WeakThis.Get();
+			if (This && Datum.OutHits.Num() > 0)
+			{
+				const FHitResult& Hit = Datum.OutHits[0];
+				Batch->Samples.Heights[Datum.UserData] = This->EngineToGeographicLocation(Hit.Location).Z;
+				Batch->Samples.Normals[Datum.UserData] = Hit.ImpactNormal;
+			}
+
+			if (--Batch->NumPending == 0)
+			{
+				Batch->OnComplete(MoveTemp(Batch->Samples));
+			}
+		});
+
+	for (int32 Index = 0; Index < GeographicPoints.Num(); ++Index)
+	{
+		const FVector2D& Point = GeographicPoints[Index];
+		GetWorld()->AsyncLineTraceByChannel(
+			EAsyncTraceType::Single,
+			GeographicToEngineLocation(FVector(Point.X, Point.Y, 9000.0)),
+			GeographicToEngineLocation(FVector(Point.X, Point.Y, -1000.0)),
+			ECollisionChannel::ECC_Visibility,
+			FCollisionQueryParams::DefaultQueryParam,
+			FCollisionResponseParams::DefaultResponseParam,
+			&OnTrace,
+			Index
+		);
+	}
+}
+
+void AClusterFoliageActor::SetupInstancedMeshPool()
+{
+	if (!IsValid(Collection))
+	{
+		return;
+	}
+
+	InstancedMeshPool->bEnableCollision = true;
+	TArray<UGenericFoliageType*> FoliageTypes;
+
+	for (auto CollectionPair : Collection->Collection)
+	{
+		for (auto FoliageType : CollectionPair.Value.FoliageTypes)
+		{
+			FoliageTypes.AddUnique(FoliageType);
+		}
+	}
+
+	InstancedMeshPool->RebuildHISMPool(FoliageTypes);
+}
+
+FSpatialFeature AClusterFoliageActor::GetFeatureById(int32 Id)
+{
+	FSpatialFeature* FoundFeature = Features.FindByPredicate([Id](const FSpatialFeature& Feature)
+	{
+		return Feature.Id == Id;
+	});
+
+	return *FoundFeature;
+}
+
+void AClusterFoliageActor::LoadGeoJSON(const FString& Data)
+{
+	// Supersedes a load in progress, along with whatever is still spawning from it
+	ResetFeatures();
+
+	const TSharedRef<FGeoJSONReader, ESPMode::ThreadSafe> Reader = MakeShared<FGeoJSONReader, ESPMode::ThreadSafe>();
+	Reader->OpenString(Data);
+	StreamFeatures(Reader, false);
+}
+
+void AClusterFoliageActor::LoadGeoJSONFile(const FString& FilePath)
+{
+	const TSharedRef<FGeoJSONReader, ESPMode::ThreadSafe> Reader = MakeShared<FGeoJSONReader, ESPMode::ThreadSafe>();
+	if (!Reader->OpenFile(FilePath))
+	{
+		UE_LOG(LogGenericFoliage, Error, TEXT("Failed to read GeoJSON: %s"), *Reader->GetError());
+		return;
+	}
+
+	ResetFeatures();
+	StreamFeatures(Reader, false);
+}
 
-		Threads.Add(
-			Feature.Id,
-			MakeShareable(new FClusterFoliageSpawnerThread(
-				this, Feature.Id, [&](int32 FeatureId, TMap<FGuid, TArray<FTransform>> InstancesMap)
+void AClusterFoliageActor::UpdateGeoJSON(const FString& Data)
+{
+	const TSharedRef<FGeoJSONReader, ESPMode::ThreadSafe> Reader = MakeShared<FGeoJSONReader, ESPMode::ThreadSafe>();
+	Reader->OpenString(Data);
+
+	// Whatever is still arriving from an earlier load is superseded, the update matches against what is there.
+	// Cached placeholders are matched by their hashes and stay unbuilt
+	UpdatedFeatures.Init(false, Features.Num());
+	StreamFeatures(Reader, true);
+}
+
+void AClusterFoliageActor::UpdateGeoJSONFile(const FString& FilePath)
+{
+	const TSharedRef<FGeoJSONReader, ESPMode::ThreadSafe> Reader = MakeShared<FGeoJSONReader, ESPMode::ThreadSafe>();
+	if (!Reader->OpenFile(FilePath))
+	{
+		UE_LOG(LogGenericFoliage, Error, TEXT("Failed to read GeoJSON: %s"), *Reader->GetError());
+		return;
+	}
+
+	UpdatedFeatures.Init(false, Features.Num());
+	StreamFeatures(Reader, true);
+}
+
+void AClusterFoliageActor::ResetFeatures()
+{
+	CancelAllTasks();
+
+	for (auto& DMCPair : MeshComponents)
+	{
+		DMCPair.Value->DestroyComponent();
+	}
+	MeshComponents.Empty();
+
+	MeshPool->ReturnAllMeshes();
+	Features.Empty();
+	FeaturesByHash.Empty();
+	UpdatedFeatures.Empty();
+	FeatureTree.Reset();
+	StreamedFeatures.Reset();
+	StreamingCache.Reset();
+	CachedFeaturesBuilt.Empty();
+	++FeatureListId;
+
+	SetupInstancedMeshPool();
+}
+
+void AClusterFoliageActor::StreamFeatures(const TSharedRef<FGeoJSONReader, ESPMode::ThreadSafe>& Reader,
+                                          bool bUpdate)
+{
+	CancelLoad();
+	bIsLoadingGeoJSON = true;
+	const int32 CurrentLoadId = LoadId;
+	LoadCancelled = MakeShared<std::atomic<bool>, ESPMode::ThreadSafe>(false);
+	TWeakObjectPtr<AClusterFoliageActor> WeakThis(this);
+
+	const bool bCacheFeatures = GetDefault<UGenericFoliageSettings>()->bCacheFeatures;
+
+	// Only a streamed load can leave the features it doesn't need yet in the cache, everything else is built now
+	const bool bKeepCache = bStreamFeatures && !bUpdate;
+
+	FFoliageWorkerPool::Get().Submit([Reader, WeakThis, CurrentLoadId, Cancelled = LoadCancelled.ToSharedRef(),
+		bCacheFeatures, bKeepCache, bUpdate]()
+	{
+		TArray<FGeoJSONFeature> Batch;
+		int32 NumBatchPoints = 0;
+
+		const auto SendBatch = [WeakThis, CurrentLoadId, bUpdate, &Batch, &NumBatchPoints]()
+		{
+			if (Batch.Num() == 0)
+			{
+				return;
+			}
+
+			// Meshes come from the actor's pool, so the features are built on the game thread while parsing carries on
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, CurrentLoadId, bUpdate, BatchFeatures = MoveTemp(Batch)]()
+			{
+				AClusterFoliageActor* This = WeakThis.Get();
+				if (!This || This->LoadId != CurrentLoadId)
 				{
-					Threads.Remove(FeatureId);
-					for (auto& Pair : InstancesMap)
+					return;
+				}
+
+				for (const FGeoJSONFeature& Feature : BatchFeatures)
+				{
+					if (bUpdate)
+					{
+						This->UpdateFeature(Feature);
+					}
+					else
 					{
-						InstancedMeshPool->HISMPool[Pair.Key]->AddInstances(
-							Pair.Value,
-							false,
-							true
-						);
+						This->AddFeature(Feature);
 					}
 				}
-			))
-		);
+			});
+
+			Batch.Reset();
+			NumBatchPoints = 0;
+		};
+
+		const auto OnFeature = [&Batch, &NumBatchPoints, &SendBatch, Cancelled](FGeoJSONFeature& Feature)
+		{
+			// Copied rather than moved, the reader keeps the feature's buffers for the next one
+			NumBatchPoints += Batch.Add_GetRef(Feature).Coordinates.Num();
 
-		if (bShowBoundary)
+			if (Batch.Num() >= CLUSTER_LOAD_BATCH_FEATURES || NumBatchPoints >= CLUSTER_LOAD_BATCH_POINTS)
+			{
+				SendBatch();
+			}
+
+			// A newer load or the actor going away stops the parse at the next feature
+			return !*Cancelled;
+		};
+
+		bool bSuccess;
+
+		if (bCacheFeatures)
 		{
-			UDynamicMesh* VisualMesh = MeshPool->RequestMesh();
-			VisualMesh->Reset();
+			const uint64 SourceHash = FFeatureCache::HashSource(Reader->GetBuffer());
+			const FString CachePath = FFeatureCache::GetCachePath(SourceHash);
+
+			const TSharedRef<FFeatureCache, ESPMode::ThreadSafe> Cache = MakeShared<FFeatureCache,
+				ESPMode::ThreadSafe>();
+
+			if (Cache->Open(CachePath, SourceHash) && bKeepCache)
+			{
+				AsyncTask(ENamedThreads::GameThread, [WeakThis, CurrentLoadId, Cache]()
+				{
+					AClusterFoliageActor* This = WeakThis.Get();
+					if (This && This->LoadId == CurrentLoadId)
+					{
+						This->SetStreamingCache(Cache);
+					}
+				});
 
-			Feature.Geometry->ProcessMesh([&VisualMesh](const FDynamicMesh3& OtherMesh)
+				bSuccess = true;
+			}
+			else if (Cache->IsOpen())
+			{
+				bSuccess = Cache->ReadFeatures(OnFeature);
+			}
+			else
 			{
-				VisualMesh->EditMesh([&OtherMesh](FDynamicMesh3& Mesh)
+				// Parse as usual and keep a copy of each feature before it's handed over
+				FFeatureCacheWriter Writer;
+				bool bStopped = false;
+
+				bSuccess = Reader->ReadFeatures([&Writer, &bStopped, &OnFeature](FGeoJSONFeature& Feature)
 				{
-					Mesh.Copy(OtherMesh);
+					Writer.Add(Feature);
+					bStopped = !OnFeature(Feature);
+					return !bStopped;
 				});
+
+				if (bSuccess && !bStopped)
+				{
+					Writer.Save(CachePath, SourceHash);
+				}
+			}
+		}
+		else
+		{
+			bSuccess = Reader->ReadFeatures(OnFeature);
+		}
+
+		// Ahead of the completion below, the game thread runs them in order
+		SendBatch();
+
+		AsyncTask(ENamedThreads::GameThread,
+		          [WeakThis, CurrentLoadId, bSuccess, bUpdate, Error = Reader->GetError()]()
+		{
+			if (!bSuccess)
+			{
+				UE_LOG(LogGenericFoliage, Error, TEXT("Failed to parse GeoJSON: %s"), *Error);
+			}
+
+			AClusterFoliageActor* This = WeakThis.Get();
+			if (This && This->LoadId == CurrentLoadId)
+			{
+				This->bIsLoadingGeoJSON = false;
+
+				// A document that failed to parse part way would otherwise remove everything after the error
+				if (bUpdate && bSuccess)
+				{
+					This->FinishUpdate();
+				}
+			}
+		});
+	});
+}
+
+void AClusterFoliageActor::AddFeature(const FGeoJSONFeature& GeoJSONFeature)
+{
+	// Spawning only needs the polygon, the mesh is built for the boundary display
+	const int32 FeatureIndex = Features.Emplace(
+		USpatialLibrary::MakeSpatialFeature(GeoJSONFeature, bShowBoundary ? MeshPool : nullptr));
+	UpdatedFeatures.Add(true);
+	FeaturesByHash.Add(Features[FeatureIndex].Hash, FeatureIndex);
+
+	RegisterFeature(FeatureIndex);
+}
+
+void AClusterFoliageActor::SetStreamingCache(const TSharedRef<FFeatureCache, ESPMode::ThreadSafe>& Cache)
+{
+	StreamingCache = Cache;
+	CachedFeaturesBuilt.Init(false, Cache->Num());
+	UpdatedFeatures.Init(true, Cache->Num());
+
+	// Placeholders keep the indices the cache's spatial index refers to
+	Features.SetNum(Cache->Num());
+	for (int32 FeatureIndex = 0; FeatureIndex < Cache->Num(); ++FeatureIndex)
+	{
+		FSpatialFeature& Feature = Features[FeatureIndex];
+		Feature.Id = Cache->GetId(FeatureIndex);
+		Feature.Hash = Cache->GetHash(FeatureIndex);
+		Feature.Type = Cache->GetType(FeatureIndex);
+		Feature.Bounds = Cache->GetBounds(FeatureIndex);
+
+		// Matched by hash like any other feature, building it doesn't change the hash
+		FeaturesByHash.Add(Feature.Hash, FeatureIndex);
+	}
+}
+
+void AClusterFoliageActor::BuildCachedFeature(int32 FeatureIndex)
+{
+	CachedFeaturesBuilt[FeatureIndex] = true;
+
+	FGeoJSONFeature GeoJSONFeature;
+	StreamingCache->GetFeature(FeatureIndex, GeoJSONFeature);
+	Features[FeatureIndex] = USpatialLibrary::MakeSpatialFeature(GeoJSONFeature, bShowBoundary ? MeshPool : nullptr);
+
+	// Keeps the hash it is listed under in FeaturesByHash
+	Features[FeatureIndex].Hash = StreamingCache->GetHash(FeatureIndex);
+
+	RegisterFeature(FeatureIndex);
+}
+
+void AClusterFoliageActor::RegisterFeature(int32 FeatureIndex)
+{
+	const FSpatialFeature& Feature = Features[FeatureIndex];
+
+	if (!Feature.Polygon.IsValid())
+	{
+		return;
+	}
+
+	int32 FeatureType = Feature.Type;
+
+	if (!IsValid(Collection) || !Collection->Collection.Contains(FeatureType))
+	{
+		return;
+	}
+
+	// While streaming the feature waits for the camera to come close
+	FeatureTree.Insert(FeatureIndex, Feature.Bounds);
+	if (!bStreamFeatures)
+	{
+		SpawnFeature(FeatureIndex);
+	}
+
+	if (bShowBoundary && IsValid(Feature.Geometry))
+	{
+		UDynamicMesh* VisualMesh = MeshPool->RequestMesh();
+		VisualMesh->Reset();
+
+		Feature.Geometry->ProcessMesh([&VisualMesh](const FDynamicMesh3& OtherMesh)
+		{
+			VisualMesh->EditMesh([&OtherMesh](FDynamicMesh3& Mesh)
+			{
+				Mesh.Copy(OtherMesh);
 			});
+		});
 
-			VisualMesh->EditMesh(
-				[this](UE::Geometry::FDynamicMesh3& Mesh)
+		// Draped over the terrain once it has been queried, the same cached tiles the foliage lands on
+		TArray<int32> VertexIds;
+		TArray<FVector2D> VertexPoints;
+		VisualMesh->ProcessMesh([&VertexIds, &VertexPoints](const FDynamicMesh3& Mesh)
+		{
+			for (const int32 VertexId : Mesh.VertexIndicesItr())
+			{
+				const FVector3d Vertex = Mesh.GetVertex(VertexId);
+				VertexIds.Add(VertexId);
+				VertexPoints.Add(FVector2D(Vertex.X, Vertex.Y));
+			}
+		});
+
+		TWeakObjectPtr<AClusterFoliageActor> WeakThis(this);
+		QueryTerrainHeights(VertexPoints,
+			[WeakThis, CurrentFeatureListId = FeatureListId, FeatureIndex, VisualMesh,
+				VertexIds = MoveTemp(VertexIds)](FClusterTerrainSamples&& Samples)
+			{
+				// Removed features have no polygon
+				AClusterFoliageActor* This = WeakThis.Get();
+				if (!This || This->FeatureListId != CurrentFeatureListId ||
+					!This->Features[FeatureIndex].Polygon.IsValid())
 				{
-					for (int i = 0; i < Mesh.VertexCount(); ++i)
+					return;
+				}
+
+				VisualMesh->EditMesh(
+					[This, &VertexIds, &Samples](UE::Geometry::FDynamicMesh3& Mesh)
 					{
-						auto Vertex = Mesh.GetVertex(i);
-						FVector Normal;
-						Vertex.Z += GetTerrainBaseHeight(Vertex, Normal);
-						Vertex = GeographicToEngineLocation(Vertex);
-						Mesh.SetVertex(i, Vertex);
-					}
-				},
-				EDynamicMeshChangeType::MeshVertexChange,
-				EDynamicMeshAttributeChangeFlags::VertexPositions
-			);
+						for (int32 Index = 0; Index < VertexIds.Num(); ++Index)
+						{
+							FVector Vertex = Mesh.GetVertex(VertexIds[Index]);
+							Vertex.Z += Samples.Heights[Index];
+							Mesh.SetVertex(VertexIds[Index], This->GeographicToEngineLocation(Vertex));
+						}
+					},
+					EDynamicMeshChangeType::MeshVertexChange,
+					EDynamicMeshAttributeChangeFlags::VertexPositions
+				);
+
+				UDynamicMeshComponent* DMC = Cast<UDynamicMeshComponent>(
+					This->AddComponentByClass(UDynamicMeshComponent::StaticClass(), true, FTransform::Identity,
+					                          false));
+				ensure(DMC);
+
+				DMC->SetDynamicMesh(VisualMesh);
+
+				if (IsValid(This->DebugMaterial))
+				{
+					DMC->SetMaterial(0, This->DebugMaterial);
+				}
+
+				This->MeshComponents.Add(FeatureIndex, DMC);
+			});
+	}
+}
+
+void AClusterFoliageActor::UpdateFeature(const FGeoJSONFeature& GeoJSONFeature)
+{
+	for (auto It = FeaturesByHash.CreateKeyIterator(GeoJSONFeature.GetContentHash()); It; ++It)
+	{
+		if (!UpdatedFeatures[It.Value()])
+		{
+			UpdatedFeatures[It.Value()] = true;
+			return;
+		}
+	}
+
+	AddFeature(GeoJSONFeature);
+}
+
+void AClusterFoliageActor::FinishUpdate()
+{
+	TSet<int32> RemovedFeatures;
+	for (const auto& HashPair : FeaturesByHash)
+	{
+		if (!UpdatedFeatures[HashPair.Value])
+		{
+			RemovedFeatures.Add(HashPair.Value);
+		}
+	}
+
+	RemoveFeatures(RemovedFeatures);
+
+	UE_LOG(LogGenericFoliage, Log, TEXT("Updated GeoJSON, removed %i features, %i left"), RemovedFeatures.Num(),
+	       FeaturesByHash.Num());
+}
+
+void AClusterFoliageActor::RemoveFeatures(const TSet<int32>& FeatureIndices)
+{
+	for (const int32 FeatureIndex : FeatureIndices)
+	{
+		FSpatialFeature& Feature = Features[FeatureIndex];
+
+		CancelTask(FeatureIndex);
+
+		UDynamicMeshComponent* DMC = nullptr;
+		if (MeshComponents.RemoveAndCopyValue(FeatureIndex, DMC))
+		{
+			MeshPool->ReturnMesh(DMC->GetDynamicMesh());
+			DMC->DestroyComponent();
+		}
+
+		if (IsValid(Feature.Geometry))
+		{
+			MeshPool->ReturnMesh(Feature.Geometry);
+		}
+
+		FeaturesByHash.RemoveSingle(Feature.Hash, FeatureIndex);
+		if (Feature.Polygon.IsValid())
+		{
+			FeatureTree.Remove(FeatureIndex, Feature.Bounds);
+		}
+		StreamedFeatures.Remove(FeatureIndex);
+
+		// A placeholder the update dropped is never read from the cache
+		if (FeatureIndex < CachedFeaturesBuilt.Num())
+		{
+			CachedFeaturesBuilt[FeatureIndex] = true;
+		}
+
+		// The slot stays so the other indices hold
+		Feature = FSpatialFeature();
+	}
 
-			UDynamicMeshComponent* DMC = Cast<UDynamicMeshComponent>(
-				AddComponentByClass(UDynamicMeshComponent::StaticClass(), true, FTransform::Identity, false));
-			ensure(DMC);
+	// Every instance of these features, from one RemoveInstances per foliage type
+	InstancedMeshPool->RemoveOwnedInstances(FeatureIndices);
+}
 
-			DMC->SetDynamicMesh(VisualMesh);
+void AClusterFoliageActor::SpawnFeature(int32 FeatureIndex)
+{
+	TSharedRef<FClusterFoliageSpawnerTask, ESPMode::ThreadSafe> SpawnerTask = MakeShared<
+		FClusterFoliageSpawnerTask, ESPMode::ThreadSafe>(
+		this, Features[FeatureIndex], FeatureIndex,
+		[WeakThis = TWeakObjectPtr<AClusterFoliageActor>(this)](int32 SpawnedFeatureIndex,
+		                                                        TMap<FGuid, TArray<FTransform>> InstancesMap)
+		{
+			AClusterFoliageActor* This = WeakThis.Get();
+			if (!This)
+			{
+				return;
+			}
 
-			if (IsValid(DebugMaterial))
+			This->SpawnerTasks.Remove(SpawnedFeatureIndex);
+			// Added by the budgeted flush in Tick, so features finishing together don't add up to a hitch
+			for (auto& Pair : InstancesMap)
 			{
-				DMC->SetMaterial(0, DebugMaterial);
+				This->InstancedMeshPool->StageOwnedInstances(Pair.Key, SpawnedFeatureIndex, MoveTemp(Pair.Value));
 			}
+		}
+	);
+
+	SpawnerTasks.Add(FeatureIndex, SpawnerTask);
+	SpawnerTask->Start();
+}
+
+void AClusterFoliageActor::UpdateStreaming()
+{
+	FVector CameraLocation;
+	if (!GetCameraLocation(CameraLocation))
+	{
+		return;
+	}
+
+	const FVector GeographicLocation = EngineToGeographicLocation(CameraLocation);
+	const FVector2D Center(GeographicLocation.X, GeographicLocation.Y);
+
+	// The radius as an extent in feature coordinates, degrees differ along each axis away from the equator
+	FVector2D Extent = bEstimationTransform
+		                   ? USpatialLibrary::HaversineDeltaDegrees(Center, StreamingRadius).GetAbs()
+		                   : FVector2D(StreamingRadius);
+	Extent = FVector2D::Max(Extent, FVector2D(UE_SMALL_NUMBER));
+
+	const auto IsInRange = [&Center, &Extent](const FBox2D& Bounds, double Scale)
+	{
+		const FVector2D Closest(
+			FMath::Clamp(Center.X, Bounds.Min.X, Bounds.Max.X),
+			FMath::Clamp(Center.Y, Bounds.Min.Y, Bounds.Max.Y)
+		);
+		return ((Closest - Center) / (Extent * Scale)).SizeSquared() <= 1.0;
+	};
+
+	const FBox2D QueryBox(Center - Extent, Center + Extent);
+	TArray<int32> NearbyFeatures;
+
+	// Cached features coming into range are built first, which puts them in the tree
+	if (StreamingCache.IsValid())
+	{
+		TArray<int32> CachedFeatures;
+		StreamingCache->QueryBounds(QueryBox, CachedFeatures);
+
+		for (const int32 FeatureIndex : CachedFeatures)
+		{
+			if (!CachedFeaturesBuilt[FeatureIndex] && IsValid(Collection) &&
+				Collection->Collection.Contains(Features[FeatureIndex].Type))
+			{
+				BuildCachedFeature(FeatureIndex);
+			}
+		}
+	}
+
+	FeatureTree.Query(QueryBox, NearbyFeatures);
+
+	int32 NumSpawned = 0;
+
+	for (const int32 FeatureIndex : NearbyFeatures)
+	{
+		if (!StreamedFeatures.Contains(FeatureIndex) && IsInRange(Features[FeatureIndex].Bounds, 1.0))
+		{
+			StreamedFeatures.Add(FeatureIndex);
+			SpawnFeature(FeatureIndex);
+			++NumSpawned;
+		}
+	}
+
+	TSet<int32> ReleasedFeatures;
+
+	for (auto It = StreamedFeatures.CreateIterator(); It; ++It)
+	{
+		if (IsInRange(Features[*It].Bounds, 1.0 + StreamingHysteresis))
+		{
+			continue;
+		}
+
+		// Still spawning, its results are dropped
+		CancelTask(*It);
+
+		ReleasedFeatures.Add(*It);
+		It.RemoveCurrent();
+	}
 
-			MeshComponents.Add(DMC);
+	InstancedMeshPool->RemoveOwnedInstances(ReleasedFeatures);
+
+	if (NumSpawned > 0 || ReleasedFeatures.Num() > 0)
+	{
+		UE_LOG(LogGenericFoliage, Verbose, TEXT("Spawned %i features, released %i, %i in range"), NumSpawned,
+		       ReleasedFeatures.Num(), StreamedFeatures.Num());
+	}
+}
+
+bool AClusterFoliageActor::GetCameraLocation(FVector& OutLocation) const
+{
+	APlayerController* PC = GetWorld()->GetFirstPlayerController();
+	if (PC)
+	{
+		FMinimalViewInfo ViewInfo;
+		PC->CalcCamera(GetWorld()->GetDeltaSeconds(), ViewInfo);
+		OutLocation = ViewInfo.Location;
+		return true;
+	}
+
+#if WITH_EDITOR
+	if (GEditor && GEditor->GetActiveViewport())
+	{
+		const FEditorViewportClient* Client = static_cast<FEditorViewportClient*>(GEditor->GetActiveViewport()->
+			GetClient());
+		if (Client)
+		{
+			OutLocation = Client->GetViewLocation();
+			return true;
 		}
 	}
+#endif
+
+	return false;
 }
 
-bool AClusterFoliageActor::AnyThreadsRunning() const
+bool AClusterFoliageActor::AnyJobsInFlight() const
 {
-	for (auto Pair : Threads)
+	for (const auto& Pair : SpawnerTasks)
 	{
-		if (Pair.Value.IsValid() && Pair.Value->IsRunning())
+		if (Pair.Value->HasJobsInFlight())
+		{
+			return true;
+		}
+	}
+
+	for (const TSharedPtr<FClusterFoliageSpawnerTask, ESPMode::ThreadSafe>& Task : RetiredTasks)
+	{
+		if (Task->HasJobsInFlight())
 		{
 			return true;
 		}
@@ -396,11 +1487,57 @@ bool AClusterFoliageActor::AnyThreadsRunning() const
 	return false;
 }
 
-void AClusterFoliageActor::KillAllThreads()
+void AClusterFoliageActor::CancelTask(int32 FeatureIndex)
 {
-	for (auto Pair : Threads)
+	TSharedPtr<FClusterFoliageSpawnerTask, ESPMode::ThreadSafe> SpawnerTask;
+	if (SpawnerTasks.RemoveAndCopyValue(FeatureIndex, SpawnerTask))
+	{
+		SpawnerTask->Cancel();
+		if (SpawnerTask->HasJobsInFlight())
+		{
+			RetiredTasks.Add(MoveTemp(SpawnerTask));
+		}
+	}
+}
+
+void AClusterFoliageActor::CancelAllTasks()
+{
+	PruneRetiredTasks();
+
+	for (auto& Pair : SpawnerTasks)
 	{
 		Pair.Value->Cancel();
+		if (Pair.Value->HasJobsInFlight())
+		{
+			RetiredTasks.Add(MoveTemp(Pair.Value));
+		}
 	}
-	Threads.Empty();
+	SpawnerTasks.Empty();
 }
+
+void AClusterFoliageActor::PruneRetiredTasks()
+{
+	RetiredTasks.RemoveAllSwap([](const TSharedPtr<FClusterFoliageSpawnerTask, ESPMode::ThreadSafe>& Task)
+	{
+		return !Task->HasJobsInFlight();
+	});
+}
+
+void AClusterFoliageActor::CancelLoad()
+{
+	if (LoadCancelled.IsValid())
+	{
+		*LoadCancelled = true;
+		LoadCancelled.Reset();
+	}
+
+	// Features of the load already queued for the game thread are dropped too
+	++LoadId;
+	bIsLoadingGeoJSON = false;
+}
+
+#undef CLUSTER_CANCEL_CHECK_POINTS
+#undef CLUSTER_LOAD_BATCH_FEATURES
+#undef CLUSTER_LOAD_BATCH_POINTS
+#undef CLUSTER_SPLIT_CELLS
+#undef CLUSTER_BLOCK_CELLS
@@ -7,7 +7,9 @@
 #include "Components/SceneCaptureComponent2D.h"
 #include "Engine/TextureRenderTarget2D.h"
 #include "Actors/GenericFoliageActor.h"
-#include "Async/Async.h"
+#include "Actors/Components/FoliageInstancedMeshPool.h"
+#include "Async/ParallelFor.h"
+#include "Async/FoliageTilePipeline.h"
 #include "Components/HierarchicalInstancedStaticMeshComponent.h"
 #include "Engine/InstancedStaticMesh.h"
 #include "Kismet/KismetMathLibrary.h"
@@ -47,6 +49,48 @@ struct FTiledFoliageBuilder
 	}
 };
 
+/** Snapshot of a tile update, taken on the game thread and handed down the capture pipeline */
+struct FFoliageTileWorkContext
+{
+	TWeakObjectPtr<UFoliageCaptureComponent> Component;
+	TSharedRef<FFoliageTileGeneration, ESPMode::ThreadSafe> GenerationState;
+	uint32 Generation;
+
+	/** Queue the apply tasks go to, shared so the worker never needs the owning actor */
+	TSharedRef<FFoliageTaskQueue, ESPMode::ThreadSafe> FoliageQueue;
+
+	/** Pipeline the tile moves through, each stage submits the next */
+	TSharedRef<FFoliageTilePipeline, ESPMode::ThreadSafe> Pipeline;
+
+	FIntPoint TileID = FIntPoint::ZeroValue;
+	double Diameter = 0.0;
+	float DensityScale = 1.f;
+	bool bIsNearestTile = false;
+	FTransform ComponentTransform;
+	TArray<UGenericFoliageType*> FoliageTypes;
+	TMap<FGuid, TSharedPtr<FTiledFoliageBuilder>> Builders;
+
+	FFoliageTileWorkContext(
+		UFoliageCaptureComponent* InComponent,
+		const TSharedRef<FFoliageTileGeneration, ESPMode::ThreadSafe>& InGenerationState,
+		uint32 InGeneration,
+		const TSharedRef<FFoliageTaskQueue, ESPMode::ThreadSafe>& InFoliageQueue,
+		const TSharedRef<FFoliageTilePipeline, ESPMode::ThreadSafe>& InPipeline
+	) : Component(InComponent),
+	    GenerationState(InGenerationState),
+	    Generation(InGeneration),
+	    FoliageQueue(InFoliageQueue),
+	    Pipeline(InPipeline)
+	{
+	}
+
+	/** True once the tile has been re-queued or discarded, any further work on this context is wasted */
+	bool IsStale() const
+	{
+		return GenerationState->Value.load(std::memory_order_acquire) != Generation;
+	}
+};
+
 // Sets default values for this component's properties
 UFoliageCaptureComponent::UFoliageCaptureComponent()
 {
@@ -106,32 +150,60 @@ UFoliageCaptureComponent::~UFoliageCaptureComponent()
 {
 }
 
-void UFoliageCaptureComponent::Compute()
+void UFoliageCaptureComponent::Compute(float InDensityScale)
 {
 	ensure(IsInGameThread());
 	ensure(bReadyToUpdate);
 
-	bReadyToUpdate = false;
+	SetReadyToUpdate(false);
 
 	UTextureRenderTarget2D* SceneColourRT_Target2D = SceneColourRT;
 	UTextureRenderTarget2D* SceneDepthRT_Target2D = SceneDepthRT;
 	UTextureRenderTarget2D* SceneNormalRT_Target2D = SceneNormalRT;
 
-	this->Builders = CreateFoliageBuilders();
+	AGenericFoliageActor* Parent = Cast<AGenericFoliageActor>(GetOwner());
+	check(IsValid(Parent));
+
+	// Snapshot everything the worker needs, it only ever touches this context and the shared apply queue
+	TSharedRef<FFoliageTileWorkContext, ESPMode::ThreadSafe> Context = MakeShared<
+		FFoliageTileWorkContext, ESPMode::ThreadSafe>(
+		this, GenerationState, GetGeneration(), Parent->GetFoliageTickQueue(), Parent->GetTilePipeline());
+	Context->TileID = TileID;
+	Context->Diameter = Diameter;
+	Context->DensityScale = InDensityScale;
+	Context->bIsNearestTile = bHasWorldTile && WorldTileID == Parent->GetGridCenter();
+	Context->ComponentTransform = GetComponentTransform();
+	Context->FoliageTypes = Parent->FoliageTypes;
+	Context->Builders = CreateFoliageBuilders();
+
+	// The captures were just issued, they are in flight until the render thread gets to the readback
+	FFoliagePipelineTicketPtr CaptureTicket = Context->Pipeline->Acquire(EFoliagePipelineStage::Capture);
 
 	ENQUEUE_RENDER_COMMAND(FReadRenderTargets)(
-		[this, SceneColourRT_Target2D, SceneDepthRT_Target2D, SceneNormalRT_Target2D](
-		FRHICommandListImmediate& RHICmdList)
+		[Context, CaptureTicket, SceneColourRT_Target2D, SceneDepthRT_Target2D, SceneNormalRT_Target2D](
+		FRHICommandListImmediate& RHICmdList) mutable
 		{
+			// Readbacks run one at a time on the render thread, so the stage needs no limit of its own
+			FFoliagePipelineTicketPtr ReadbackTicket = Context->Pipeline->Acquire(EFoliagePipelineStage::Readback);
+			CaptureTicket.Reset();
+
+			// Skip the readback entirely if the tile was re-queued while this was waiting on the render thread
+			if (Context->IsStale())
+			{
+				return;
+			}
+
 			if (!IsValid(SceneColourRT_Target2D) || !IsValid(SceneDepthRT_Target2D))
 			{
 				UE_LOG(LogTemp, Error, TEXT("Render targets are not valid!"));
+				ReleaseTile(Context.Get());
 				return;
 			}
 
 			if (!SceneColourRT_Target2D->GetRenderTargetResource() || !SceneDepthRT_Target2D->GetRenderTargetResource())
 			{
 				UE_LOG(LogTemp, Error, TEXT("Failed to get render target resources!"));
+				ReleaseTile(Context.Get());
 				return;
 			}
 
@@ -211,17 +283,20 @@ void UFoliageCaptureComponent::Compute()
 				DepthReadback.Unlock();
 			}
 
-			Async(EAsyncExecution::Thread, [
-				      this, Width, Height,
-				      SceneColourData = MoveTemp(SceneColourData),
-				      SceneNormalData = MoveTemp(SceneNormalData),
-				      SceneDepthValues = MoveTemp(SceneDepthValues)]() mutable
-			      {
-				      FVector Right = GetRightVector();
-				      FVector Forward = GetForwardVector();
-				      const double ZoneWidth = Diameter / 2.0;
-				      Compute_Internal(SceneColourData, SceneNormalData, SceneDepthValues, Width, Height);
-			      });
+			ReadbackTicket.Reset();
+
+			Context->Pipeline->Submit(EFoliagePipelineStage::Compute, [
+				                          Context, Width, Height,
+				                          SceneColourData = MoveTemp(SceneColourData),
+				                          SceneNormalData = MoveTemp(SceneNormalData),
+				                          SceneDepthValues = MoveTemp(SceneDepthValues)](FFoliagePipelineTicketPtr)
+			                          {
+				                          if (!Context->IsStale())
+				                          {
+					                          Compute_Internal(Context, SceneColourData, SceneNormalData,
+					                                           SceneDepthValues, Width, Height);
+				                          }
+			                          });
 		}
 
 	);
@@ -325,6 +400,17 @@ bool UFoliageCaptureComponent::IsReadyToUpdate() const
 	return bReadyToUpdate;
 }
 
+void UFoliageCaptureComponent::SetReadyToUpdate(bool bNewState)
+{
+	bReadyToUpdate = bNewState;
+
+	// The actor keeps count of building tiles so it doesn't have to poll every component
+	if (AGenericFoliageActor* Parent = Cast<AGenericFoliageActor>(GetOwner()))
+	{
+		Parent->SetTileIsBuilding(TileID, !bNewState);
+	}
+}
+
 bool UFoliageCaptureComponent::IsUsingSharedResources() const
 {
 	return bIsUsingSharedResources;
@@ -350,27 +436,23 @@ ULidarPointCloudComponent* UFoliageCaptureComponent::ResolvePointCloudComponent(
 	return PointCloudComponent;
 }
 
-void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& SceneColourData,
+void UFoliageCaptureComponent::Compute_Internal(const TSharedRef<FFoliageTileWorkContext, ESPMode::ThreadSafe>& ContextRef,
+                                                const TArray<FLinearColor>& SceneColourData,
                                                 const TArray<FLinearColor>& SceneNormalData,
                                                 const TArray<float>& SceneDepthData, int32 Width,
                                                 int32 Height)
 {
-	if (!IsValid(this))
-	{
-		UE_LOG(LogTemp, Error, TEXT("Invalid context"));
-		return;
-	}
-
-
-	AGenericFoliageActor* Parent = Cast<AGenericFoliageActor>(GetOwner());
-	check(IsValid(Parent));
+	const FFoliageTileWorkContext& Context = ContextRef.Get();
+	const double TileDiameter = Context.Diameter;
+	const FIntPoint& WorkTileID = Context.TileID;
+	const TMap<FGuid, TSharedPtr<FTiledFoliageBuilder>>& TileBuilders = Context.Builders;
 
 	bool bCanUseParallel = false;
 
-	for (UGenericFoliageType* FoliageType : Parent->FoliageTypes)
+	for (UGenericFoliageType* FoliageType : Context.FoliageTypes)
 	{
 		if (!IsValid(FoliageType)) { continue; }
-		bCanUseParallel = FoliageType->Density == 1.f && bCanUseParallel;
+		bCanUseParallel = FoliageType->Density * Context.DensityScale == 1.f && bCanUseParallel;
 	}
 
 	const bool bEnableParallel = Width <= 512 && bCanUseParallel;
@@ -378,27 +460,24 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 	auto StartPrepareSpawn = FDateTime::Now();
 
 	TMap<FGuid, TArray<FTransform>> FoliageTransforms;
-	for (UGenericFoliageType* FoliageType : Parent->FoliageTypes)
+	for (UGenericFoliageType* FoliageType : Context.FoliageTypes)
 	{
 		if (!IsValid(FoliageType))
 		{
 			continue;
 		}
 
-		if ((!Parent->TileInstancedMeshPools[TileID]->HISMPool.Contains(FoliageType->GetGuid())))
+		// Builders are only created for types which have a HISM in this tile
+		if (!TileBuilders.Contains(FoliageType->GetGuid()))
 		{
 			UE_LOG(LogGenericFoliage, Error, TEXT("Tiled HISM not created for all foliage types!"));
+			ReleaseTile(Context);
 			return;
 		}
-
-		if (!Builders.Contains(FoliageType->GetGuid()))
-		{
-			UE_LOG(LogGenericFoliage, Error, TEXT("Builders were not initialized properly"));
-			return;
-		}
-		if (!Builders[FoliageType->GetGuid()].IsValid())
+		if (!TileBuilders[FoliageType->GetGuid()].IsValid())
 		{
 			UE_LOG(LogGenericFoliage, Error, TEXT("Builders were not initialized properly"));
+			ReleaseTile(Context);
 			return;
 		}
 
@@ -411,8 +490,8 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 	}
 
 	FTransform AbsoluteTransform = FTransform(
-		GetComponentTransform().TransformRotation(FRotator(0.0, 90.0, 90.0).Quaternion()),
-		GetComponentLocation()
+		Context.ComponentTransform.TransformRotation(FRotator(0.0, 90.0, 90.0).Quaternion()),
+		Context.ComponentTransform.GetLocation()
 	);
 
 	auto SampleGridColour = [](const TArray<FLinearColor>& InData, const float& U, const float& V, const int32& Width,
@@ -471,12 +550,17 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 
 	if (bEnableParallel)
 	{
-		for (UGenericFoliageType* FoliageType : Parent->FoliageTypes)
+		for (UGenericFoliageType* FoliageType : Context.FoliageTypes)
 		{
 			if (!IsValid(FoliageType))
 			{
 				continue;
 			}
+			if (Context.IsStale())
+			{
+				return;
+			}
+
 			FGuid Guid = FoliageType->GetGuid();
 			TArray<FTransform>& TransformsArray = FoliageTransforms[Guid];
 			ParallelFor(Width * Height, [&](int32 Index)
@@ -486,9 +570,9 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 				const float& Depth = SceneDepthData[Index];
 
 				FVector RelativePosition = FVector(
-					FMath::Lerp(-Diameter / 2.0, Diameter / 2.0,
+					FMath::Lerp(-TileDiameter / 2.0, TileDiameter / 2.0,
 					            static_cast<double>(x) / static_cast<double>(Width)),
-					FMath::Lerp(-Diameter / 2.0, Diameter / 2.0,
+					FMath::Lerp(-TileDiameter / 2.0, TileDiameter / 2.0,
 					            static_cast<double>(y) / static_cast<double>(Height)),
 					-Depth
 				);;
@@ -541,26 +625,32 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 	{
 		for (int32 y = 0; y < Height; ++y)
 		{
+			if (Context.IsStale())
+			{
+				return;
+			}
+
 			for (int32 x = 0; x < Width; ++x)
 			{
 				const int32 i = y * Width + x;
 
-				for (UGenericFoliageType* FoliageType : Parent->FoliageTypes)
+				for (UGenericFoliageType* FoliageType : Context.FoliageTypes)
 				{
 					if (!IsValid(FoliageType))
 					{
 						continue;
 					}
 
-					// TODO: Find nearest tile to camera
-					if (FoliageType->bOnlySpawnInNearestTile && TileID.X != 0 && TileID.Y != 0)
+					if (FoliageType->bOnlySpawnInNearestTile && !Context.bIsNearestTile)
 					{
 						continue;
 					}
 
-					if (FoliageType->Density > 1.f)
+					const float Density = FoliageType->Density * Context.DensityScale;
+
+					if (Density > 1.f)
 					{
-						int32 NumBetweenPixels = FMath::RoundToInt32(FoliageType->Density);
+						int32 NumBetweenPixels = FMath::RoundToInt32(Density);
 						for (int32 OffsetX = 0; OffsetX < NumBetweenPixels; ++OffsetX)
 						{
 							for (int32 OffsetY = 0; OffsetY < NumBetweenPixels; ++OffsetY)
@@ -584,9 +674,9 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 										SceneDepthData, NewX, NewY, Width, Height);
 
 									FVector RelativePosition = FVector(
-										FMath::Lerp(-Diameter / 2.0, Diameter / 2.0,
+										FMath::Lerp(-TileDiameter / 2.0, TileDiameter / 2.0,
 										            static_cast<double>(x) / static_cast<double>(Width)),
-										FMath::Lerp(-Diameter / 2.0, Diameter / 2.0,
+										FMath::Lerp(-TileDiameter / 2.0, TileDiameter / 2.0,
 										            static_cast<double>(y) / static_cast<double>(Height)),
 										-DepthAtPoint
 									);
@@ -627,7 +717,7 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 					}
 					else
 					{
-						int32 NumBetweenPixels = FMath::RoundToInt32(1.f / FoliageType->Density);
+						int32 NumBetweenPixels = FMath::Max(FMath::RoundToInt32(1.f / Density), 1);
 						if ((x % NumBetweenPixels) == 0 && (y % NumBetweenPixels) == 0)
 						{
 							float Depth = 0.f;
@@ -637,9 +727,9 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 							}
 
 							FVector RelativePosition = FVector(
-								FMath::Lerp(-Diameter / 2.0, Diameter / 2.0,
+								FMath::Lerp(-TileDiameter / 2.0, TileDiameter / 2.0,
 								            static_cast<double>(x) / static_cast<double>(Width)),
-								FMath::Lerp(-Diameter / 2.0, Diameter / 2.0,
+								FMath::Lerp(-TileDiameter / 2.0, TileDiameter / 2.0,
 								            static_cast<double>(y) / static_cast<double>(Height)),
 								-Depth
 							);
@@ -687,18 +777,59 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 
 	auto EndPrepareSpawn = FDateTime::Now();
 
-	for (UGenericFoliageType* FoliageType : Parent->FoliageTypes)
+	/*
+	if (bEnableParallel)
+	{
+		UE_LOG(LogGenericFoliage, Display, TEXT("Time taken to compute foliage transforms (parallel): %f seconds"),
+		       (EndPrepareSpawn - StartPrepareSpawn).GetTotalSeconds());
+	}
+	else
+	{
+		UE_LOG(LogGenericFoliage, Display, TEXT("Time taken to compute foliage transforms (standard): %f seconds"),
+		       (EndPrepareSpawn - StartPrepareSpawn).GetTotalSeconds());
+	}
+	*/
+
+	if (Context.IsStale())
+	{
+		return;
+	}
+
+	Context.Pipeline->Submit(EFoliagePipelineStage::Build, [ContextRef, FoliageTransforms = MoveTemp(FoliageTransforms)](
+		                         FFoliagePipelineTicketPtr) mutable
+		                         {
+			                         Build_Internal(ContextRef, MoveTemp(FoliageTransforms));
+		                         });
+}
+
+void UFoliageCaptureComponent::Build_Internal(const TSharedRef<FFoliageTileWorkContext, ESPMode::ThreadSafe>& ContextRef,
+                                              TMap<FGuid, TArray<FTransform>>&& FoliageTransforms)
+{
+	const FFoliageTileWorkContext& Context = ContextRef.Get();
+	const TMap<FGuid, TSharedPtr<FTiledFoliageBuilder>>& TileBuilders = Context.Builders;
+
+	for (UGenericFoliageType* FoliageType : Context.FoliageTypes)
 	{
+		if (Context.IsStale())
+		{
+			return;
+		}
+
+		if (!IsValid(FoliageType))
+		{
+			continue;
+		}
+
 		FGuid Guid = FoliageType->GetGuid();
 
 		const TArray<FTransform>& Transforms = FoliageTransforms[Guid];
-		if (Builders.Contains(Guid))
+		if (TileBuilders.Contains(Guid))
 		{
-			if (Builders[Guid].IsValid())
+			if (TileBuilders[Guid].IsValid())
 			{
 				if (Transforms.Num() > 0)
 				{
-					Builders[Guid]->Build(Transforms);
+					TileBuilders[Guid]->Build(Transforms);
 				}
 				else
 				{
@@ -712,96 +843,169 @@ void UFoliageCaptureComponent::Compute_Internal(const TArray<FLinearColor>& Scen
 		}
 	}
 
-	/*
-	if (bEnableParallel)
+	if (Context.IsStale())
 	{
-		UE_LOG(LogGenericFoliage, Display, TEXT("Time taken to compute foliage transforms (parallel): %f seconds"),
-		       (EndPrepareSpawn - StartPrepareSpawn).GetTotalSeconds());
+		return;
 	}
-	else
+
+	Context.Pipeline->Submit(EFoliagePipelineStage::Apply, [ContextRef, FoliageTransforms = MoveTemp(FoliageTransforms)](
+		                         FFoliagePipelineTicketPtr Ticket) mutable
+		                         {
+			                         Apply_Internal(ContextRef.Get(), MoveTemp(FoliageTransforms), Ticket);
+		                         });
+}
+
+void UFoliageCaptureComponent::Apply_Internal(const FFoliageTileWorkContext& Context,
+                                              TMap<FGuid, TArray<FTransform>>&& FoliageTransforms,
+                                              const FFoliagePipelineTicketPtr& Ticket)
+{
+	const FIntPoint& WorkTileID = Context.TileID;
+
+	if (Context.IsStale())
 	{
-		UE_LOG(LogGenericFoliage, Display, TEXT("Time taken to compute foliage transforms (standard): %f seconds"),
-		       (EndPrepareSpawn - StartPrepareSpawn).GetTotalSeconds());
+		return;
 	}
-	*/
 
-	AsyncTask(ENamedThreads::GameThread, [this, FoliageTransforms = MoveTemp(FoliageTransforms), Parent]()
+	// HISMs are resolved once the apply tasks run on the game thread. Every task re-checks the generation, so a
+	// tile that is re-queued mid-apply stops applying stale instances. Each task holds the apply ticket, the tile
+	// leaves the stage once the last of them has run or been discarded.
+	const int32 NumInstancesPerChunk = 25000;
+	FFoliageTaskQueue& FoliageQueue = Context.FoliageQueue.Get();
+	const TWeakObjectPtr<UFoliageCaptureComponent> WeakThis = Context.Component;
+	const uint32 Generation = Context.Generation;
+
+	for (UGenericFoliageType* FoliageType : Context.FoliageTypes)
 	{
-		if (!IsValid(this))
+		if (!IsValid(FoliageType))
 		{
-			return;
+			continue;
 		}
-		
-		for (UGenericFoliageType* FoliageType : Parent->FoliageTypes)
-		{
-			if (!IsValid(FoliageType))
-			{
-				continue;
-			}
 
-			const TArray<FTransform>& Transforms = FoliageTransforms[FoliageType->GetGuid()];
+		const FGuid Guid = FoliageType->GetGuid();
+		TArray<FTransform>& Transforms = FoliageTransforms[Guid];
 
-			// UE_LOG(LogGenericFoliage, Display, TEXT("Adding Foliage: %i"), Transforms.Num());
+		// UE_LOG(LogGenericFoliage, Display, TEXT("Adding Foliage: %i"), Transforms.Num());
 
-			if (Transforms.Num() > 0)
+		// Cleared even without new instances, a recycled slot would otherwise keep the ones of its previous tile
+		FoliageQueue.Enqueue(WorkTileID, [WeakThis, Generation, Guid, Ticket]()
+		{
+			if (UHierarchicalInstancedStaticMeshComponent* HISM = GetTileHISM(WeakThis, Generation, Guid))
 			{
-				auto HISM = Parent->TileInstancedMeshPools[TileID]->HISMPool[FoliageType->GetGuid()];
+				HISM->bAutoRebuildTreeOnInstanceChanges = false;
+				HISM->ClearInstances();
+			}
+		});
 
-				Parent->EnqueueFoliageTickTask([HISM]()
-				{
-					HISM->ClearInstances();
-				});
+		if (Transforms.Num() == 0)
+		{
+			continue;
+		}
 
-				const int32 NumInstancesPerChunk = 25000;
-				const int32 ExpectedChunks = Transforms.Num() / NumInstancesPerChunk;
+		if (Transforms.Num() > NumInstancesPerChunk)
+		{
+			for (int32 StartIndex = 0; StartIndex < Transforms.Num(); StartIndex += NumInstancesPerChunk)
+			{
+				const int32 Count = FMath::Min(NumInstancesPerChunk, Transforms.Num() - StartIndex);
 
-				HISM->bAutoRebuildTreeOnInstanceChanges = false;
-			
-				// Executes last
-				if (ExpectedChunks > 1)
-				{
-					for (int32 i = 0; i <= ExpectedChunks; ++i)
+				TArray<FTransform> ChunkedTransforms(
+					TArrayView<const FTransform>(Transforms).Slice(StartIndex, Count));
+				FoliageQueue.Enqueue(WorkTileID,
+					[WeakThis, Generation, Guid, Ticket, ChunkedTransforms = MoveTemp(ChunkedTransforms)]()
 					{
-						const int32 StartIndex = i * NumInstancesPerChunk;
-						const int32 EndIndex =
-							FMath::Clamp((i + 1) * NumInstancesPerChunk, 0, Transforms.Num() - 1);
-
-						TArray<FTransform> ChunkedTransforms(
-							TArrayView<const FTransform>(Transforms).Slice(StartIndex, (EndIndex - StartIndex)));
-						Parent->EnqueueFoliageTickTask(
-							[ChunkedTransforms = MoveTemp(ChunkedTransforms), HISM]()
-							{
-								HISM->AddInstances(
-									ChunkedTransforms, false, true
-								);
-							}
-						);
+						if (UHierarchicalInstancedStaticMeshComponent* HISM = GetTileHISM(WeakThis, Generation, Guid))
+						{
+							HISM->AddInstances(
+								ChunkedTransforms, false, true
+							);
+						}
 					}
-				}
-				else
+				);
+			}
+		}
+		else
+		{
+			FoliageQueue.Enqueue(WorkTileID, [WeakThis, Generation, Guid, Ticket, Transforms = MoveTemp(Transforms)]()
+			{
+				if (UHierarchicalInstancedStaticMeshComponent* HISM = GetTileHISM(WeakThis, Generation, Guid))
 				{
-					Parent->EnqueueFoliageTickTask([HISM, Transforms]()
-					{
-						HISM->AddInstances(
-							Transforms, false, true
-						);
-					});
+					HISM->AddInstances(
+						Transforms, false, true
+					);
 				}
-				
-				Parent->EnqueueFoliageTickTask([HISM]() {
-					HISM->BuildTreeIfOutdated(true, false);
-				});
-			}
-			
+			});
 		}
 
-		Parent->EnqueueFoliageTickTask([this]()
+		// Executes last
+		FoliageQueue.Enqueue(WorkTileID, [WeakThis, Generation, Guid, Ticket]()
 		{
-			this->bReadyToUpdate = true;
+			if (UHierarchicalInstancedStaticMeshComponent* HISM = GetTileHISM(WeakThis, Generation, Guid))
+			{
+				HISM->BuildTreeIfOutdated(true, false);
+			}
 		});
+	}
+
+	ReleaseTile(Context, Ticket);
+}
+
+void UFoliageCaptureComponent::ReleaseTile(const FFoliageTileWorkContext& Context,
+                                           const FFoliagePipelineTicketPtr& Ticket)
+{
+	const TWeakObjectPtr<UFoliageCaptureComponent> WeakThis = Context.Component;
+	const uint32 Generation = Context.Generation;
+
+	Context.FoliageQueue->Enqueue(Context.TileID, [WeakThis, Generation, Ticket]()
+	{
+		UFoliageCaptureComponent* This = WeakThis.Get();
+		if (IsValid(This) && This->GetGeneration() == Generation)
+		{
+			This->SetReadyToUpdate(true);
+		}
 	});
 }
 
+UHierarchicalInstancedStaticMeshComponent* UFoliageCaptureComponent::GetTileHISM(
+	const TWeakObjectPtr<UFoliageCaptureComponent>& WeakComponent, uint32 Generation, const FGuid& Guid)
+{
+	check(IsInGameThread());
+
+	const UFoliageCaptureComponent* Component = WeakComponent.Get();
+	if (!IsValid(Component) || Component->GetGeneration() != Generation)
+	{
+		return nullptr;
+	}
+
+	const AGenericFoliageActor* Parent = Cast<AGenericFoliageActor>(Component->GetOwner());
+	if (!IsValid(Parent))
+	{
+		return nullptr;
+	}
+
+	const UFoliageInstancedMeshPool* MeshPool = Parent->GetTileMeshPool(Component->TileID);
+	if (!MeshPool)
+	{
+		return nullptr;
+	}
+
+	UHierarchicalInstancedStaticMeshComponent* const* HISM = MeshPool->HISMPool.Find(Guid);
+	return HISM && IsValid(*HISM) ? *HISM : nullptr;
+}
+
+uint32 UFoliageCaptureComponent::GetGeneration() const
+{
+	return GenerationState->Value.load(std::memory_order_acquire);
+}
+
+void UFoliageCaptureComponent::InvalidateWork()
+{
+	check(IsInGameThread());
+
+	GenerationState->Value.fetch_add(1, std::memory_order_acq_rel);
+
+	// Whatever was in flight for the old generation will drop itself, so the tile is free to be updated again
+	SetReadyToUpdate(true);
+}
+
 TMap<FGuid, TSharedPtr<FTiledFoliageBuilder>> UFoliageCaptureComponent::CreateFoliageBuilders() const
 {
 	AGenericFoliageActor* Parent = Cast<AGenericFoliageActor>(GetOwner());
@@ -809,19 +1013,25 @@ TMap<FGuid, TSharedPtr<FTiledFoliageBuilder>> UFoliageCaptureComponent::CreateFo
 
 	TMap<FGuid, TSharedPtr<FTiledFoliageBuilder>> Result;
 
+	const UFoliageInstancedMeshPool* MeshPool = Parent->GetTileMeshPool(TileID);
+	if (!MeshPool)
+	{
+		return Result;
+	}
+
 	for (UGenericFoliageType* FoliageType : Parent->FoliageTypes)
 	{
 		// TODO: Is Grass
 		if (FoliageType != nullptr)
 		{
 			FGuid Guid = FoliageType->GetGuid();
-			if (Parent->TileInstancedMeshPools[TileID]->HISMPool.Contains(Guid))
+			if (UHierarchicalInstancedStaticMeshComponent* const* HISM = MeshPool->HISMPool.Find(Guid))
 			{
 				Result.Emplace(
 					Guid,
 					MakeShareable(new
 						FTiledFoliageBuilder(
-							Parent->TileInstancedMeshPools[TileID]->HISMPool[Guid]->GetComponentTransform(),
+							(*HISM)->GetComponentTransform(),
 							FoliageType->FoliageMesh->GetBoundingBox()
 						))
 				);
@@ -36,6 +36,9 @@ void UFoliageInstancedMeshPool::OnComponentDestroyed(bool bDestroyingHierarchy)
 		HISMPair.Value->DestroyComponent();
 	}
 	HISMPool.Empty();
+	InstanceOwners.Empty();
+	StagedInstances.Empty();
+	NumStagedInstances = 0;
 }
 
 
@@ -63,6 +66,9 @@ void UFoliageInstancedMeshPool::RebuildHISMPool(const TArray<UGenericFoliageType
 	
 		HISMPool.Reset();
 	}
+	InstanceOwners.Reset();
+	StagedInstances.Reset();
+	NumStagedInstances = 0;
 	
 	FoliageTypes = InFoliageTypes;
 
@@ -101,10 +107,17 @@ void UFoliageInstancedMeshPool::RebuildHISMPool(const TArray<UGenericFoliageType
 			HISM->bHasPerInstanceHitProxies = false;
 			
 		}
-		else
+		else if (bEnableCollision)
 		{
 			HISM->SetCollisionEnabled(FoliageType->IsCollisionEnabled);
 		}
+		else
+		{
+			// Start in the state ToggleCollision(false) would leave it in, it only acts on changes
+			HISM->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			HISM->bDisableCollision = true;
+			HISM->SetCanEverAffectNavigation(false);
+		}
 		HISM->RegisterComponent();
 
 		HISMPool.Add(FoliageType->GetGuid(), HISM);
@@ -148,6 +161,19 @@ void UFoliageInstancedMeshPool::ToggleCollision(bool bNewEnableCollision)
 	}
 }
 
+bool UFoliageInstancedMeshPool::HasAllFoliageTypes() const
+{
+	for (UGenericFoliageType* FoliageType : FoliageTypes)
+	{
+		if (!IsValid(FoliageType) || !HISMPool.Contains(FoliageType->GetGuid()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
 int32 UFoliageInstancedMeshPool::GetTotalInstanceCount() const
 {
 	int32 Count = 0;
@@ -162,3 +188,184 @@ int32 UFoliageInstancedMeshPool::GetTotalInstanceCount() const
 	
 	return Count;
 }
+
+void UFoliageInstancedMeshPool::AddOwnedInstances(const FGuid& FoliageTypeGuid, int32 Owner,
+                                                  const TArray<FTransform>& Transforms)
+{
+	TArray<int32> Owners;
+	Owners.Init(Owner, Transforms.Num());
+	AddInstancesWithOwners(FoliageTypeGuid, Transforms, Owners);
+}
+
+void UFoliageInstancedMeshPool::AddInstancesWithOwners(const FGuid& FoliageTypeGuid,
+                                                       const TArray<FTransform>& Transforms,
+                                                       TArrayView<const int32> Owners)
+{
+	UHierarchicalInstancedStaticMeshComponent** HISM = HISMPool.Find(FoliageTypeGuid);
+	if (!HISM || !IsValid(*HISM) || Transforms.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<int32>& InstanceOwner = InstanceOwners.FindOrAdd(FoliageTypeGuid);
+
+	// Instances that were added directly to the HISM have no owner
+	const int32 NumInstances = (*HISM)->GetInstanceCount();
+	InstanceOwner.Reserve(NumInstances + Transforms.Num());
+	while (InstanceOwner.Num() < NumInstances)
+	{
+		InstanceOwner.Add(INDEX_NONE);
+	}
+
+	(*HISM)->AddInstances(Transforms, false, true);
+	InstanceOwner.Append(Owners.GetData(), Owners.Num());
+}
+
+void UFoliageInstancedMeshPool::RemoveOwnedInstances(const TSet<int32>& Owners)
+{
+	check(IsInGameThread());
+	if (Owners.Num() == 0)
+	{
+		return;
+	}
+
+	for (auto It = StagedInstances.CreateIterator(); It; ++It)
+	{
+		FStagedInstances& Staged = It.Value();
+		for (int32 Index = Staged.Owners.Num() - 1; Index >= 0; --Index)
+		{
+			if (Owners.Contains(Staged.Owners[Index]))
+			{
+				Staged.Transforms.RemoveAtSwap(Index, 1, false);
+				Staged.Owners.RemoveAtSwap(Index, 1, false);
+				--NumStagedInstances;
+			}
+		}
+
+		if (Staged.Owners.Num() == 0)
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	TArray<int32> InstancesToRemove;
+
+	for (auto& OwnersPair : InstanceOwners)
+	{
+		UHierarchicalInstancedStaticMeshComponent** HISM = HISMPool.Find(OwnersPair.Key);
+		if (!HISM || !IsValid(*HISM))
+		{
+			continue;
+		}
+
+		TArray<int32>& InstanceOwner = OwnersPair.Value;
+
+		InstancesToRemove.Reset();
+		for (int32 Index = InstanceOwner.Num() - 1; Index >= 0; --Index)
+		{
+			if (Owners.Contains(InstanceOwner[Index]))
+			{
+				InstancesToRemove.Add(Index);
+			}
+		}
+
+		if (InstancesToRemove.Num() == 0)
+		{
+			continue;
+		}
+
+		// The HISM removes from the highest index down, swapping the last instance into each hole. The owners follow
+		// the same moves so they stay in instance order
+		(*HISM)->RemoveInstances(InstancesToRemove);
+		for (const int32 Index : InstancesToRemove)
+		{
+			InstanceOwner.RemoveAtSwap(Index, 1, false);
+		}
+	}
+}
+
+void UFoliageInstancedMeshPool::StageOwnedInstances(const FGuid& FoliageTypeGuid, int32 Owner,
+                                                    TArray<FTransform>&& Transforms)
+{
+	if (Transforms.Num() == 0)
+	{
+		return;
+	}
+
+	FStagedInstances& Staged = StagedInstances.FindOrAdd(FoliageTypeGuid);
+	const int32 NumTransforms = Transforms.Num();
+
+	if (Staged.Transforms.Num() == 0)
+	{
+		Staged.Transforms = MoveTemp(Transforms);
+	}
+	else
+	{
+		Staged.Transforms.Append(Transforms);
+	}
+
+	Staged.Owners.Reserve(Staged.Owners.Num() + NumTransforms);
+	for (int32 Index = 0; Index < NumTransforms; ++Index)
+	{
+		Staged.Owners.Add(Owner);
+	}
+
+	NumStagedInstances += NumTransforms;
+}
+
+int32 UFoliageInstancedMeshPool::FlushStagedInstances(double BudgetSeconds)
+{
+	check(IsInGameThread());
+	if (NumStagedInstances == 0)
+	{
+		return 0;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	int32 NumAdded = 0;
+
+	TArray<FGuid> StagedTypes;
+	StagedInstances.GetKeys(StagedTypes);
+	NextStagedType = (NextStagedType + 1) % StagedTypes.Num();
+
+	for (int32 TypeIndex = 0; TypeIndex < StagedTypes.Num(); ++TypeIndex)
+	{
+		const double RemainingSeconds = BudgetSeconds - (FPlatformTime::Seconds() - StartTime);
+
+		// Every flush adds something, however small the budget
+		if (RemainingSeconds <= 0.0 && NumAdded > 0)
+		{
+			break;
+		}
+
+		const FGuid& Guid = StagedTypes[(NextStagedType + TypeIndex) % StagedTypes.Num()];
+		FStagedInstances& Staged = StagedInstances[Guid];
+
+		const int32 NumStaged = Staged.Transforms.Num();
+		const int32 Count = static_cast<int32>(FMath::Clamp(RemainingSeconds / SecondsPerInstance, 1.0,
+		                                                    static_cast<double>(NumStaged)));
+
+		const double AddStartTime = FPlatformTime::Seconds();
+
+		if (Count == NumStaged)
+		{
+			AddInstancesWithOwners(Guid, Staged.Transforms, Staged.Owners);
+			StagedInstances.Remove(Guid);
+		}
+		else
+		{
+			// Taken from the back, the order instances are added in doesn't matter
+			const TArray<FTransform> Batch(TArrayView<const FTransform>(Staged.Transforms).Right(Count));
+			AddInstancesWithOwners(Guid, Batch, TArrayView<const int32>(Staged.Owners).Right(Count));
+			Staged.Transforms.SetNum(NumStaged - Count, false);
+			Staged.Owners.SetNum(NumStaged - Count, false);
+		}
+
+		const double AddSeconds = FPlatformTime::Seconds() - AddStartTime;
+		SecondsPerInstance = FMath::Lerp(SecondsPerInstance, AddSeconds / Count, 0.25);
+		NumStagedInstances -= Count;
+		NumAdded += Count;
+	}
+
+	return NumAdded;
+}
@@ -0,0 +1,76 @@
+// Copyright Aiden. S. All Rights Reserved
+
+
+#include "Actors/FoliageTileGrid.h"
+
+void FFoliageTileGrid::Reset(const FIntPoint& InExtent)
+{
+	Extent = FIntPoint(FMath::Max(InExtent.X, 0), FMath::Max(InExtent.Y, 0));
+
+	const int32 SizeX = Extent.X * 2 + 1;
+	const int32 SizeY = Extent.Y * 2 + 1;
+
+	Tiles.Reset(SizeX * SizeY);
+	for (int32 x = -Extent.X; x <= Extent.X; ++x)
+	{
+		for (int32 y = -Extent.Y; y <= Extent.Y; ++y)
+		{
+			FFoliageTile& Tile = Tiles.AddDefaulted_GetRef();
+			Tile.TileID = FIntPoint(x, y);
+		}
+	}
+
+	NumBuilding = 0;
+	NumMissingMeshes = Tiles.Num();
+}
+
+void FFoliageTileGrid::Empty()
+{
+	Tiles.Empty();
+	Extent = FIntPoint::ZeroValue;
+	NumBuilding = 0;
+	NumMissingMeshes = 0;
+}
+
+FFoliageTile* FFoliageTileGrid::Find(const FIntPoint& TileID)
+{
+	const int32 Index = GetIndex(TileID);
+	return Index != INDEX_NONE ? &Tiles[Index] : nullptr;
+}
+
+const FFoliageTile* FFoliageTileGrid::Find(const FIntPoint& TileID) const
+{
+	const int32 Index = GetIndex(TileID);
+	return Index != INDEX_NONE ? &Tiles[Index] : nullptr;
+}
+
+void FFoliageTileGrid::SetIsBuilding(const FIntPoint& TileID, bool bIsBuilding)
+{
+	FFoliageTile* Tile = Find(TileID);
+	if (Tile && Tile->bIsBuilding != bIsBuilding)
+	{
+		Tile->bIsBuilding = bIsBuilding;
+		NumBuilding += bIsBuilding ? 1 : -1;
+	}
+}
+
+void FFoliageTileGrid::SetHasAllMeshes(const FIntPoint& TileID, bool bHasAllMeshes)
+{
+	FFoliageTile* Tile = Find(TileID);
+	if (Tile && Tile->bHasAllMeshes != bHasAllMeshes)
+	{
+		Tile->bHasAllMeshes = bHasAllMeshes;
+		NumMissingMeshes += bHasAllMeshes ? -1 : 1;
+	}
+}
+
+int32 FFoliageTileGrid::GetIndex(const FIntPoint& TileID) const
+{
+	if (FMath::Abs(TileID.X) > Extent.X || FMath::Abs(TileID.Y) > Extent.Y || Tiles.Num() == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	// Same x-major order the tiles are allocated in
+	return (TileID.X + Extent.X) * (Extent.Y * 2 + 1) + (TileID.Y + Extent.Y);
+}
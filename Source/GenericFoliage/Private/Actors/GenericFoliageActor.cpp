@@ -6,6 +6,7 @@
 #include "GenericFoliage.h"
 #include "Actors/Components/FoliageCaptureComponent.h"
 #include "Actors/Components/FoliageInstancedMeshPool.h"
+#include "Async/FoliageWorkerPool.h"
 #include "Components/SceneCaptureComponent2D.h"
 #include "GameFramework/PlayerController.h"
 #include "Engine/TextureRenderTarget2D.h"
@@ -31,9 +32,16 @@ AGenericFoliageActor::AGenericFoliageActor()
 
 void AGenericFoliageActor::Setup()
 {
+	// New capture components don't cover any world tile yet
+	bHasGridCenter = false;
+
 	SetupFoliageCaptureComponents();
 	RebuildInstancedMeshPool(true);
 	SetupTextureTargets();
+	UpdatePipelineLimits();
+
+	// Starts the worker pool here on the game thread if nothing has yet, it reads the project settings
+	FFoliageWorkerPool::Get();
 
 	for (UFoliageCaptureComponent* CaptureComponent : GetFoliageCaptureComponents())
 	{
@@ -103,8 +111,7 @@ void AGenericFoliageActor::PostEditChangeProperty(FPropertyChangedEvent& Propert
 		PropertyChangedEvent.GetPropertyName()
 		== GET_MEMBER_NAME_CHECKED(AGenericFoliageActor, FoliageTypes))
 	{
-		CaptureTickQueue.Empty();
-		FoliageTickQueue.Empty();
+		CancelPendingWork();
 		if (HasAnyFoliageTypes())
 		{
 			Setup();
@@ -112,6 +119,8 @@ void AGenericFoliageActor::PostEditChangeProperty(FPropertyChangedEvent& Propert
 		}
 	}
 
+	UpdatePipelineLimits();
+
 	if (bUpdateFoliage)
 	{
 		bForceUpdate = true;
@@ -137,75 +146,85 @@ void AGenericFoliageActor::Tick(float DeltaTime)
 
 	GEngine->AddOnScreenDebugMessage(
 		-1, DeltaTime, FColor::Red, FString::Printf(
-			TEXT("%s - Tiles building: [%s] - Instance count: %i - CanUpdate: %s"),
+			TEXT("%s - Tiles building: [%s] - Instance count: %i - CanUpdate: %s - Queued: %i/%i (%.1f ms) - Compute: %.1f ms"),
 			*GetName(), *FString::Join(TilesCurrentlyBuilding, TEXT(", ")),
-			InstanceCount, IsReadyToUpdate() ? TEXT("true") : TEXT("false")
+			InstanceCount, IsReadyToUpdate() ? TEXT("true") : TEXT("false"),
+			CaptureTickQueue->Num(), FoliageTickQueue->Num(), GetFoliageQueueStats().AverageLatency * 1000.0,
+			GetPipelineStageStats(EFoliagePipelineStage::Compute).AverageTime * 1000.0
 		)
 	);
 	*/
 
 	// __
 
+	bool bHasCamera = false;
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	float ViewFOV = 90.f;
+
+	GetCameraInfo(ViewLocation, ViewRotation, ViewFOV, bHasCamera);
+	if (bHasCamera)
+	{
+		UpdateTilePriorities(ViewLocation, ViewRotation, ViewFOV);
+		RecordCameraSample(ViewLocation);
+	}
+
 	if (UpdateTime > UpdateFrequency && !bDisableUpdates && IsReadyToUpdate())
 	{
 		UpdateTime = 0.f;
 
-		bool bHasCamera = false;
-		FVector CameraLocation;
-		FRotator CameraRotation;
-
-		GetCameraInfo(CameraLocation, CameraRotation, bHasCamera);
 		if (bHasCamera)
 		{
+			FVector CameraLocation = ViewLocation;
+
 			double Velocity = (CameraLocation - LastCameraPosition).Length();
 			LastCameraPosition = CameraLocation;
 
 			CameraLocation = AdjustWorldPositionHeightToPlanet(CameraLocation, 2000);
 			UpdateNearestTileID(CameraLocation);
 
-			if ((FVector::Distance(CameraLocation, LastUpdatePosition) > Diameter * (float)TileCount.Size() * 0.95 &&
-				Velocity < VelocityUpdateThreshold) || bForceUpdate)
+			const bool bIsSettled = Velocity < VelocityUpdateThreshold;
+
+			// Only recenter once the camera is past the centre tile by the hysteresis margin, so hovering over a
+			// tile edge doesn't recycle the same strip back and forth
+			const FVector2D CameraTile = WorldToTileCoordinates(CameraLocation);
+			const double RecenterDistance = 0.5 + RecenterHysteresis;
+			const bool bLeftCenterTile = !bHasGridCenter ||
+				FMath::Abs(CameraTile.X - GridCenter.X) > RecenterDistance ||
+				FMath::Abs(CameraTile.Y - GridCenter.Y) > RecenterDistance;
+
+			if ((bLeftCenterTile && bIsSettled) || (bRefinePending && bIsSettled) || bForceUpdate)
 			{
+				const FIntPoint CenterTile = GetWorldTileAt(CameraLocation);
+				const int32 NumQueued = RecenterTileGrid(CenterTile, 1.f, bForceUpdate);
 
-				UE_LOG(LogGenericFoliage, Verbose, TEXT("Updated foliage with camera position from to: %s %s"),
-					*LastUpdatePosition.ToString(),
-					*CameraLocation.ToString()
+				UE_LOG(LogGenericFoliage, Verbose, TEXT("Recentered foliage grid on tile %s, %i tiles queued"),
+					*CenterTile.ToString(), NumQueued
 				);
 
-				LastUpdatePosition = CameraLocation;
-				CaptureTickQueue.Empty();
-				FoliageTickQueue.Empty();
+				UpdateTilePriorities(ViewLocation, ViewRotation, ViewFOV);
+				bRefinePending = false;
+				bForceUpdate = false;
+			}
+			else if (!bIsSettled && bEnablePredictivePrefetch &&
+				FPlatformTime::Seconds() - LastPrefetchTime > PrefetchInterval)
+			{
+				// Build a cheap version of the tiles where the camera is heading, they get refined once it settles.
+				// Only one prefetch is in flight at a time (we're gated on IsReadyToUpdate), which spreads the work
+				const FIntPoint PredictedTile = GetWorldTileAt(PredictCameraLocation(PrefetchLookAheadTime));
 
-				for (UFoliageCaptureComponent* CaptureComponent : GetFoliageCaptureComponents())
+				if (PredictedTile != GridCenter)
 				{
-					CaptureTickQueue.Emplace([this, CaptureComponent, CameraLocation]()
-					{
-						if (IsValid(CaptureComponent))
-						{
-							const FRotator NewCameraRotation = UKismetMathLibrary::ComposeRotators(
-								FRotator(-90.f, 90, 0), CalculateEastNorthUp(CameraLocation));
-
-							CaptureComponent->DistanceAboveSurface = 2000.0;
-							CaptureComponent->SetWorldLocation(CameraLocation);
-							CaptureComponent->SetRelativeRotation(NewCameraRotation);
-
-							FVector TilePosition = CaptureComponent->GetComponentLocation() +
-								CaptureComponent->GetRightVector() * (CaptureComponent->Diameter * CaptureComponent->
-									TileID.
-									X) +
-								CaptureComponent->GetUpVector() * (CaptureComponent->Diameter * CaptureComponent->TileID
-									.Y);
-
-							CaptureComponent->SetWorldLocation(TilePosition);
-
-							CaptureComponent->PrepareForCapture(SceneColourRT, SceneNormalRT, SceneDepthRT);
-							CaptureComponent->Capture();
-							CaptureComponent->Compute();
-							CaptureComponent->Finish();
-						}
-					});
+					const int32 NumQueued = RecenterTileGrid(PredictedTile, PrefetchDensityScale, false);
+
+					UE_LOG(LogGenericFoliage, Verbose, TEXT("Prefetching foliage around predicted tile %s, %i tiles queued"),
+						*PredictedTile.ToString(), NumQueued
+					);
+
+					UpdateTilePriorities(ViewLocation, ViewRotation, ViewFOV);
+					LastPrefetchTime = FPlatformTime::Seconds();
+					bRefinePending = true;
 				}
-				bForceUpdate = false;
 			}
 		}
 	}
@@ -214,37 +233,159 @@ void AGenericFoliageActor::Tick(float DeltaTime)
 		UpdateTime += DeltaTime;
 	}
 
-	if (CaptureTickQueue.Num() > 0)
+	// Tiles overlap across the pipeline, captures only wait for room in the capture stage
+	for (int32 i = 0; i < CaptureTasksPerTick && !CaptureTickQueue->IsEmpty() && CanCapture(); ++i)
 	{
-		if (IsReadyToUpdate())
+		CaptureTickQueue->Execute(1);
+	}
+
+	FoliageTickQueue->Execute(FoliageTasksPerTick);
+}
+
+int32 AGenericFoliageActor::RecenterTileGrid(const FIntPoint& CenterTile, float DensityScale, bool bRebuildAll)
+{
+	if (bRebuildAll)
+	{
+		CancelPendingWork();
+	}
+
+	GridCenter = CenterTile;
+	bHasGridCenter = true;
+	LastUpdatePosition = GetWorldTileCenter(CenterTile);
+
+	int32 NumQueued = 0;
+
+	for (int32 x = -TileCount.X; x <= TileCount.X; ++x)
+	{
+		for (int32 y = -TileCount.Y; y <= TileCount.Y; ++y)
 		{
-			for (int32 i = 0; i < CaptureTasksPerTick; ++i)
+			const FIntPoint WorldTile = CenterTile + FIntPoint(x, y);
+
+			const FFoliageTile* Tile = TileGrid.Find(GetTileSlot(WorldTile));
+			if (!Tile || !IsValid(Tile->CaptureComponent))
 			{
-				if (CaptureTickQueue.Num() == 0)
+				continue;
+			}
+
+			UFoliageCaptureComponent* CaptureComponent = Tile->CaptureComponent;
+
+			// Tiles still covering the same world tile keep their instances, unless they were only prefetched
+			const bool bIsUpToDate = CaptureComponent->bHasWorldTile &&
+				CaptureComponent->WorldTileID == WorldTile &&
+				CaptureComponent->DensityScale >= DensityScale;
+
+			if (bIsUpToDate && !bRebuildAll)
+			{
+				continue;
+			}
+
+			// Anything queued or in flight for this slot belongs to the tile it used to cover
+			CaptureComponent->InvalidateWork();
+			PlaceCaptureComponent(CaptureComponent, WorldTile);
+			CaptureComponent->DensityScale = DensityScale;
+
+			const uint32 Generation = CaptureComponent->GetGeneration();
+			CaptureTickQueue->Enqueue(CaptureComponent->TileID, [this, CaptureComponent, Generation, DensityScale]()
+			{
+				if (IsValid(CaptureComponent) && CaptureComponent->GetGeneration() == Generation)
 				{
-					break;
+					CaptureComponent->PrepareForCapture(SceneColourRT, SceneNormalRT, SceneDepthRT);
+					CaptureComponent->Capture();
+					CaptureComponent->Compute(DensityScale);
+					CaptureComponent->Finish();
 				}
-				CaptureTickQueue[0]();
-				CaptureTickQueue.RemoveAt(0, 1, true);
-			}
+			});
+
+			++NumQueued;
 		}
 	}
 
-	if (FoliageTickQueue.Num() > 0)
+	return NumQueued;
+}
+
+void AGenericFoliageActor::PlaceCaptureComponent(UFoliageCaptureComponent* CaptureComponent,
+                                                 const FIntPoint& WorldTile) const
+{
+	const FVector TilePosition = GetWorldTileCenter(WorldTile);
+
+	CaptureComponent->WorldTileID = WorldTile;
+	CaptureComponent->bHasWorldTile = true;
+	CaptureComponent->DistanceAboveSurface = 2000.0;
+	CaptureComponent->SetWorldLocation(TilePosition);
+	CaptureComponent->SetRelativeRotation(UKismetMathLibrary::ComposeRotators(
+		FRotator(-90.f, 90, 0), CalculateEastNorthUp(TilePosition)));
+}
+
+FVector2D AGenericFoliageActor::WorldToTileCoordinates(const FVector& InWorldLocation) const
+{
+	const FVector LocalPosition = WorldToLocalPosition(InWorldLocation);
+	return FVector2D(LocalPosition.X / Diameter, LocalPosition.Y / Diameter);
+}
+
+FIntPoint AGenericFoliageActor::GetWorldTileAt(const FVector& InWorldLocation) const
+{
+	const FVector2D TileCoordinates = WorldToTileCoordinates(InWorldLocation);
+	return FIntPoint(FMath::RoundToInt32(TileCoordinates.X), FMath::RoundToInt32(TileCoordinates.Y));
+}
+
+FVector AGenericFoliageActor::GetWorldTileCenter(const FIntPoint& WorldTile) const
+{
+	return AdjustWorldPositionHeightToPlanet(
+		LocalToWorldPosition(FVector(WorldTile.X * Diameter, WorldTile.Y * Diameter, 0.0)), 2000);
+}
+
+FIntPoint AGenericFoliageActor::GetTileSlot(const FIntPoint& WorldTile) const
+{
+	// Wrap world tiles onto the (2N+1)^2 slots, neighbouring world tiles always land on different slots
+	const int32 SlotsX = TileCount.X * 2 + 1;
+	const int32 SlotsY = TileCount.Y * 2 + 1;
+
+	return FIntPoint(
+		((WorldTile.X % SlotsX) + SlotsX) % SlotsX - TileCount.X,
+		((WorldTile.Y % SlotsY) + SlotsY) % SlotsY - TileCount.Y
+	);
+}
+
+FIntPoint AGenericFoliageActor::GetGridCenter() const
+{
+	return GridCenter;
+}
+
+void AGenericFoliageActor::RecordCameraSample(const FVector& Location)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	// Keep roughly the last second of movement, enough to smooth out per-frame jitter
+	CameraSamples.RemoveAll([Now](const FCameraSample& Sample) { return Now - Sample.Time > 1.0; });
+	if (CameraSamples.Num() >= 32)
 	{
-		for (int32 i = 0; i < FoliageTasksPerTick; ++i)
-		{
-			if (FoliageTickQueue.Num() == 0)
-			{
-				break;
-			}
-			FoliageTickQueue[0]();
-			FoliageTickQueue.RemoveAt(0, 1, true);
-		}
+		CameraSamples.RemoveAt(0, 1, false);
+	}
+
+	CameraSamples.Add({Location, Now});
+}
+
+FVector AGenericFoliageActor::PredictCameraLocation(double LookAheadTime) const
+{
+	if (CameraSamples.Num() == 0)
+	{
+		return LastCameraPosition;
+	}
+
+	const FCameraSample& Oldest = CameraSamples[0];
+	const FCameraSample& Newest = CameraSamples.Last();
+	const double Elapsed = Newest.Time - Oldest.Time;
+
+	if (Elapsed <= UE_SMALL_NUMBER)
+	{
+		return Newest.Location;
 	}
+
+	const FVector CameraVelocity = (Newest.Location - Oldest.Location) / Elapsed;
+	return Newest.Location + CameraVelocity * LookAheadTime;
 }
 
-void AGenericFoliageActor::GetCameraInfo(FVector& Location, FRotator& Rotation, bool& bSuccess) const
+void AGenericFoliageActor::GetCameraInfo(FVector& Location, FRotator& Rotation, float& FOV, bool& bSuccess) const
 {
 	bSuccess = false;
 
@@ -255,6 +396,7 @@ void AGenericFoliageActor::GetCameraInfo(FVector& Location, FRotator& Rotation,
 		PC->CalcCamera(GetWorld()->GetDeltaSeconds(), ViewInfo);
 		Location = ViewInfo.Location;
 		Rotation = ViewInfo.Rotation;
+		FOV = ViewInfo.FOV;
 		bSuccess = true;
 	}
 	else
@@ -266,6 +408,7 @@ void AGenericFoliageActor::GetCameraInfo(FVector& Location, FRotator& Rotation,
 		{
 			Location = Client->GetViewLocation();
 			Rotation = Client->GetViewRotation();
+			FOV = Client->ViewFOV;
 			bSuccess = true;
 		}
 #endif
@@ -274,30 +417,21 @@ void AGenericFoliageActor::GetCameraInfo(FVector& Location, FRotator& Rotation,
 
 bool AGenericFoliageActor::IsReadyToUpdate() const
 {
-	bool bIsReadyToUpdate = true;
-	for (const UFoliageCaptureComponent* FoliageCaptureComponent : GetFoliageCaptureComponents())
-	{
-		if (IsValid(FoliageCaptureComponent))
-		{
-			bIsReadyToUpdate = bIsReadyToUpdate && (FoliageCaptureComponent->IsReadyToUpdate());
-		}
-	}
-	if (FoliageTypes.Num() == 0)
-	{
-		bIsReadyToUpdate = false;
-	}
-	else
-	{
-		for (UGenericFoliageType* FoliageType : FoliageTypes)
-		{
-			for (const auto& TilePair : TileInstancedMeshPools)
-			{
-				bIsReadyToUpdate = bIsReadyToUpdate && TilePair.Value->HISMPool.Contains(FoliageType->GetGuid());
-			}
-		}
-	}
+	return FoliageTypes.Num() > 0 && TileGrid.IsIdle();
+}
+
+bool AGenericFoliageActor::CanCapture() const
+{
+	return FoliageTypes.Num() > 0 && TileGrid.HasAllMeshes() &&
+		TilePipeline->HasCapacity(EFoliagePipelineStage::Capture);
+}
 
-	return bIsReadyToUpdate;
+void AGenericFoliageActor::UpdatePipelineLimits()
+{
+	TilePipeline->SetStageLimit(EFoliagePipelineStage::Capture, MaxTilesCapturing);
+	TilePipeline->SetStageLimit(EFoliagePipelineStage::Compute, MaxTilesComputing);
+	TilePipeline->SetStageLimit(EFoliagePipelineStage::Build, MaxTilesBuilding);
+	TilePipeline->SetStageLimit(EFoliagePipelineStage::Apply, MaxTilesApplying);
 }
 
 void AGenericFoliageActor::SetupTextureTargets()
@@ -336,76 +470,90 @@ void AGenericFoliageActor::SetupTextureTargets()
 
 void AGenericFoliageActor::SetupFoliageCaptureComponents()
 {
-	for (UFoliageCaptureComponent* CaptureComponent : GetFoliageCaptureComponents())
-	{
-		if (IsValid(CaptureComponent))
-		{
-			CaptureComponent->DestroyComponent();
-		}
-	}
+	DestroyTiles();
+
+	TileGrid.Reset(TileCount);
 
-	for (auto& KV : TileInstancedMeshPools)
+	for (FFoliageTile& Tile : TileGrid.GetTiles())
 	{
-		if (IsValid(KV.Value))
+		UFoliageCaptureComponent* FoliageCaptureComponent = Cast<UFoliageCaptureComponent>(
+			AddComponentByClass(UFoliageCaptureComponent::StaticClass(), false, FTransform::Identity, false)
+		);
+
+		check(FoliageCaptureComponent);
+		FoliageCaptureComponent->TileID = Tile.TileID;
+		FoliageCaptureComponent->AttachToComponent(GetRootComponent(),
+		                                           FAttachmentTransformRules{EAttachmentRule::KeepRelative, false});
+
+		if (!FoliageCaptureComponent->IsUsingSharedResources())
 		{
-			KV.Value->DestroyComponent();
+			FoliageCaptureComponent->SetupTextureTargets(TilePixelSize);
 		}
+
+		UFoliageInstancedMeshPool* InstancedMeshPool = Cast<UFoliageInstancedMeshPool>(
+			AddComponentByClass(UFoliageInstancedMeshPool::StaticClass(), true, FTransform::Identity, false)
+		);
+
+		check(InstancedMeshPool);
+
+		// Collision starts on the centre tile, UpdateNearestTileID moves it from there
+		InstancedMeshPool->bEnableCollision = Tile.TileID == FIntPoint::ZeroValue;
+
+		Tile.CaptureComponent = FoliageCaptureComponent;
+		Tile.MeshPool = InstancedMeshPool;
 	}
 
-	TileInstancedMeshPools.Reset();
+	NearestTileID = FIntPoint::ZeroValue;
+	LastNearestTileID = FIntPoint::ZeroValue;
+	bHasNearestTile = true;
+}
 
-	for (int x = -TileCount.X; x <= TileCount.X; ++x)
+void AGenericFoliageActor::DestroyTiles()
+{
+	for (const FFoliageTile& Tile : TileGrid.GetTiles())
 	{
-		for (int y = -TileCount.Y; y <= TileCount.Y; ++y)
+		if (IsValid(Tile.CaptureComponent))
 		{
-			UFoliageCaptureComponent* FoliageCaptureComponent = Cast<UFoliageCaptureComponent>(
-				AddComponentByClass(UFoliageCaptureComponent::StaticClass(), false, FTransform::Identity, false)
-			);
-
-			check(FoliageCaptureComponent);
-			FoliageCaptureComponent->TileID = {x, y};
-			FoliageCaptureComponent->AttachToComponent(GetRootComponent(),
-			                                           FAttachmentTransformRules{EAttachmentRule::KeepRelative, false});
-
-			if (!FoliageCaptureComponent->IsUsingSharedResources())
-			{
-				FoliageCaptureComponent->SetupTextureTargets(TilePixelSize);
-			}
+			Tile.CaptureComponent->DestroyComponent();
+		}
 
-			UFoliageInstancedMeshPool* InstancedMeshPool = Cast<UFoliageInstancedMeshPool>(
-				AddComponentByClass(UFoliageInstancedMeshPool::StaticClass(), true, FTransform::Identity, false)
-			);
+		if (IsValid(Tile.MeshPool))
+		{
+			Tile.MeshPool->DestroyComponent();
+		}
+	}
 
-			check(InstancedMeshPool);
+	TileGrid.Empty();
 
-			if (x == 0 && y == 0)
-			{
-				InstancedMeshPool->bEnableCollision = true;
-			}
-			else
-			{
-				InstancedMeshPool->bEnableCollision = false;
-			}
+	// The grid is transient, catch any capture components it lost track of (e.g. across a reconstruction)
+	TArray<USceneComponent*> ChildComponents;
+	GetRootComponent()->GetChildrenComponents(false, ChildComponents);
 
-			TileInstancedMeshPools.Add(FIntPoint(x, y), InstancedMeshPool);
+	for (USceneComponent* Comp : ChildComponents)
+	{
+		UFoliageCaptureComponent* CastedComp = Cast<UFoliageCaptureComponent>(Comp);
+		if (IsValid(CastedComp))
+		{
+			CastedComp->DestroyComponent();
 		}
 	}
 }
 
 void AGenericFoliageActor::RebuildInstancedMeshPool(bool bImmediate /* false */)
 {
-	if (TileInstancedMeshPools.Num() == 0)
+	if (TileGrid.Num() == 0)
 	{
 		return;
 	}
 
 	auto Task = [this]()
 	{
-		for (const TPair<FIntPoint, UFoliageInstancedMeshPool*>& MeshPoolPair : TileInstancedMeshPools)
+		for (FFoliageTile& Tile : TileGrid.GetTiles())
 		{
-			if (FoliageTypes.Num() > 0 && IsValid(MeshPoolPair.Value))
+			if (FoliageTypes.Num() > 0 && IsValid(Tile.MeshPool))
 			{
-				MeshPoolPair.Value->RebuildHISMPool(FoliageTypes);
+				Tile.MeshPool->RebuildHISMPool(FoliageTypes);
+				TileGrid.SetHasAllMeshes(Tile.TileID, Tile.MeshPool->HasAllFoliageTypes());
 			}
 		}
 	};
@@ -417,76 +565,122 @@ void AGenericFoliageActor::RebuildInstancedMeshPool(bool bImmediate /* false */)
 	}
 	else
 	{
-		CaptureTickQueue.Emplace(MoveTemp(Task));
+		CaptureTickQueue->Enqueue(MoveTemp(Task));
 	}
 }
 
 TArray<UFoliageCaptureComponent*> AGenericFoliageActor::GetFoliageCaptureComponents() const
 {
-	TArray<USceneComponent*> ChildComponents;
-	GetRootComponent()->GetChildrenComponents(false, ChildComponents);
-
 	TArray<UFoliageCaptureComponent*> Result;
+	Result.Reserve(TileGrid.Num());
 
-	for (USceneComponent* Comp : ChildComponents)
+	for (const FFoliageTile& Tile : TileGrid.GetTiles())
 	{
-		UFoliageCaptureComponent* CastedComp = Cast<UFoliageCaptureComponent>(Comp);
-		if (IsValid(CastedComp))
+		if (IsValid(Tile.CaptureComponent))
 		{
-			Result.Add(CastedComp);
+			Result.Add(Tile.CaptureComponent);
 		}
 	}
 
-	if (Result.Num() > 0)
-	{
-		Algo::Sort(Result, [&](const UFoliageCaptureComponent* A, const UFoliageCaptureComponent* B)
-		{
-			return A->TileID.SizeSquared() < B->TileID.SizeSquared();
-			// return FVector2D::DistSquared(FVector2D(A->TileID), FVector2D(NearestTileID)) < FVector2D::DistSquared(FVector2D(B->TileID), FVector2D(NearestTileID));
-		});
-	}
-
 	return Result;
 }
 
 void AGenericFoliageActor::UpdateNearestTileID(const FVector& InWorldLocation)
 {
-	bool bHasAnyTile = false;
-	for (const UFoliageCaptureComponent* CaptureComponent : GetFoliageCaptureComponents())
+	const FIntPoint CameraTile = GetWorldTileAt(InWorldLocation);
+
+	const bool bHadNearestTile = bHasNearestTile;
+
+	bHasNearestTile = bHasGridCenter &&
+		FMath::Abs(CameraTile.X - GridCenter.X) <= TileCount.X &&
+		FMath::Abs(CameraTile.Y - GridCenter.Y) <= TileCount.Y;
+
+	if (bHasNearestTile)
 	{
-		const FVector TransformedPosition = CaptureComponent->GetComponentTransform().
-		                                                      InverseTransformPosition(InWorldLocation);
-		if (CaptureComponent->BoundingBox.IsInsideXY(TransformedPosition))
+		NearestTileID = GetTileSlot(CameraTile);
+	}
+
+	// Only the tiles gaining or losing collision need touching
+	if (bHadNearestTile != bHasNearestTile || LastNearestTileID != NearestTileID)
+	{
+		if (UFoliageInstancedMeshPool* LastMeshPool = bHadNearestTile ? GetTileMeshPool(LastNearestTileID) : nullptr)
 		{
-			NearestTileID = CaptureComponent->TileID;
-			if (LastNearestTileID != NearestTileID)
-			{
-				TileInstancedMeshPools[NearestTileID]->ToggleCollision(true);
-			}
-			LastNearestTileID = NearestTileID;
-			bHasNearestTile = true;
-			bHasAnyTile = true;
+			LastMeshPool->ToggleCollision(false);
 		}
-		else
+
+		if (UFoliageInstancedMeshPool* MeshPool = bHasNearestTile ? GetTileMeshPool(NearestTileID) : nullptr)
 		{
-			TileInstancedMeshPools[CaptureComponent->TileID]->ToggleCollision(false);
+			MeshPool->ToggleCollision(true);
 		}
 	}
 
-	if (!bHasAnyTile)
+	LastNearestTileID = NearestTileID;
+}
+
+void AGenericFoliageActor::UpdateTilePriorities(const FVector& ViewLocation, const FRotator& ViewRotation, float FOV)
+{
+	const FVector ViewDirection = ViewRotation.Vector();
+	const double HalfFOV = FMath::DegreesToRadians(FMath::Clamp<double>(FOV, 1.0, 170.0) / 2.0);
+
+	TMap<FIntPoint, double> TilePriorities;
+	TilePriorities.Reserve(TileGrid.Num());
+
+	for (const FFoliageTile& Tile : TileGrid.GetTiles())
+	{
+		if (IsValid(Tile.CaptureComponent))
+		{
+			TilePriorities.Add(Tile.TileID,
+			                   CalculateTilePriority(Tile.CaptureComponent, ViewLocation, ViewDirection, HalfFOV));
+		}
+	}
+
+	CaptureTickQueue->SetTilePriorities(CopyTemp(TilePriorities));
+	FoliageTickQueue->SetTilePriorities(MoveTemp(TilePriorities));
+}
+
+double AGenericFoliageActor::CalculateTilePriority(const UFoliageCaptureComponent* CaptureComponent,
+                                                   const FVector& ViewLocation, const FVector& ViewDirection,
+                                                   double HalfFOV) const
+{
+	const FVector ToTile = CaptureComponent->GetComponentLocation() - ViewLocation;
+	const double Distance = ToTile.Length();
+	const double TileRadius = CaptureComponent->Diameter * UE_HALF_SQRT_2;
+
+	// Treat the tile as a bounding sphere, if we're inside it then it fills the screen
+	if (Distance <= TileRadius)
+	{
+		return 4.0;
+	}
+
+	const double AngularRadius = FMath::Asin(TileRadius / Distance);
+	const double AngleToTile = FMath::Acos(FMath::Clamp(ToTile / Distance | ViewDirection, -1.0, 1.0));
+	const bool bInFrustum = AngleToTile - AngularRadius <= HalfFOV;
+
+	// Fraction of the screen width covered by the tile
+	const double ScreenCoverage = FMath::Min(FMath::Tan(AngularRadius) / FMath::Tan(HalfFOV), 1.0);
+
+	return (bInFrustum ? 2.0 : 0.0) + ScreenCoverage + 1.0 / (1.0 + Distance / CaptureComponent->Diameter);
+}
+
+void AGenericFoliageActor::CancelPendingWork()
+{
+	CaptureTickQueue->Empty();
+	FoliageTickQueue->Empty();
+
+	for (UFoliageCaptureComponent* CaptureComponent : GetFoliageCaptureComponents())
 	{
-		bHasNearestTile = false;
+		CaptureComponent->InvalidateWork();
 	}
 }
 
 TArray<FIntPoint> AGenericFoliageActor::GetBuildingTiles() const
 {
 	TArray<FIntPoint> Result;
-	for (UFoliageCaptureComponent* CaptureComponent : GetFoliageCaptureComponents())
+	for (const FFoliageTile& Tile : TileGrid.GetTiles())
 	{
-		if (!CaptureComponent->IsReadyToUpdate())
+		if (Tile.bIsBuilding)
 		{
-			Result.Add(CaptureComponent->TileID);
+			Result.Add(Tile.TileID);
 		}
 	}
 	return Result;
@@ -496,11 +690,11 @@ int32 AGenericFoliageActor::GetTotalInstanceCount() const
 {
 	int32 Count = 0;
 
-	for (const auto& MeshPoolPair : TileInstancedMeshPools)
+	for (const FFoliageTile& Tile : TileGrid.GetTiles())
 	{
-		if (IsValid(MeshPoolPair.Value))
+		if (IsValid(Tile.MeshPool))
 		{
-			Count += MeshPoolPair.Value->GetTotalInstanceCount();
+			Count += Tile.MeshPool->GetTotalInstanceCount();
 		}
 	}
 
@@ -509,12 +703,42 @@ int32 AGenericFoliageActor::GetTotalInstanceCount() const
 
 void AGenericFoliageActor::EnqueueCaptureTickTask(TFunction<void()>&& InFunc)
 {
-	CaptureTickQueue.Emplace(InFunc);
+	CaptureTickQueue->Enqueue(MoveTemp(InFunc));
 }
 
 void AGenericFoliageActor::EnqueueFoliageTickTask(TFunction<void()>&& InFunc)
 {
-	FoliageTickQueue.Emplace(InFunc);
+	FoliageTickQueue->Enqueue(MoveTemp(InFunc));
+}
+
+void AGenericFoliageActor::EnqueueFoliageTickTask(const FIntPoint& TileID, TFunction<void()>&& InFunc)
+{
+	FoliageTickQueue->Enqueue(TileID, MoveTemp(InFunc));
+}
+
+TSharedRef<FFoliageTaskQueue, ESPMode::ThreadSafe> AGenericFoliageActor::GetFoliageTickQueue() const
+{
+	return FoliageTickQueue;
+}
+
+FFoliageTaskQueueStats AGenericFoliageActor::GetCaptureQueueStats() const
+{
+	return CaptureTickQueue->GetStats();
+}
+
+FFoliageTaskQueueStats AGenericFoliageActor::GetFoliageQueueStats() const
+{
+	return FoliageTickQueue->GetStats();
+}
+
+TSharedRef<FFoliageTilePipeline, ESPMode::ThreadSafe> AGenericFoliageActor::GetTilePipeline() const
+{
+	return TilePipeline;
+}
+
+FFoliagePipelineStageStats AGenericFoliageActor::GetPipelineStageStats(EFoliagePipelineStage Stage) const
+{
+	return TilePipeline->GetStats(Stage);
 }
 
 FVector AGenericFoliageActor::WorldToLocalPosition(const FVector& InWorldLocation) const
@@ -561,6 +785,17 @@ void AGenericFoliageActor::SetShowOnlyActors(TArray<AActor*> InShowOnlyActors)
 	}
 }
 
+UFoliageInstancedMeshPool* AGenericFoliageActor::GetTileMeshPool(const FIntPoint& TileID) const
+{
+	const FFoliageTile* Tile = TileGrid.Find(TileID);
+	return Tile && IsValid(Tile->MeshPool) ? Tile->MeshPool : nullptr;
+}
+
+void AGenericFoliageActor::SetTileIsBuilding(const FIntPoint& TileID, bool bIsBuilding)
+{
+	TileGrid.SetIsBuilding(TileID, bIsBuilding);
+}
+
 void AGenericFoliageActor::SetIsReadyToUpdate(bool bNewState)
 {
 	bReadyToUpdate = bNewState;
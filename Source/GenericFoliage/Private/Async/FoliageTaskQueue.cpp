@@ -0,0 +1,267 @@
+// Copyright Aiden. S. All Rights Reserved
+
+
+#include "Async/FoliageTaskQueue.h"
+
+#include "GenericFoliage.h"
+
+// Weight of the newest sample in the smoothed latency
+#define LATENCY_SMOOTHING 0.05
+
+FFoliageTaskQueue::FFoliageTaskQueue(uint32 InCapacity)
+{
+	Capacity = FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(InCapacity, 2));
+	Mask = Capacity - 1;
+
+	Slots = MakeUnique<FSlot[]>(Capacity);
+	for (uint64 i = 0; i < Capacity; ++i)
+	{
+		Slots[i].Sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+void FFoliageTaskQueue::Enqueue(TFunction<void()>&& InTask)
+{
+	Enqueue(FTask{MoveTemp(InTask), FPlatformTime::Seconds()});
+}
+
+void FFoliageTaskQueue::Enqueue(const FIntPoint& TileID, TFunction<void()>&& InTask)
+{
+	Enqueue(FTask{MoveTemp(InTask), FPlatformTime::Seconds(), TileID, true});
+}
+
+void FFoliageTaskQueue::Enqueue(FTask&& InTask)
+{
+	// Once anything has spilled, keep spilling until the consumer catches up so tasks stay in order
+	if (OverflowNum.load(std::memory_order_acquire) > 0 || !TryEnqueueRing(InTask))
+	{
+		Overflow.Enqueue(MoveTemp(InTask));
+		OverflowNum.fetch_add(1, std::memory_order_release);
+	}
+}
+
+int32 FFoliageTaskQueue::Execute(int32 MaxTasks)
+{
+	int32 NumRun = 0;
+	FTask Task;
+
+	while (NumRun < MaxTasks)
+	{
+		// Restage every iteration so work enqueued by a task can still be picked up in priority order, this only
+		// tops the staging up to its limit
+		Stage();
+
+		if (!PopStaged(Task))
+		{
+			break;
+		}
+
+		RecordLatency(Task.EnqueueTime);
+		if (Task.Function)
+		{
+			Task.Function();
+		}
+		++NumRun;
+	}
+
+	return NumRun;
+}
+
+void FFoliageTaskQueue::SetTilePriorities(TMap<FIntPoint, double>&& InTilePriorities)
+{
+	TilePriorities = MoveTemp(InTilePriorities);
+	bHasBestTile = false;
+}
+
+void FFoliageTaskQueue::Empty()
+{
+	FTask Task;
+	while (TryDequeueRing(Task))
+	{
+	}
+
+	while (Overflow.Dequeue(Task))
+	{
+		OverflowNum.fetch_sub(1, std::memory_order_release);
+	}
+
+	StagedUntiled.Empty();
+	StagedTiles.Empty();
+	bHasBestTile = false;
+	NumStaged.store(0, std::memory_order_relaxed);
+
+	MaxLatency = 0.0;
+}
+
+int32 FFoliageTaskQueue::Num() const
+{
+	const uint64 Head = DequeuePos.load(std::memory_order_relaxed);
+	const uint64 Tail = EnqueuePos.load(std::memory_order_relaxed);
+	const int64 Spilled = FMath::Max<int64>(OverflowNum.load(std::memory_order_relaxed), 0);
+
+	return static_cast<int32>((Tail > Head ? Tail - Head : 0) + Spilled) + NumStaged.load(std::memory_order_relaxed);
+}
+
+bool FFoliageTaskQueue::IsEmpty() const
+{
+	return Num() == 0;
+}
+
+FFoliageTaskQueueStats FFoliageTaskQueue::GetStats() const
+{
+	FFoliageTaskQueueStats Stats;
+	Stats.Depth = Num();
+	Stats.OverflowDepth = static_cast<int32>(FMath::Max<int64>(OverflowNum.load(std::memory_order_relaxed), 0));
+	Stats.AverageLatency = AverageLatency;
+	Stats.MaxLatency = MaxLatency;
+	Stats.NumExecuted = NumExecuted;
+	return Stats;
+}
+
+bool FFoliageTaskQueue::TryEnqueueRing(FTask& InTask)
+{
+	uint64 Pos = EnqueuePos.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		FSlot& Slot = Slots[Pos & Mask];
+		const uint64 Sequence = Slot.Sequence.load(std::memory_order_acquire);
+		const int64 Diff = static_cast<int64>(Sequence) - static_cast<int64>(Pos);
+
+		if (Diff == 0)
+		{
+			// Slot is free for this position, try to claim it
+			if (EnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+			{
+				Slot.Task = MoveTemp(InTask);
+				Slot.Sequence.store(Pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (Diff < 0)
+		{
+			// The consumer hasn't released this slot yet, ring is full
+			return false;
+		}
+		else
+		{
+			Pos = EnqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool FFoliageTaskQueue::TryDequeueRing(FTask& OutTask)
+{
+	const uint64 Pos = DequeuePos.load(std::memory_order_relaxed);
+	FSlot& Slot = Slots[Pos & Mask];
+
+	const uint64 Sequence = Slot.Sequence.load(std::memory_order_acquire);
+	if (static_cast<int64>(Sequence) - static_cast<int64>(Pos + 1) < 0)
+	{
+		return false;
+	}
+
+	OutTask = MoveTemp(Slot.Task);
+	Slot.Task = FTask();
+	Slot.Sequence.store(Pos + Capacity, std::memory_order_release);
+	DequeuePos.store(Pos + 1, std::memory_order_relaxed);
+	return true;
+}
+
+void FFoliageTaskQueue::Stage()
+{
+	FTask Task;
+	while (NumStaged.load(std::memory_order_relaxed) < static_cast<int32>(Capacity))
+	{
+		if (!TryDequeueRing(Task))
+		{
+			if (!Overflow.Dequeue(Task))
+			{
+				break;
+			}
+			OverflowNum.fetch_sub(1, std::memory_order_release);
+		}
+
+		if (Task.bHasTile)
+		{
+			// A tile new to the staging may outrank the one being popped
+			if (TRingBuffer<FTask>* Tasks = StagedTiles.Find(Task.TileID))
+			{
+				Tasks->Add(MoveTemp(Task));
+			}
+			else
+			{
+				StagedTiles.Add(Task.TileID).Add(MoveTemp(Task));
+				bHasBestTile = false;
+			}
+		}
+		else
+		{
+			StagedUntiled.Add(MoveTemp(Task));
+		}
+		NumStaged.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+bool FFoliageTaskQueue::PopStaged(FTask& OutTask)
+{
+	if (!StagedUntiled.IsEmpty())
+	{
+		OutTask = StagedUntiled.PopFrontValue();
+		NumStaged.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Only a handful of tiles have work at once, a linear scan is cheaper than keeping a heap in sync. It only
+	// runs when the best tile may have changed, otherwise the last one keeps being popped
+	TRingBuffer<FTask>* BestTasks = bHasBestTile ? StagedTiles.Find(BestTileID) : nullptr;
+
+	if (!BestTasks)
+	{
+		double BestPriority = -DBL_MAX;
+
+		for (TPair<FIntPoint, TRingBuffer<FTask>>& TilePair : StagedTiles)
+		{
+			const double* Priority = TilePriorities.Find(TilePair.Key);
+			const double TilePriority = Priority ? *Priority : -DBL_MAX;
+
+			if (!BestTasks || TilePriority > BestPriority)
+			{
+				BestTasks = &TilePair.Value;
+				BestTileID = TilePair.Key;
+				BestPriority = TilePriority;
+			}
+		}
+
+		if (!BestTasks)
+		{
+			return false;
+		}
+
+		bHasBestTile = true;
+	}
+
+	OutTask = BestTasks->PopFrontValue();
+	NumStaged.fetch_sub(1, std::memory_order_relaxed);
+
+	if (BestTasks->IsEmpty())
+	{
+		StagedTiles.Remove(BestTileID);
+		bHasBestTile = false;
+	}
+
+	return true;
+}
+
+void FFoliageTaskQueue::RecordLatency(double EnqueueTime)
+{
+	const double Latency = FPlatformTime::Seconds() - EnqueueTime;
+
+	AverageLatency = NumExecuted == 0
+		                 ? Latency
+		                 : FMath::Lerp(AverageLatency, Latency, LATENCY_SMOOTHING);
+	MaxLatency = FMath::Max(MaxLatency, Latency);
+	++NumExecuted;
+}
+
+#undef LATENCY_SMOOTHING
@@ -0,0 +1,178 @@
+// Copyright Aiden. S. All Rights Reserved
+
+
+#include "Async/FoliageTilePipeline.h"
+
+#include "Async/FoliageWorkerPool.h"
+
+// Weight of the newest sample in the smoothed stage time
+#define STAGE_TIME_SMOOTHING 0.05
+
+FFoliagePipelineTicket::FFoliagePipelineTicket(const TSharedRef<FFoliageTilePipeline, ESPMode::ThreadSafe>& InPipeline,
+                                               EFoliagePipelineStage InStage)
+	: Pipeline(InPipeline),
+	  Stage(InStage),
+	  StartTime(FPlatformTime::Seconds())
+{
+}
+
+FFoliagePipelineTicket::~FFoliagePipelineTicket()
+{
+	Pipeline->Release(Stage, StartTime);
+}
+
+FFoliageTilePipeline::FFoliageTilePipeline()
+{
+	GetStage(EFoliagePipelineStage::Capture).Limit = 1;
+	GetStage(EFoliagePipelineStage::Compute).Limit = 4;
+	GetStage(EFoliagePipelineStage::Build).Limit = 4;
+	GetStage(EFoliagePipelineStage::Apply).Limit = 2;
+}
+
+void FFoliageTilePipeline::SetStageLimit(EFoliagePipelineStage Stage, int32 InLimit)
+{
+	{
+		FStage& StageState = GetStage(Stage);
+		FScopeLock ScopeLock(&StageState.Lock);
+		StageState.Limit = FMath::Max(InLimit, 0);
+	}
+
+	Pump(Stage);
+}
+
+bool FFoliageTilePipeline::HasCapacity(EFoliagePipelineStage Stage) const
+{
+	const FStage& StageState = GetStage(Stage);
+	FScopeLock ScopeLock(&StageState.Lock);
+	return StageState.Limit == 0 || StageState.InFlight < StageState.Limit;
+}
+
+FFoliagePipelineTicketPtr FFoliageTilePipeline::TryAcquire(EFoliagePipelineStage Stage)
+{
+	{
+		FStage& StageState = GetStage(Stage);
+		FScopeLock ScopeLock(&StageState.Lock);
+
+		if (StageState.Limit > 0 && StageState.InFlight >= StageState.Limit)
+		{
+			return nullptr;
+		}
+		++StageState.InFlight;
+	}
+
+	return MakeShared<FFoliagePipelineTicket, ESPMode::ThreadSafe>(AsShared(), Stage);
+}
+
+FFoliagePipelineTicketPtr FFoliageTilePipeline::Acquire(EFoliagePipelineStage Stage)
+{
+	{
+		FStage& StageState = GetStage(Stage);
+		FScopeLock ScopeLock(&StageState.Lock);
+		++StageState.InFlight;
+	}
+
+	return MakeShared<FFoliagePipelineTicket, ESPMode::ThreadSafe>(AsShared(), Stage);
+}
+
+void FFoliageTilePipeline::Submit(EFoliagePipelineStage Stage, TFunction<void(FFoliagePipelineTicketPtr)>&& Job)
+{
+	check(Stage == EFoliagePipelineStage::Compute || Stage == EFoliagePipelineStage::Build ||
+		Stage == EFoliagePipelineStage::Apply);
+
+	{
+		FStage& StageState = GetStage(Stage);
+		FScopeLock ScopeLock(&StageState.Lock);
+		StageState.Pending.Add(MoveTemp(Job));
+	}
+
+	Pump(Stage);
+}
+
+FFoliagePipelineStageStats FFoliageTilePipeline::GetStats(EFoliagePipelineStage Stage) const
+{
+	const FStage& StageState = GetStage(Stage);
+	FScopeLock ScopeLock(&StageState.Lock);
+
+	FFoliagePipelineStageStats Stats;
+	Stats.InFlight = StageState.InFlight;
+	Stats.Pending = StageState.Pending.Num();
+	Stats.Limit = StageState.Limit;
+	Stats.NumCompleted = StageState.NumCompleted;
+	Stats.AverageTime = StageState.AverageTime;
+	Stats.MaxTime = StageState.MaxTime;
+	return Stats;
+}
+
+const TCHAR* FFoliageTilePipeline::GetStageName(EFoliagePipelineStage Stage)
+{
+	switch (Stage)
+	{
+	case EFoliagePipelineStage::Capture: return TEXT("Capture");
+	case EFoliagePipelineStage::Readback: return TEXT("Readback");
+	case EFoliagePipelineStage::Compute: return TEXT("Compute");
+	case EFoliagePipelineStage::Build: return TEXT("Build");
+	case EFoliagePipelineStage::Apply: return TEXT("Apply");
+	default: return TEXT("Unknown");
+	}
+}
+
+void FFoliageTilePipeline::Release(EFoliagePipelineStage Stage, double StartTime)
+{
+	const double Time = FPlatformTime::Seconds() - StartTime;
+
+	{
+		FStage& StageState = GetStage(Stage);
+		FScopeLock ScopeLock(&StageState.Lock);
+
+		--StageState.InFlight;
+		StageState.AverageTime = StageState.NumCompleted == 0
+			                         ? Time
+			                         : FMath::Lerp(StageState.AverageTime, Time, STAGE_TIME_SMOOTHING);
+		StageState.MaxTime = FMath::Max(StageState.MaxTime, Time);
+		++StageState.NumCompleted;
+	}
+
+	Pump(Stage);
+}
+
+void FFoliageTilePipeline::Pump(EFoliagePipelineStage Stage)
+{
+	FStage& StageState = GetStage(Stage);
+
+	for (;;)
+	{
+		TFunction<void(FFoliagePipelineTicketPtr)> Job;
+		{
+			FScopeLock ScopeLock(&StageState.Lock);
+
+			if (StageState.Pending.IsEmpty() || (StageState.Limit > 0 && StageState.InFlight >= StageState.Limit))
+			{
+				return;
+			}
+
+			Job = StageState.Pending.PopFrontValue();
+			++StageState.InFlight;
+		}
+
+		// Dispatched outside of the lock, an inline job may well submit to or release another stage
+		Dispatch(Stage, MoveTemp(Job), MakeShared<FFoliagePipelineTicket, ESPMode::ThreadSafe>(AsShared(), Stage));
+	}
+}
+
+void FFoliageTilePipeline::Dispatch(EFoliagePipelineStage Stage, TFunction<void(FFoliagePipelineTicketPtr)>&& Job,
+                                    FFoliagePipelineTicketPtr&& Ticket)
+{
+	if (Stage == EFoliagePipelineStage::Apply)
+	{
+		Job(MoveTemp(Ticket));
+		return;
+	}
+
+	FFoliageWorkerPool::Get().Submit([Job = MoveTemp(Job), Ticket = MoveTemp(Ticket)]() mutable
+	{
+		// Unless the job holds on to it, the slot is released as soon as the job returns
+		Job(MoveTemp(Ticket));
+	});
+}
+
+#undef STAGE_TIME_SMOOTHING
@@ -0,0 +1,315 @@
+// Copyright Aiden. S. All Rights Reserved
+
+
+#include "Async/FoliageWorkerPool.h"
+
+#include "GenericFoliage.h"
+#include "GenericFoliageSettings.h"
+#include "HAL/Event.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+
+// Longest an idle worker sleeps before looking for work to steal again (ms)
+#define WORKER_IDLE_WAIT_MS 100
+
+namespace
+{
+	TUniquePtr<FFoliageWorkerPool> SharedPool;
+	FCriticalSection SharedPoolLock;
+
+	/** Set by Shutdown, the shared pool is never started again */
+	bool bSharedPoolShutDown = false;
+
+	/** Set on worker threads so submits from a job stay on the worker's own queue */
+	thread_local const FFoliageWorkerPool* CurrentPool = nullptr;
+	thread_local int32 CurrentWorkerIndex = INDEX_NONE;
+}
+
+FFoliageWorkerPoolConfig FFoliageWorkerPoolConfig::FromSettings()
+{
+	const UGenericFoliageSettings* Settings = GetDefault<UGenericFoliageSettings>();
+	const int32 NumCores = FPlatformMisc::NumberOfCores();
+
+	FFoliageWorkerPoolConfig Config;
+	Config.NumWorkers = Settings->NumWorkers > 0
+		                    ? Settings->NumWorkers
+		                    : FMath::Max(NumCores - Settings->NumReservedCores, 1);
+	Config.StackSize = static_cast<uint32>(Settings->WorkerStackSizeKB) * 1024;
+	Config.bPinToCores = Settings->bPinWorkersToCores;
+	Config.FirstCore = FMath::Clamp(Settings->NumReservedCores, 0, NumCores - 1);
+
+	switch (Settings->WorkerPriority)
+	{
+	case EFoliageWorkerPriority::Lowest:
+		Config.Priority = TPri_Lowest;
+		break;
+	case EFoliageWorkerPriority::Normal:
+		Config.Priority = TPri_Normal;
+		break;
+	default:
+		Config.Priority = TPri_BelowNormal;
+		break;
+	}
+
+	return Config;
+}
+
+FFoliageWorkerPool& FFoliageWorkerPool::Get()
+{
+	FScopeLock ScopeLock(&SharedPoolLock);
+
+	if (!SharedPool.IsValid())
+	{
+		if (bSharedPoolShutDown)
+		{
+			// Work arriving after the module shut down runs inline rather than starting threads nobody stops
+			FFoliageWorkerPoolConfig InlineConfig;
+			InlineConfig.NumWorkers = 0;
+			SharedPool = MakeUnique<FFoliageWorkerPool>(InlineConfig);
+			return *SharedPool;
+		}
+
+		// Reads the project settings, the actors touch the pool during setup so this happens on the game thread
+		ensure(IsInGameThread());
+		SharedPool = MakeUnique<FFoliageWorkerPool>(FFoliageWorkerPoolConfig::FromSettings());
+	}
+
+	return *SharedPool;
+}
+
+void FFoliageWorkerPool::Shutdown()
+{
+	FFoliageWorkerPool* Pool;
+	{
+		FScopeLock ScopeLock(&SharedPoolLock);
+		bSharedPoolShutDown = true;
+		Pool = SharedPool.Get();
+	}
+
+	// Stopped outside of the lock and kept alive, the jobs being drained still call Get() and submit inline
+	if (Pool)
+	{
+		Pool->Stop();
+	}
+}
+
+FFoliageWorkerPool::FFoliageWorkerPool(const FFoliageWorkerPoolConfig& InConfig)
+	: Config(InConfig)
+{
+	Config.NumWorkers = FMath::Max(Config.NumWorkers, 0);
+
+	if (Config.NumWorkers == 0)
+	{
+		bStopping.store(true);
+		return;
+	}
+
+	const int32 NumCores = FMath::Max(FPlatformMisc::NumberOfCores(), 1);
+
+	for (int32 i = 0; i < Config.NumWorkers; ++i)
+	{
+		Queues.Add(MakeUnique<FWorkerQueue>());
+		Workers.Add(MakeUnique<FWorker>(*this, i));
+	}
+
+	for (int32 i = 0; i < Config.NumWorkers; ++i)
+	{
+		// The mask only holds the first 64 cores, workers past them aren't pinned
+		const int32 Core = (Config.FirstCore + i) % NumCores;
+		const uint64 AffinityMask = Config.bPinToCores && Core < 64
+			                            ? (uint64(1) << Core)
+			                            : FPlatformAffinity::GetNoAffinityMask();
+
+		Threads.Add(FRunnableThread::Create(
+			Workers[i].Get(), *FString::Printf(TEXT("FoliageWorker%i"), i), Config.StackSize, Config.Priority,
+			AffinityMask
+		));
+	}
+
+	UE_LOG(LogGenericFoliage, Log, TEXT("Started foliage worker pool with %i workers"), Config.NumWorkers);
+}
+
+FFoliageWorkerPool::~FFoliageWorkerPool()
+{
+	Stop();
+}
+
+void FFoliageWorkerPool::Stop()
+{
+	if (bStopping.exchange(true))
+	{
+		return;
+	}
+
+	for (const TUniquePtr<FWorker>& Worker : Workers)
+	{
+		Worker->WakeEvent->Trigger();
+	}
+
+	// Workers drain every queue before they exit
+	for (FRunnableThread* Thread : Threads)
+	{
+		if (Thread)
+		{
+			Thread->WaitForCompletion();
+			delete Thread;
+		}
+	}
+
+	Threads.Empty();
+
+	// A submit racing the stop may have queued behind the workers' last look
+	TFunction<void()> Job;
+	for (int32 QueueIndex = 0; QueueIndex < Queues.Num(); ++QueueIndex)
+	{
+		while (PopOwn(QueueIndex, Job))
+		{
+			NumPending.fetch_sub(1);
+			Job();
+			Job.Reset();
+		}
+	}
+
+	// The queues and workers outlive the stop, a submit that raced it may still be touching them
+}
+
+void FFoliageWorkerPool::Submit(TFunction<void()>&& Job)
+{
+	if (bStopping.load())
+	{
+		// Nothing will pick it up anymore
+		Job();
+		return;
+	}
+
+	const int32 QueueIndex = CurrentPool == this
+		                         ? CurrentWorkerIndex
+		                         : static_cast<int32>(NextQueue.fetch_add(1) % static_cast<uint32>(Queues.Num()));
+
+	{
+		FScopeLock ScopeLock(&Queues[QueueIndex]->Lock);
+		Queues[QueueIndex]->Jobs.Add(MoveTemp(Job));
+	}
+
+	NumPending.fetch_add(1);
+	Wake(QueueIndex);
+}
+
+int32 FFoliageWorkerPool::GetNumWorkers() const
+{
+	return Workers.Num();
+}
+
+int32 FFoliageWorkerPool::GetNumPending() const
+{
+	return FMath::Max(NumPending.load(std::memory_order_relaxed), 0);
+}
+
+bool FFoliageWorkerPool::IsWorkerThread() const
+{
+	return CurrentPool == this;
+}
+
+bool FFoliageWorkerPool::PopOwn(int32 WorkerIndex, TFunction<void()>& OutJob)
+{
+	FWorkerQueue& Queue = *Queues[WorkerIndex];
+	FScopeLock ScopeLock(&Queue.Lock);
+
+	if (Queue.Jobs.IsEmpty())
+	{
+		return false;
+	}
+
+	// Newest first, it most likely continues what this worker just did
+	OutJob = Queue.Jobs.PopValue();
+	return true;
+}
+
+bool FFoliageWorkerPool::Steal(int32 WorkerIndex, TFunction<void()>& OutJob)
+{
+	for (int32 Offset = 1; Offset < Queues.Num(); ++Offset)
+	{
+		FWorkerQueue& Queue = *Queues[(WorkerIndex + Offset) % Queues.Num()];
+		FScopeLock ScopeLock(&Queue.Lock);
+
+		if (!Queue.Jobs.IsEmpty())
+		{
+			// Oldest first, the owner is working from the other end
+			OutJob = Queue.Jobs.PopFrontValue();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void FFoliageWorkerPool::Wake(int32 QueueIndex)
+{
+	if (Workers[QueueIndex]->bSleeping.load())
+	{
+		Workers[QueueIndex]->WakeEvent->Trigger();
+		return;
+	}
+
+	for (const TUniquePtr<FWorker>& Worker : Workers)
+	{
+		if (Worker->bSleeping.load())
+		{
+			Worker->WakeEvent->Trigger();
+			return;
+		}
+	}
+}
+
+FFoliageWorkerPool::FWorker::FWorker(FFoliageWorkerPool& InPool, int32 InIndex)
+	: Pool(InPool),
+	  Index(InIndex)
+{
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+}
+
+FFoliageWorkerPool::FWorker::~FWorker()
+{
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+uint32 FFoliageWorkerPool::FWorker::Run()
+{
+	CurrentPool = &Pool;
+	CurrentWorkerIndex = Index;
+
+	TFunction<void()> Job;
+
+	for (;;)
+	{
+		if (Pool.PopOwn(Index, Job) || Pool.Steal(Index, Job))
+		{
+			Pool.NumPending.fetch_sub(1);
+			Job();
+			Job.Reset();
+			continue;
+		}
+
+		if (Pool.bStopping.load())
+		{
+			break;
+		}
+
+		bSleeping.store(true);
+
+		// A submit between the failed steal and announcing we're asleep would otherwise go unnoticed
+		if (Pool.NumPending.load() <= 0)
+		{
+			WakeEvent->Wait(WORKER_IDLE_WAIT_MS);
+		}
+
+		bSleeping.store(false);
+	}
+
+	CurrentPool = nullptr;
+	CurrentWorkerIndex = INDEX_NONE;
+	return 0;
+}
+
+#undef WORKER_IDLE_WAIT_MS
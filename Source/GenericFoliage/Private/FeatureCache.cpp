@@ -0,0 +1,572 @@
+// Copyright Aiden. S. All Rights Reserved
+
+
+#include "FeatureCache.h"
+
+#include "GenericFoliage.h"
+#include "Algo/Unique.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Hash/CityHash.h"
+#include "Misc/Paths.h"
+
+#define FEATURE_CACHE_MAGIC 0x43464647 // "GFFC"
+#define FEATURE_CACHE_VERSION 2
+
+// CityHash64 takes 32 bit lengths, larger sources are hashed in chunks chained through the seed
+#define FEATURE_CACHE_HASH_CHUNK (1024 * 1024 * 1024)
+
+// The index aims for about one feature per cell
+#define FEATURE_CACHE_MAX_INDEX_RESOLUTION 1024
+
+static_assert(sizeof(FVector2D) == 2 * sizeof(double), "Cached points are mapped as FVector2D");
+static_assert(sizeof(FFeatureCacheFeature) % 8 == 0 && sizeof(FFeatureCacheRing) % 8 == 0 &&
+              sizeof(FFeatureCacheProperty) % 8 == 0, "Cache records must keep 8 byte alignment");
+
+namespace
+{
+	EFeatureCachePropertyType GetPropertyType(const FString& Value, double& OutNumber)
+	{
+		if (Value == TEXT("true") || Value == TEXT("false"))
+		{
+			OutNumber = Value == TEXT("true") ? 1.0 : 0.0;
+			return EFeatureCachePropertyType::Bool;
+		}
+
+		if (!Value.IsEmpty() && FCString::IsNumeric(*Value))
+		{
+			OutNumber = FCString::Atod(*Value);
+			return EFeatureCachePropertyType::Number;
+		}
+
+		OutNumber = 0.0;
+		return EFeatureCachePropertyType::String;
+	}
+
+	FORCEINLINE int32 GetIndexCell(double Value, double Min, double CellSize, int32 NumCells)
+	{
+		return FMath::Clamp(FMath::FloorToInt32((Value - Min) / CellSize), 0, NumCells - 1);
+	}
+}
+
+void FFeatureCacheWriter::Add(const FGeoJSONFeature& Feature)
+{
+	FFeatureCacheFeature& Record = Features.AddDefaulted_GetRef();
+	Record.Hash = Feature.GetContentHash();
+	Record.Id = Feature.Id;
+	Record.GeometryType = static_cast<uint8>(Feature.GeometryType);
+	Record.FirstRing = Rings.Num();
+	Record.NumRings = Feature.GetNumRings();
+	Record.FirstProperty = Properties.Num();
+	Record.NumProperties = Feature.Properties.Num();
+
+	const FString* Type = Feature.Properties.Find(TEXT("type"));
+	Record.Type = Type ? FCString::Atoi(**Type) : 0;
+
+	FBox2D Bounds(ForceInit);
+	int32 NextPolygon = 0;
+
+	for (int32 RingIndex = 0; RingIndex < Feature.GetNumRings(); ++RingIndex)
+	{
+		const TArrayView<const FVector2D> Ring = Feature.GetRing(RingIndex);
+
+		FFeatureCacheRing& RingRecord = Rings.AddDefaulted_GetRef();
+		RingRecord.FirstPoint = Points.Num();
+		RingRecord.NumPoints = Ring.Num();
+
+		if (NextPolygon < Feature.GetNumPolygons() && Feature.PolygonOffsets[NextPolygon] == RingIndex)
+		{
+			RingRecord.Flags |= EFeatureCacheRingFlags::Outer;
+			++NextPolygon;
+		}
+
+		Points.Append(Ring.GetData(), Ring.Num());
+
+		for (const FVector2D& Point : Ring)
+		{
+			Bounds += Point;
+		}
+	}
+
+	if (Bounds.bIsValid)
+	{
+		Record.MinX = Bounds.Min.X;
+		Record.MinY = Bounds.Min.Y;
+		Record.MaxX = Bounds.Max.X;
+		Record.MaxY = Bounds.Max.Y;
+	}
+
+	for (const TPair<FString, FString>& Property : Feature.Properties)
+	{
+		FFeatureCacheProperty& PropertyRecord = Properties.AddDefaulted_GetRef();
+		PropertyRecord.KeyOffset = AddString(Property.Key, PropertyRecord.KeyLength);
+		PropertyRecord.ValueOffset = AddString(Property.Value, PropertyRecord.ValueLength);
+		PropertyRecord.ValueType = GetPropertyType(Property.Value, PropertyRecord.Number);
+	}
+}
+
+uint32 FFeatureCacheWriter::AddString(const FString& String, uint32& OutLength)
+{
+	const FTCHARToUTF8 Converted(*String, String.Len());
+	const uint32 Offset = Strings.Num();
+
+	Strings.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+	OutLength = Converted.Length();
+	return Offset;
+}
+
+bool FFeatureCacheWriter::Save(const FString& Path, uint64 SourceHash) const
+{
+	FFeatureCacheHeader Header;
+	Header.Magic = FEATURE_CACHE_MAGIC;
+	Header.Version = FEATURE_CACHE_VERSION;
+	Header.SourceHash = SourceHash;
+
+	// Grid over every feature's bounds, each feature is listed in every cell its bounds overlap
+	FBox2D AllBounds(ForceInit);
+	for (const FFeatureCacheFeature& Feature : Features)
+	{
+		if (Feature.NumRings > 0)
+		{
+			AllBounds += FVector2D(Feature.MinX, Feature.MinY);
+			AllBounds += FVector2D(Feature.MaxX, Feature.MaxY);
+		}
+	}
+
+	TArray<uint32> IndexCells;
+	TArray<uint32> IndexEntries;
+
+	if (AllBounds.bIsValid)
+	{
+		const int32 Resolution = FMath::Clamp(FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(Features.Num()))), 1,
+		                                      FEATURE_CACHE_MAX_INDEX_RESOLUTION);
+		const FVector2D Size = AllBounds.GetSize();
+
+		Header.IndexMinX = AllBounds.Min.X;
+		Header.IndexMinY = AllBounds.Min.Y;
+		Header.IndexCellSizeX = Size.X > 0.0 ? Size.X / Resolution : 1.0;
+		Header.IndexCellSizeY = Size.Y > 0.0 ? Size.Y / Resolution : 1.0;
+		Header.IndexNumX = Resolution;
+		Header.IndexNumY = Resolution;
+
+		const auto ForEachCell = [&Header](const FFeatureCacheFeature& Feature, auto&& Func)
+		{
+			const int32 MinX = GetIndexCell(Feature.MinX, Header.IndexMinX, Header.IndexCellSizeX, Header.IndexNumX);
+			const int32 MinY = GetIndexCell(Feature.MinY, Header.IndexMinY, Header.IndexCellSizeY, Header.IndexNumY);
+			const int32 MaxX = GetIndexCell(Feature.MaxX, Header.IndexMinX, Header.IndexCellSizeX, Header.IndexNumX);
+			const int32 MaxY = GetIndexCell(Feature.MaxY, Header.IndexMinY, Header.IndexCellSizeY, Header.IndexNumY);
+
+			for (int32 y = MinY; y <= MaxY; ++y)
+			{
+				for (int32 x = MinX; x <= MaxX; ++x)
+				{
+					Func(y * Header.IndexNumX + x);
+				}
+			}
+		};
+
+		const int32 NumCells = Header.IndexNumX * Header.IndexNumY;
+		IndexCells.SetNumZeroed(NumCells + 1);
+
+		for (const FFeatureCacheFeature& Feature : Features)
+		{
+			if (Feature.NumRings > 0)
+			{
+				ForEachCell(Feature, [&IndexCells](int32 Cell) { ++IndexCells[Cell + 1]; });
+			}
+		}
+
+		for (int32 i = 0; i < NumCells; ++i)
+		{
+			IndexCells[i + 1] += IndexCells[i];
+		}
+
+		IndexEntries.SetNumUninitialized(IndexCells[NumCells]);
+		TArray<uint32> Cursor(IndexCells.GetData(), NumCells);
+
+		for (int32 FeatureIndex = 0; FeatureIndex < Features.Num(); ++FeatureIndex)
+		{
+			if (Features[FeatureIndex].NumRings > 0)
+			{
+				ForEachCell(Features[FeatureIndex], [&](int32 Cell) { IndexEntries[Cursor[Cell]++] = FeatureIndex; });
+			}
+		}
+	}
+
+	// Unique per writer, two loads of the same source may be saving at once
+	const FString TempPath = FPaths::CreateTempFilename(*FPaths::GetPath(Path), *FPaths::GetBaseFilename(Path),
+	                                                    TEXT(".tmp"));
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+
+	TUniquePtr<FArchive> Writer(IFileManager::Get().CreateFileWriter(*TempPath));
+	if (!Writer.IsValid())
+	{
+		UE_LOG(LogGenericFoliage, Warning, TEXT("Failed to write feature cache '%s'"), *TempPath);
+		return false;
+	}
+
+	// Header is written again at the end once the section offsets are known
+	Writer->Serialize(&Header, sizeof(Header));
+
+	const auto WriteSection = [&](EFeatureCacheSection Section, const void* Data, int64 Count, int64 Stride)
+	{
+		uint8 Padding[8] = {};
+		const int64 Misalignment = Writer->Tell() % 8;
+		if (Misalignment != 0)
+		{
+			Writer->Serialize(Padding, 8 - Misalignment);
+		}
+
+		Header.Sections[static_cast<int32>(Section)] = {static_cast<uint64>(Writer->Tell()), static_cast<uint64>(Count)};
+		Writer->Serialize(const_cast<void*>(Data), Count * Stride);
+	};
+
+	WriteSection(EFeatureCacheSection::Features, Features.GetData(), Features.Num(), sizeof(FFeatureCacheFeature));
+	WriteSection(EFeatureCacheSection::Rings, Rings.GetData(), Rings.Num(), sizeof(FFeatureCacheRing));
+	WriteSection(EFeatureCacheSection::Points, Points.GetData(), Points.Num(), sizeof(FVector2D));
+	WriteSection(EFeatureCacheSection::Properties, Properties.GetData(), Properties.Num(), sizeof(FFeatureCacheProperty));
+	WriteSection(EFeatureCacheSection::Strings, Strings.GetData(), Strings.Num(), sizeof(uint8));
+	WriteSection(EFeatureCacheSection::IndexCells, IndexCells.GetData(), IndexCells.Num(), sizeof(uint32));
+	WriteSection(EFeatureCacheSection::IndexEntries, IndexEntries.GetData(), IndexEntries.Num(), sizeof(uint32));
+
+	Header.FileSize = Writer->Tell();
+	Writer->Seek(0);
+	Writer->Serialize(&Header, sizeof(Header));
+
+	const bool bWritten = Writer->Close() && !Writer->IsError();
+	Writer.Reset();
+
+	if (!bWritten || !IFileManager::Get().Move(*Path, *TempPath, true, true))
+	{
+		UE_LOG(LogGenericFoliage, Warning, TEXT("Failed to write feature cache '%s'"), *Path);
+		IFileManager::Get().Delete(*TempPath, false, true, true);
+		return false;
+	}
+
+	return true;
+}
+
+FFeatureCache::FFeatureCache()
+{
+}
+
+FFeatureCache::~FFeatureCache()
+{
+	Close();
+}
+
+uint64 FFeatureCache::HashSource(TArrayView<const uint8> Source)
+{
+	uint64 Hash = 0;
+	int64 Offset = 0;
+
+	do
+	{
+		const uint32 Length = static_cast<uint32>(FMath::Min<int64>(Source.Num() - Offset, FEATURE_CACHE_HASH_CHUNK));
+		Hash = CityHash64WithSeed(reinterpret_cast<const char*>(Source.GetData() + Offset), Length, Hash);
+		Offset += Length;
+	}
+	while (Offset < Source.Num());
+
+	return Hash;
+}
+
+FString FFeatureCache::GetCachePath(uint64 SourceHash)
+{
+	return FPaths::ProjectSavedDir() / TEXT("GenericFoliage") / TEXT("FeatureCache") /
+		FString::Printf(TEXT("%016llx.gfc"), SourceHash);
+}
+
+bool FFeatureCache::Open(const FString& Path, uint64 SourceHash)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	if (!PlatformFile.FileExists(*Path))
+	{
+		return false;
+	}
+
+	MappedFile.Reset(PlatformFile.OpenMapped(*Path));
+	if (!MappedFile.IsValid() || MappedFile->GetFileSize() < static_cast<int64>(sizeof(FFeatureCacheHeader)))
+	{
+		Close();
+		return false;
+	}
+
+	MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	if (!MappedRegion.IsValid())
+	{
+		Close();
+		return false;
+	}
+
+	Header = reinterpret_cast<const FFeatureCacheHeader*>(MappedRegion->GetMappedPtr());
+
+	if (Header->Magic != FEATURE_CACHE_MAGIC || Header->Version != FEATURE_CACHE_VERSION ||
+		Header->SourceHash != SourceHash || Header->FileSize != static_cast<uint64>(MappedRegion->GetMappedSize()) ||
+		!Validate(MappedRegion->GetMappedSize()))
+	{
+		UE_LOG(LogGenericFoliage, Log, TEXT("Feature cache '%s' is stale or damaged, ignoring it"), *Path);
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void FFeatureCache::Close()
+{
+	Header = nullptr;
+	Features = {};
+	Rings = {};
+	Points = {};
+	Properties = {};
+	Strings = {};
+	IndexCells = {};
+	IndexEntries = {};
+
+	MappedRegion.Reset();
+	MappedFile.Reset();
+}
+
+template <typename RecordType>
+TArrayView<const RecordType> FFeatureCache::GetSection(EFeatureCacheSection Section) const
+{
+	const FFeatureCacheSection& Entry = Header->Sections[static_cast<int32>(Section)];
+	const uint8* Base = MappedRegion->GetMappedPtr();
+	return TArrayView<const RecordType>(reinterpret_cast<const RecordType*>(Base + Entry.Offset),
+	                                    static_cast<int32>(Entry.Count));
+}
+
+bool FFeatureCache::Validate(int64 MappedSize)
+{
+	// Everything is checked once here so the accessors can trust the file, this also sets up the section views
+	static constexpr uint64 Strides[] = {
+		sizeof(FFeatureCacheFeature), sizeof(FFeatureCacheRing), sizeof(FVector2D), sizeof(FFeatureCacheProperty),
+		sizeof(uint8), sizeof(uint32), sizeof(uint32)
+	};
+
+	for (int32 i = 0; i < static_cast<int32>(EFeatureCacheSection::Num); ++i)
+	{
+		const FFeatureCacheSection& Section = Header->Sections[i];
+		if (Section.Offset % 8 != 0 || Section.Count > MAX_int32 ||
+			Section.Offset + Section.Count * Strides[i] > static_cast<uint64>(MappedSize))
+		{
+			return false;
+		}
+	}
+
+	Features = GetSection<FFeatureCacheFeature>(EFeatureCacheSection::Features);
+	Rings = GetSection<FFeatureCacheRing>(EFeatureCacheSection::Rings);
+	Points = GetSection<FVector2D>(EFeatureCacheSection::Points);
+	Properties = GetSection<FFeatureCacheProperty>(EFeatureCacheSection::Properties);
+	Strings = GetSection<uint8>(EFeatureCacheSection::Strings);
+	IndexCells = GetSection<uint32>(EFeatureCacheSection::IndexCells);
+	IndexEntries = GetSection<uint32>(EFeatureCacheSection::IndexEntries);
+
+	for (const FFeatureCacheFeature& Feature : Features)
+	{
+		if (static_cast<uint64>(Feature.FirstRing) + Feature.NumRings > static_cast<uint64>(Rings.Num()) ||
+			static_cast<uint64>(Feature.FirstProperty) + Feature.NumProperties > static_cast<uint64>(Properties.Num()))
+		{
+			return false;
+		}
+	}
+
+	for (const FFeatureCacheRing& Ring : Rings)
+	{
+		if (static_cast<uint64>(Ring.FirstPoint) + Ring.NumPoints > static_cast<uint64>(Points.Num()))
+		{
+			return false;
+		}
+	}
+
+	for (const FFeatureCacheProperty& Property : Properties)
+	{
+		if (static_cast<uint64>(Property.KeyOffset) + Property.KeyLength > static_cast<uint64>(Strings.Num()) ||
+			static_cast<uint64>(Property.ValueOffset) + Property.ValueLength > static_cast<uint64>(Strings.Num()))
+		{
+			return false;
+		}
+	}
+
+	const int64 NumCells = static_cast<int64>(Header->IndexNumX) * Header->IndexNumY;
+	if (Header->IndexNumX < 0 || Header->IndexNumY < 0 ||
+		(NumCells > 0 && IndexCells.Num() != NumCells + 1) || (NumCells == 0 && IndexCells.Num() != 0))
+	{
+		return false;
+	}
+
+	for (int32 i = 0; i < IndexCells.Num(); ++i)
+	{
+		if (IndexCells[i] > static_cast<uint32>(IndexEntries.Num()) || (i > 0 && IndexCells[i] < IndexCells[i - 1]))
+		{
+			return false;
+		}
+	}
+
+	for (const uint32 Entry : IndexEntries)
+	{
+		if (Entry >= static_cast<uint32>(Features.Num()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int32 FFeatureCache::Num() const
+{
+	return Features.Num();
+}
+
+int32 FFeatureCache::GetId(int32 FeatureIndex) const
+{
+	return Features[FeatureIndex].Id;
+}
+
+uint64 FFeatureCache::GetHash(int32 FeatureIndex) const
+{
+	return Features[FeatureIndex].Hash;
+}
+
+int32 FFeatureCache::GetType(int32 FeatureIndex) const
+{
+	return Features[FeatureIndex].Type;
+}
+
+EGeoJSONGeometryType FFeatureCache::GetGeometryType(int32 FeatureIndex) const
+{
+	const uint8 GeometryType = Features[FeatureIndex].GeometryType;
+	return GeometryType <= static_cast<uint8>(EGeoJSONGeometryType::Unknown)
+		       ? static_cast<EGeoJSONGeometryType>(GeometryType)
+		       : EGeoJSONGeometryType::Unknown;
+}
+
+FBox2D FFeatureCache::GetBounds(int32 FeatureIndex) const
+{
+	const FFeatureCacheFeature& Feature = Features[FeatureIndex];
+	if (Feature.NumRings == 0)
+	{
+		return FBox2D(ForceInit);
+	}
+
+	return FBox2D(FVector2D(Feature.MinX, Feature.MinY), FVector2D(Feature.MaxX, Feature.MaxY));
+}
+
+int32 FFeatureCache::GetNumRings(int32 FeatureIndex) const
+{
+	return Features[FeatureIndex].NumRings;
+}
+
+TArrayView<const FVector2D> FFeatureCache::GetRing(int32 FeatureIndex, int32 RingIndex) const
+{
+	const FFeatureCacheRing& Ring = Rings[Features[FeatureIndex].FirstRing + RingIndex];
+	return TArrayView<const FVector2D>(Points.GetData() + Ring.FirstPoint, Ring.NumPoints);
+}
+
+bool FFeatureCache::IsOuterRing(int32 FeatureIndex, int32 RingIndex) const
+{
+	return EnumHasAnyFlags(Rings[Features[FeatureIndex].FirstRing + RingIndex].Flags, EFeatureCacheRingFlags::Outer);
+}
+
+int32 FFeatureCache::GetNumProperties(int32 FeatureIndex) const
+{
+	return Features[FeatureIndex].NumProperties;
+}
+
+const FFeatureCacheProperty& FFeatureCache::GetProperty(int32 FeatureIndex, int32 PropertyIndex) const
+{
+	return Properties[Features[FeatureIndex].FirstProperty + PropertyIndex];
+}
+
+FString FFeatureCache::GetString(uint32 Offset, uint32 Length) const
+{
+	const FUTF8ToTCHAR Converted(reinterpret_cast<const ANSICHAR*>(Strings.GetData() + Offset), Length);
+	return FString(Converted.Length(), Converted.Get());
+}
+
+void FFeatureCache::GetFeature(int32 FeatureIndex, FGeoJSONFeature& OutFeature) const
+{
+	OutFeature.Reset();
+	OutFeature.Id = GetId(FeatureIndex);
+	OutFeature.GeometryType = GetGeometryType(FeatureIndex);
+
+	for (int32 RingIndex = 0; RingIndex < GetNumRings(FeatureIndex); ++RingIndex)
+	{
+		if (IsOuterRing(FeatureIndex, RingIndex))
+		{
+			OutFeature.PolygonOffsets.Add(OutFeature.RingOffsets.Num());
+		}
+
+		const TArrayView<const FVector2D> Ring = GetRing(FeatureIndex, RingIndex);
+		OutFeature.RingOffsets.Add(OutFeature.Coordinates.Num());
+		OutFeature.Coordinates.Append(Ring.GetData(), Ring.Num());
+	}
+
+	for (int32 PropertyIndex = 0; PropertyIndex < GetNumProperties(FeatureIndex); ++PropertyIndex)
+	{
+		const FFeatureCacheProperty& Property = GetProperty(FeatureIndex, PropertyIndex);
+		OutFeature.Properties.Add(GetString(Property.KeyOffset, Property.KeyLength),
+		                          GetString(Property.ValueOffset, Property.ValueLength));
+	}
+}
+
+bool FFeatureCache::ReadFeatures(TFunctionRef<bool(FGeoJSONFeature& Feature)> OnFeature) const
+{
+	FGeoJSONFeature Feature;
+
+	for (int32 FeatureIndex = 0; FeatureIndex < Num(); ++FeatureIndex)
+	{
+		GetFeature(FeatureIndex, Feature);
+		if (!OnFeature(Feature))
+		{
+			break;
+		}
+	}
+
+	return IsOpen();
+}
+
+void FFeatureCache::QueryBounds(const FBox2D& Box, TArray<int32>& OutFeatureIndices) const
+{
+	OutFeatureIndices.Reset();
+
+	if (!IsOpen() || IndexCells.Num() == 0 || !Box.bIsValid)
+	{
+		return;
+	}
+
+	const int32 MinX = GetIndexCell(Box.Min.X, Header->IndexMinX, Header->IndexCellSizeX, Header->IndexNumX);
+	const int32 MinY = GetIndexCell(Box.Min.Y, Header->IndexMinY, Header->IndexCellSizeY, Header->IndexNumY);
+	const int32 MaxX = GetIndexCell(Box.Max.X, Header->IndexMinX, Header->IndexCellSizeX, Header->IndexNumX);
+	const int32 MaxY = GetIndexCell(Box.Max.Y, Header->IndexMinY, Header->IndexCellSizeY, Header->IndexNumY);
+
+	for (int32 y = MinY; y <= MaxY; ++y)
+	{
+		for (int32 x = MinX; x <= MaxX; ++x)
+		{
+			const int32 Cell = y * Header->IndexNumX + x;
+			for (uint32 i = IndexCells[Cell]; i < IndexCells[Cell + 1]; ++i)
+			{
+				const int32 FeatureIndex = IndexEntries[i];
+				if (GetBounds(FeatureIndex).Intersect(Box))
+				{
+					OutFeatureIndices.Add(FeatureIndex);
+				}
+			}
+		}
+	}
+
+	// A feature spanning several cells is listed in each of them
+	OutFeatureIndices.Sort();
+	OutFeatureIndices.SetNum(Algo::Unique(OutFeatureIndices), false);
+}
+
+#undef FEATURE_CACHE_MAGIC
+#undef FEATURE_CACHE_VERSION
+#undef FEATURE_CACHE_HASH_CHUNK
+#undef FEATURE_CACHE_MAX_INDEX_RESOLUTION
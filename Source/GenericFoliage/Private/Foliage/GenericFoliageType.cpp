@@ -30,6 +30,21 @@ FVector UGenericFoliageType::GetRandomLocalOffset() const
 	return RandomLocalOffsetRange.GetRandom(RandomStream);
 }
 
+FVector UGenericFoliageType::GetRandomScale(const FRandomStream& Stream) const
+{
+	return ScaleRange.GetRandom(Stream);
+}
+
+FRotator UGenericFoliageType::GetRandomRotator(const FRandomStream& Stream) const
+{
+	return RotatorRange.GetRandom(Stream);
+}
+
+FVector UGenericFoliageType::GetRandomLocalOffset(const FRandomStream& Stream) const
+{
+	return RandomLocalOffsetRange.GetRandom(Stream);
+}
+
 void UGenericFoliageType::ResetGUID()
 {
 	FGuid RandomGuid(
@@ -2,6 +2,8 @@
 
 #include "GenericFoliage.h"
 
+#include "Async/FoliageWorkerPool.h"
+
 #define LOCTEXT_NAMESPACE "FGenericFoliageModule"
 
 DEFINE_LOG_CATEGORY(LogGenericFoliage)
@@ -15,6 +17,7 @@ void FGenericFoliageModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FFoliageWorkerPool::Shutdown();
 }
 
 #undef LOCTEXT_NAMESPACE
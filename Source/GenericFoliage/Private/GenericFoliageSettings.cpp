@@ -0,0 +1,13 @@
+// Copyright Aiden. S. All Rights Reserved
+
+
+#include "GenericFoliageSettings.h"
+
+UGenericFoliageSettings::UGenericFoliageSettings()
+{
+}
+
+FName UGenericFoliageSettings::GetCategoryName() const
+{
+	return TEXT("Plugins");
+}
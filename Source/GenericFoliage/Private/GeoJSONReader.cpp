@@ -0,0 +1,879 @@
+// Copyright Aiden. S. All Rights Reserved
+
+
+#include "GeoJSONReader.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/PlatformFileManager.h"
+#include "Hash/CityHash.h"
+#include "Misc/FileHelper.h"
+
+namespace
+{
+	/** Powers of ten which are exact in a double */
+	constexpr double ExactPowersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	FORCEINLINE bool IsDigit(uint8 Character)
+	{
+		return Character >= '0' && Character <= '9';
+	}
+
+	FORCEINLINE bool IsWhitespace(uint8 Character)
+	{
+		return Character == ' ' || Character == '\n' || Character == '\r' || Character == '\t';
+	}
+
+	int32 HexValue(uint8 Character)
+	{
+		if (Character >= '0' && Character <= '9') { return Character - '0'; }
+		if (Character >= 'a' && Character <= 'f') { return Character - 'a' + 10; }
+		if (Character >= 'A' && Character <= 'F') { return Character - 'A' + 10; }
+		return -1;
+	}
+
+	void AppendUTF8(TArray<ANSICHAR>& Out, uint32 CodePoint)
+	{
+		if (CodePoint < 0x80)
+		{
+			Out.Add(static_cast<ANSICHAR>(CodePoint));
+		}
+		else if (CodePoint < 0x800)
+		{
+			Out.Add(static_cast<ANSICHAR>(0xC0 | (CodePoint >> 6)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+		}
+		else if (CodePoint < 0x10000)
+		{
+			Out.Add(static_cast<ANSICHAR>(0xE0 | (CodePoint >> 12)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 6) & 0x3F)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+		}
+		else
+		{
+			Out.Add(static_cast<ANSICHAR>(0xF0 | (CodePoint >> 18)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 12) & 0x3F)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | ((CodePoint >> 6) & 0x3F)));
+			Out.Add(static_cast<ANSICHAR>(0x80 | (CodePoint & 0x3F)));
+		}
+	}
+
+	EGeoJSONGeometryType GeometryTypeFromName(const TArray<ANSICHAR>& Name)
+	{
+		static const TPair<const ANSICHAR*, EGeoJSONGeometryType> Names[] = {
+			{"Point", EGeoJSONGeometryType::Point},
+			{"MultiPoint", EGeoJSONGeometryType::MultiPoint},
+			{"LineString", EGeoJSONGeometryType::LineString},
+			{"MultiLineString", EGeoJSONGeometryType::MultiLineString},
+			{"Polygon", EGeoJSONGeometryType::Polygon},
+			{"MultiPolygon", EGeoJSONGeometryType::MultiPolygon},
+			{"GeometryCollection", EGeoJSONGeometryType::GeometryCollection},
+		};
+
+		for (const auto& Pair : Names)
+		{
+			if (FCStringAnsi::Strlen(Pair.Key) == Name.Num() &&
+				FMemory::Memcmp(Pair.Key, Name.GetData(), Name.Num()) == 0)
+			{
+				return Pair.Value;
+			}
+		}
+
+		return EGeoJSONGeometryType::Unknown;
+	}
+}
+
+TArrayView<const FVector2D> FGeoJSONFeature::GetRing(int32 RingIndex) const
+{
+	const int32 First = RingOffsets[RingIndex];
+	const int32 Last = RingIndex + 1 < RingOffsets.Num() ? RingOffsets[RingIndex + 1] : Coordinates.Num();
+	return TArrayView<const FVector2D>(Coordinates.GetData() + First, Last - First);
+}
+
+void FGeoJSONFeature::GetPolygonRings(int32 PolygonIndex, int32& OutFirstRing, int32& OutLastRing) const
+{
+	OutFirstRing = PolygonOffsets[PolygonIndex];
+	OutLastRing = PolygonIndex + 1 < PolygonOffsets.Num() ? PolygonOffsets[PolygonIndex + 1] : RingOffsets.Num();
+}
+
+void FGeoJSONFeature::Reset()
+{
+	GeometryType = EGeoJSONGeometryType::None;
+	Coordinates.Reset();
+	RingOffsets.Reset();
+	PolygonOffsets.Reset();
+	Properties.Reset();
+	Id = 0;
+}
+
+uint64 FGeoJSONFeature::GetContentHash() const
+{
+	const auto HashArray = [](const auto& Array, uint64 Seed)
+	{
+		return CityHash64WithSeed(reinterpret_cast<const char*>(Array.GetData()),
+		                          static_cast<uint32>(Array.Num() * Array.GetTypeSize()), Seed);
+	};
+
+	// Id is left out, it is only the position in the collection
+	uint64 Hash = static_cast<uint64>(GeometryType);
+	Hash = HashArray(Coordinates, Hash);
+	Hash = HashArray(RingOffsets, Hash);
+	Hash = HashArray(PolygonOffsets, Hash);
+
+	for (const TPair<FString, FString>& Property : Properties)
+	{
+		Hash = HashArray(Property.Key.GetCharArray(), Hash);
+		Hash = HashArray(Property.Value.GetCharArray(), Hash);
+	}
+
+	return Hash;
+}
+
+FGeoJSONReader::FGeoJSONReader()
+{
+}
+
+FGeoJSONReader::~FGeoJSONReader()
+{
+	Close();
+}
+
+bool FGeoJSONReader::OpenFile(const FString& FilePath)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*FilePath));
+
+	if (MappedFile.IsValid() && MappedFile->GetFileSize() > 0)
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+
+	if (MappedRegion.IsValid())
+	{
+		OpenBuffer(TArrayView<const uint8>(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize()));
+		return true;
+	}
+
+	// Not every platform can map files, read it in one go instead
+	MappedFile.Reset();
+
+	if (!FFileHelper::LoadFileToArray(OwnedBuffer, *FilePath))
+	{
+		Error = FString::Printf(TEXT("Failed to open '%s'"), *FilePath);
+		return false;
+	}
+
+	OpenBuffer(OwnedBuffer);
+	return true;
+}
+
+void FGeoJSONReader::OpenString(const FString& InGeoJSON)
+{
+	Close();
+
+	const FTCHARToUTF8 Converted(*InGeoJSON, InGeoJSON.Len());
+	OwnedBuffer.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+
+	OpenBuffer(OwnedBuffer);
+}
+
+void FGeoJSONReader::OpenBuffer(TArrayView<const uint8> InBuffer)
+{
+	Begin = InBuffer.GetData();
+	Cur = Begin;
+	End = Begin + InBuffer.Num();
+	Error.Reset();
+
+	// Skip the byte order mark
+	if (End - Cur >= 3 && Cur[0] == 0xEF && Cur[1] == 0xBB && Cur[2] == 0xBF)
+	{
+		Cur += 3;
+	}
+}
+
+void FGeoJSONReader::Close()
+{
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	OwnedBuffer.Empty();
+	Begin = Cur = End = nullptr;
+}
+
+bool FGeoJSONReader::ReadFeatures(TFunctionRef<bool(FGeoJSONFeature& Feature)> OnFeature)
+{
+	if (!Begin)
+	{
+		return Fail(TEXT("Nothing to read"));
+	}
+
+	// Stopping from the callback unwinds like an error but isn't one
+	bool bStopped = false;
+	return ParseFeatureCollection(OnFeature, bStopped) || bStopped;
+}
+
+bool FGeoJSONReader::ParseObject(TFunctionRef<bool()> OnMember)
+{
+	if (!Expect('{'))
+	{
+		return false;
+	}
+
+	if (Peek() == '}')
+	{
+		++Cur;
+		return true;
+	}
+
+	for (;;)
+	{
+		if (Peek() != '"')
+		{
+			return Fail(TEXT("Expected a key"));
+		}
+
+		if (!ParseString() || !Expect(':') || !OnMember())
+		{
+			return false;
+		}
+
+		const uint8 Character = Peek();
+		++Cur;
+
+		if (Character == '}')
+		{
+			return true;
+		}
+
+		if (Character != ',')
+		{
+			--Cur;
+			return Fail(TEXT("Expected ',' or '}'"));
+		}
+	}
+}
+
+bool FGeoJSONReader::ParseFeatureCollection(TFunctionRef<bool(FGeoJSONFeature& Feature)> OnFeature, bool& bOutStopped)
+{
+	FGeoJSONFeature Feature;
+	int32 NextId = 0;
+
+	return ParseObject([&]()
+	{
+		if (ScratchEquals("type"))
+		{
+			if (!ParseString())
+			{
+				return false;
+			}
+
+			if (!ScratchEquals("FeatureCollection"))
+			{
+				return Fail(TEXT("GeoJSON type is not of type 'FeatureCollection'"));
+			}
+
+			return true;
+		}
+
+		if (!ScratchEquals("features"))
+		{
+			return SkipValue();
+		}
+
+		if (!Expect('['))
+		{
+			return false;
+		}
+
+		if (Peek() == ']')
+		{
+			++Cur;
+			return true;
+		}
+
+		for (;;)
+		{
+			Feature.Reset();
+			Feature.Id = NextId++;
+
+			if (!ParseFeature(Feature))
+			{
+				return false;
+			}
+
+			if (!OnFeature(Feature))
+			{
+				bOutStopped = true;
+				return false;
+			}
+
+			const uint8 Character = Peek();
+			++Cur;
+
+			if (Character == ']')
+			{
+				return true;
+			}
+
+			if (Character != ',')
+			{
+				--Cur;
+				return Fail(TEXT("Expected ',' or ']' after a feature"));
+			}
+		}
+	});
+}
+
+bool FGeoJSONReader::ParseFeature(FGeoJSONFeature& Feature)
+{
+	return ParseObject([&]()
+	{
+		if (ScratchEquals("geometry"))
+		{
+			return Peek() == 'n' ? MatchLiteral("null") : ParseGeometry(Feature);
+		}
+
+		if (ScratchEquals("properties"))
+		{
+			return Peek() == 'n' ? MatchLiteral("null") : ParseProperties(Feature);
+		}
+
+		return SkipValue();
+	});
+}
+
+bool FGeoJSONReader::ParseGeometry(FGeoJSONFeature& Feature)
+{
+	const bool bSuccess = ParseObject([&]()
+	{
+		if (ScratchEquals("type"))
+		{
+			if (!ParseString())
+			{
+				return false;
+			}
+
+			Feature.GeometryType = GeometryTypeFromName(Scratch);
+			return true;
+		}
+
+		if (ScratchEquals("coordinates"))
+		{
+			return ParseCoordinates(Feature);
+		}
+
+		return SkipValue();
+	});
+
+	// Rings are grouped into polygons purely by nesting, which only means something for polygon geometry
+	if (Feature.GeometryType != EGeoJSONGeometryType::Polygon &&
+		Feature.GeometryType != EGeoJSONGeometryType::MultiPolygon)
+	{
+		Feature.PolygonOffsets.Reset();
+	}
+
+	return bSuccess;
+}
+
+bool FGeoJSONReader::ParseCoordinates(FGeoJSONFeature& Feature)
+{
+	if (!Expect('['))
+	{
+		return false;
+	}
+
+	// Positions are the innermost arrays. How deep they are is only known once the first number is reached, after
+	// that a ring starts with every array one level above the positions and a polygon one level above the rings
+	int32 Depth = 1;
+	int32 Rank = 0;
+	int32 NumComponents = 0;
+	double Position[2] = {0.0, 0.0};
+
+	const auto BeginArray = [&](int32 ArrayDepth)
+	{
+		if (ArrayDepth == Rank - 2)
+		{
+			Feature.PolygonOffsets.Add(Feature.RingOffsets.Num());
+		}
+		else if (ArrayDepth == Rank - 1)
+		{
+			Feature.RingOffsets.Add(Feature.Coordinates.Num());
+		}
+	};
+
+	while (Depth > 0)
+	{
+		const uint8 Character = Peek();
+
+		if (Character == '[')
+		{
+			++Cur;
+			++Depth;
+
+			if (Rank > 0)
+			{
+				if (Depth > Rank)
+				{
+					return Fail(TEXT("Inconsistent coordinate nesting"));
+				}
+
+				BeginArray(Depth);
+			}
+		}
+		else if (Character == ']')
+		{
+			++Cur;
+
+			if (Rank > 0 && Depth == Rank)
+			{
+				if (NumComponents < 2)
+				{
+					return Fail(TEXT("A position needs at least two values"));
+				}
+
+				Feature.Coordinates.Emplace(Position[0], Position[1]);
+				NumComponents = 0;
+			}
+
+			--Depth;
+		}
+		else if (Character == ',')
+		{
+			++Cur;
+		}
+		else if (Character == '-' || IsDigit(Character))
+		{
+			if (Rank == 0)
+			{
+				Rank = Depth;
+
+				for (int32 OpenDepth = 1; OpenDepth < Rank; ++OpenDepth)
+				{
+					BeginArray(OpenDepth);
+				}
+			}
+			else if (Depth != Rank)
+			{
+				return Fail(TEXT("Inconsistent coordinate nesting"));
+			}
+
+			double Value;
+			if (!ParseNumber(Value))
+			{
+				return false;
+			}
+
+			// Altitude and anything after it is dropped
+			if (NumComponents < 2)
+			{
+				Position[NumComponents] = Value;
+			}
+			++NumComponents;
+		}
+		else
+		{
+			return Fail(TEXT("Unexpected character in coordinates"));
+		}
+	}
+
+	return true;
+}
+
+bool FGeoJSONReader::ParseProperties(FGeoJSONFeature& Feature)
+{
+	return ParseObject([&]()
+	{
+		FString Key = ScratchToString();
+		const uint8 Character = Peek();
+
+		if (Character == '"')
+		{
+			if (!ParseString())
+			{
+				return false;
+			}
+
+			Feature.Properties.Add(MoveTemp(Key), ScratchToString());
+			return true;
+		}
+
+		if (Character == '-' || IsDigit(Character))
+		{
+			double Value;
+			if (!ParseNumber(Value))
+			{
+				return false;
+			}
+
+			Feature.Properties.Add(MoveTemp(Key), FString::SanitizeFloat(Value));
+			return true;
+		}
+
+		if (Character == 't')
+		{
+			if (!MatchLiteral("true"))
+			{
+				return false;
+			}
+
+			Feature.Properties.Add(MoveTemp(Key), TEXT("true"));
+			return true;
+		}
+
+		if (Character == 'f')
+		{
+			if (!MatchLiteral("false"))
+			{
+				return false;
+			}
+
+			Feature.Properties.Add(MoveTemp(Key), TEXT("false"));
+			return true;
+		}
+
+		// Nulls, objects and arrays aren't kept
+		return SkipValue();
+	});
+}
+
+bool FGeoJSONReader::SkipValue()
+{
+	const uint8 Character = Peek();
+
+	if (Character == '"')
+	{
+		return ParseString();
+	}
+
+	if (Character == '-' || IsDigit(Character))
+	{
+		double Value;
+		return ParseNumber(Value);
+	}
+
+	if (Character == 't')
+	{
+		return MatchLiteral("true");
+	}
+
+	if (Character == 'f')
+	{
+		return MatchLiteral("false");
+	}
+
+	if (Character == 'n')
+	{
+		return MatchLiteral("null");
+	}
+
+	if (Character != '{' && Character != '[')
+	{
+		return Fail(TEXT("Expected a value"));
+	}
+
+	// Only strings need real parsing, a bracket inside one mustn't count
+	int32 Depth = 0;
+
+	do
+	{
+		const uint8 Next = Peek();
+
+		if (Next == '"')
+		{
+			if (!ParseString())
+			{
+				return false;
+			}
+			continue;
+		}
+
+		if (Next == 0)
+		{
+			return Fail(TEXT("Unexpected end of input"));
+		}
+
+		if (Next == '{' || Next == '[')
+		{
+			++Depth;
+		}
+		else if (Next == '}' || Next == ']')
+		{
+			--Depth;
+		}
+
+		++Cur;
+	}
+	while (Depth > 0);
+
+	return true;
+}
+
+bool FGeoJSONReader::ParseString()
+{
+	if (!Expect('"'))
+	{
+		return false;
+	}
+
+	Scratch.Reset();
+
+	for (;;)
+	{
+		// Copy everything up to the next quote or escape in one go
+		const uint8* RunStart = Cur;
+		while (Cur < End && *Cur != '"' && *Cur != '\\')
+		{
+			++Cur;
+		}
+
+		Scratch.Append(reinterpret_cast<const ANSICHAR*>(RunStart), static_cast<int32>(Cur - RunStart));
+
+		if (Cur >= End)
+		{
+			return Fail(TEXT("Unterminated string"));
+		}
+
+		if (*Cur++ == '"')
+		{
+			return true;
+		}
+
+		if (Cur >= End)
+		{
+			return Fail(TEXT("Unterminated string"));
+		}
+
+		const uint8 Escape = *Cur++;
+
+		switch (Escape)
+		{
+		case '"': Scratch.Add('"');
+			break;
+		case '\\': Scratch.Add('\\');
+			break;
+		case '/': Scratch.Add('/');
+			break;
+		case 'b': Scratch.Add('\b');
+			break;
+		case 'f': Scratch.Add('\f');
+			break;
+		case 'n': Scratch.Add('\n');
+			break;
+		case 'r': Scratch.Add('\r');
+			break;
+		case 't': Scratch.Add('\t');
+			break;
+		case 'u':
+			{
+				const auto ReadHex = [this](uint32& OutValue)
+				{
+					if (End - Cur < 4)
+					{
+						return false;
+					}
+
+					OutValue = 0;
+					for (int32 i = 0; i < 4; ++i)
+					{
+						const int32 Digit = HexValue(*Cur++);
+						if (Digit < 0)
+						{
+							return false;
+						}
+						OutValue = (OutValue << 4) | Digit;
+					}
+					return true;
+				};
+
+				uint32 CodePoint;
+				if (!ReadHex(CodePoint))
+				{
+					return Fail(TEXT("Invalid unicode escape"));
+				}
+
+				// Surrogate pairs come as two escapes
+				if (CodePoint >= 0xD800 && CodePoint <= 0xDBFF && End - Cur >= 6 && Cur[0] == '\\' && Cur[1] == 'u')
+				{
+					Cur += 2;
+					uint32 LowSurrogate;
+					if (!ReadHex(LowSurrogate) || LowSurrogate < 0xDC00 || LowSurrogate > 0xDFFF)
+					{
+						return Fail(TEXT("Invalid surrogate pair"));
+					}
+
+					CodePoint = 0x10000 + ((CodePoint - 0xD800) << 10) + (LowSurrogate - 0xDC00);
+				}
+
+				AppendUTF8(Scratch, CodePoint);
+				break;
+			}
+		default:
+			return Fail(TEXT("Invalid escape"));
+		}
+	}
+}
+
+bool FGeoJSONReader::ParseNumber(double& OutValue)
+{
+	// Up to 19 significant digits are accumulated as an integer and scaled once at the end. Within an ulp or so of
+	// a correctly rounded parse, which is plenty for coordinates and a lot cheaper than going through strtod
+	bool bNegative = false;
+	if (Cur < End && *Cur == '-')
+	{
+		bNegative = true;
+		++Cur;
+	}
+
+	if (Cur >= End || !IsDigit(*Cur))
+	{
+		return Fail(TEXT("Invalid number"));
+	}
+
+	uint64 Mantissa = 0;
+	int32 NumDigits = 0;
+	int32 Exponent = 0;
+
+	while (Cur < End && IsDigit(*Cur))
+	{
+		if (NumDigits < 19)
+		{
+			Mantissa = Mantissa * 10 + (*Cur - '0');
+			NumDigits += Mantissa != 0;
+		}
+		else
+		{
+			++Exponent;
+		}
+		++Cur;
+	}
+
+	if (Cur < End && *Cur == '.')
+	{
+		++Cur;
+
+		if (Cur >= End || !IsDigit(*Cur))
+		{
+			return Fail(TEXT("Invalid number"));
+		}
+
+		while (Cur < End && IsDigit(*Cur))
+		{
+			if (NumDigits < 19)
+			{
+				Mantissa = Mantissa * 10 + (*Cur - '0');
+				NumDigits += Mantissa != 0;
+				--Exponent;
+			}
+			++Cur;
+		}
+	}
+
+	if (Cur < End && (*Cur == 'e' || *Cur == 'E'))
+	{
+		++Cur;
+
+		bool bNegativeExponent = false;
+		if (Cur < End && (*Cur == '-' || *Cur == '+'))
+		{
+			bNegativeExponent = *Cur == '-';
+			++Cur;
+		}
+
+		if (Cur >= End || !IsDigit(*Cur))
+		{
+			return Fail(TEXT("Invalid number"));
+		}
+
+		int32 ExplicitExponent = 0;
+		while (Cur < End && IsDigit(*Cur))
+		{
+			ExplicitExponent = FMath::Min(ExplicitExponent * 10 + (*Cur - '0'), 100000);
+			++Cur;
+		}
+
+		Exponent += bNegativeExponent ? -ExplicitExponent : ExplicitExponent;
+	}
+
+	double Value = static_cast<double>(Mantissa);
+
+	if (Mantissa != 0 && Exponent != 0)
+	{
+		constexpr int32 MaxExactPower = UE_ARRAY_COUNT(ExactPowersOfTen) - 1;
+
+		if (Exponent < 0 && Exponent >= -MaxExactPower)
+		{
+			Value /= ExactPowersOfTen[-Exponent];
+		}
+		else if (Exponent > 0 && Exponent <= MaxExactPower)
+		{
+			Value *= ExactPowersOfTen[Exponent];
+		}
+		else
+		{
+			Value *= FMath::Pow(10.0, static_cast<double>(Exponent));
+		}
+	}
+
+	OutValue = bNegative ? -Value : Value;
+	return true;
+}
+
+bool FGeoJSONReader::MatchLiteral(const ANSICHAR* Literal)
+{
+	const int32 Length = FCStringAnsi::Strlen(Literal);
+
+	if (End - Cur < Length || FMemory::Memcmp(Cur, Literal, Length) != 0)
+	{
+		return Fail(TEXT("Invalid literal"));
+	}
+
+	Cur += Length;
+	return true;
+}
+
+uint8 FGeoJSONReader::Peek()
+{
+	while (Cur < End && IsWhitespace(*Cur))
+	{
+		++Cur;
+	}
+
+	return Cur < End ? *Cur : 0;
+}
+
+bool FGeoJSONReader::Expect(uint8 Character)
+{
+	if (Peek() != Character)
+	{
+		return Fail(*FString::Printf(TEXT("Expected '%c'"), static_cast<TCHAR>(Character)));
+	}
+
+	++Cur;
+	return true;
+}
+
+bool FGeoJSONReader::ScratchEquals(const ANSICHAR* Literal) const
+{
+	const int32 Length = FCStringAnsi::Strlen(Literal);
+	return Scratch.Num() == Length && FMemory::Memcmp(Scratch.GetData(), Literal, Length) == 0;
+}
+
+FString FGeoJSONReader::ScratchToString() const
+{
+	const FUTF8ToTCHAR Converted(Scratch.GetData(), Scratch.Num());
+	return FString(Converted.Length(), Converted.Get());
+}
+
+bool FGeoJSONReader::Fail(const TCHAR* Message)
+{
+	// Keep the first error, the callers unwinding after it would only add noise
+	if (Error.IsEmpty())
+	{
+		Error = FString::Printf(TEXT("%s at byte %lld"), Message, static_cast<long long>(Cur - Begin));
+	}
+
+	return false;
+}
@@ -0,0 +1,79 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#include "GeographicTangentPlane.h"
+
+#include "SpatialPolygon.h"
+
+namespace
+{
+	FVector GetDirection(const FVector2D& Geographic)
+	{
+		const double Longitude = FMath::DegreesToRadians(Geographic.X);
+		const double Latitude = FMath::DegreesToRadians(Geographic.Y);
+
+		return FVector(
+			FMath::Cos(Latitude) * FMath::Cos(Longitude),
+			FMath::Cos(Latitude) * FMath::Sin(Longitude),
+			FMath::Sin(Latitude)
+		);
+	}
+}
+
+FGeographicTangentPlane::FGeographicTangentPlane(const FVector2D& InOrigin, double InRadius)
+	: Origin(InOrigin), Radius(FMath::Max(InRadius, UE_SMALL_NUMBER))
+{
+	const double Longitude = FMath::DegreesToRadians(Origin.X);
+	const double Latitude = FMath::DegreesToRadians(Origin.Y);
+
+	Up = GetDirection(Origin);
+	East = FVector(-FMath::Sin(Longitude), FMath::Cos(Longitude), 0.0);
+	North = FVector(
+		-FMath::Sin(Latitude) * FMath::Cos(Longitude),
+		-FMath::Sin(Latitude) * FMath::Sin(Longitude),
+		FMath::Cos(Latitude)
+	);
+}
+
+FVector2D FGeographicTangentPlane::ToLocal(const FVector2D& Geographic) const
+{
+	const FVector Direction = GetDirection(Geographic);
+	return FVector2D(Direction | East, Direction | North) * Radius;
+}
+
+FVector2D FGeographicTangentPlane::ToGeographic(const FVector2D& Local) const
+{
+	const FVector2D Unit = Local / Radius;
+	const double Height = FMath::Sqrt(FMath::Max(1.0 - Unit.SizeSquared(), 0.0));
+	const FVector Direction = East * Unit.X + North * Unit.Y + Up * Height;
+
+	const double Longitude = FMath::RadiansToDegrees(FMath::Atan2(Direction.Y, Direction.X));
+	const double Latitude = FMath::RadiansToDegrees(FMath::Asin(FMath::Clamp(Direction.Z, -1.0, 1.0)));
+
+	// Features across the antimeridian keep continuous longitudes
+	return FVector2D(Origin.X + FMath::UnwindDegrees(Longitude - Origin.X), Latitude);
+}
+
+void FGeographicTangentPlane::ToLocal(const FSpatialPolygon& Polygon, FSpatialPolygon& OutPolygon) const
+{
+	TArray<FVector2D> LocalRing;
+
+	for (int32 RingIndex = 0; RingIndex < Polygon.GetNumRings(); ++RingIndex)
+	{
+		const TArrayView<const FVector2D> Ring = Polygon.GetRing(RingIndex);
+
+		LocalRing.Reset(Ring.Num());
+		for (const FVector2D& Point : Ring)
+		{
+			LocalRing.Add(ToLocal(Point));
+		}
+
+		OutPolygon.AddRing(LocalRing);
+	}
+
+	OutPolygon.Build();
+}
+
+double FGeographicTangentPlane::GetMaxDistanceError(double Extent) const
+{
+	return 1.0 - FMath::Cos(FMath::Min(Extent / Radius, HALF_PI));
+}
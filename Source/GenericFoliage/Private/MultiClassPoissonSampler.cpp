@@ -0,0 +1,241 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#include "MultiClassPoissonSampler.h"
+
+#include "GenericFoliage.h"
+#include "SpatialPolygon.h"
+
+/** Cells of the shared grid beyond which sampling is refused rather than running out of memory */
+#define MULTI_CLASS_MAX_CELLS 67108864
+
+/** Active points visited between checks for cancellation */
+#define MULTI_CLASS_CANCEL_CHECK_POINTS 256
+
+FMultiClassPoissonSampler::FMultiClassPoissonSampler(const FSpatialPolygon& InPolygon, TArray<double> InClassRadii,
+                                                     int32 InRejectionThreshold, int32 InSeed)
+	: Polygon(InPolygon), ClassRadii(MoveTemp(InClassRadii)), RejectionThreshold(InRejectionThreshold),
+	  RandomStream(InSeed)
+{
+	const int32 NumClasses = ClassRadii.Num();
+	Distances.SetNumZeroed(NumClasses * NumClasses);
+
+	for (int32 ClassIndex = 0; ClassIndex < NumClasses; ++ClassIndex)
+	{
+		Distances[ClassIndex * NumClasses + ClassIndex] = ClassRadii[ClassIndex];
+	}
+}
+
+void FMultiClassPoissonSampler::SetClassDistance(int32 ClassA, int32 ClassB, double Distance)
+{
+	if (ClassA == ClassB || !ClassRadii.IsValidIndex(ClassA) || !ClassRadii.IsValidIndex(ClassB))
+	{
+		return;
+	}
+
+	Distances[ClassA * ClassRadii.Num() + ClassB] = FMath::Max(Distance, 0.0);
+	Distances[ClassB * ClassRadii.Num() + ClassA] = FMath::Max(Distance, 0.0);
+}
+
+bool FMultiClassPoissonSampler::TryAdd(const FVector2D& Candidate, int32 ClassIndex, TArray<int32>& ActivePoints)
+{
+	if (!Polygon.Contains(Candidate))
+	{
+		return false;
+	}
+
+	const int32 CellX = FMath::Clamp(FMath::FloorToInt32((Candidate.X - Origin.X) * InvCellSize), 0, NumX - 1);
+	const int32 CellY = FMath::Clamp(FMath::FloorToInt32((Candidate.Y - Origin.Y) * InvCellSize), 0, NumY - 1);
+	const int32 Reach = ClassReach[ClassIndex];
+
+	for (int32 y = FMath::Max(CellY - Reach, 0); y <= FMath::Min(CellY + Reach, NumY - 1); ++y)
+	{
+		for (int32 x = FMath::Max(CellX - Reach, 0); x <= FMath::Min(CellX + Reach, NumX - 1); ++x)
+		{
+			for (int32 PointIndex = CellHeads[y * NumX + x]; PointIndex != INDEX_NONE;)
+			{
+				if (FVector2D::DistSquared(Candidate, Points[PointIndex]) <
+					FMath::Square(GetDistance(ClassIndex, PointClasses[PointIndex])))
+				{
+					return false;
+				}
+
+				PointIndex = NextInCell[PointIndex];
+			}
+		}
+	}
+
+	const int32 Cell = CellY * NumX + CellX;
+	const int32 PointIndex = Points.Add(Candidate);
+	PointClasses.Add(ClassIndex);
+	NextInCell.Add(CellHeads[Cell]);
+	CellHeads[Cell] = PointIndex;
+	ActivePoints.Add(PointIndex);
+	return true;
+}
+
+bool FMultiClassPoissonSampler::Sample(const std::atomic<bool>* bCancelled)
+{
+	if (Polygon.IsEmpty())
+	{
+		return true;
+	}
+
+	ClassOrder.Reset();
+	for (int32 ClassIndex = 0; ClassIndex < ClassRadii.Num(); ++ClassIndex)
+	{
+		if (ClassRadii[ClassIndex] > 0.0)
+		{
+			ClassOrder.Add(ClassIndex);
+		}
+	}
+
+	if (ClassOrder.Num() == 0)
+	{
+		return true;
+	}
+
+	ClassOrder.StableSort([this](int32 A, int32 B)
+	{
+		return ClassRadii[A] > ClassRadii[B];
+	});
+
+	// Cells of the densest class's radius, the sparser classes look a few cells further
+	const double CellSize = ClassRadii[ClassOrder.Last()];
+	const double LargestRadius = ClassRadii[ClassOrder[0]];
+	const FVector2D Size = Polygon.GetBounds().GetSize();
+
+	Origin = Polygon.GetBounds().Min;
+	InvCellSize = 1.0 / CellSize;
+	NumX = FMath::Max(FMath::CeilToInt32(Size.X * InvCellSize), 1);
+	NumY = FMath::Max(FMath::CeilToInt32(Size.Y * InvCellSize), 1);
+
+	if (static_cast<int64>(NumX) * NumY > MULTI_CLASS_MAX_CELLS)
+	{
+		UE_LOG(LogGenericFoliage, Error, TEXT("Multi-class grid (%i %i) exceeds MULTI_CLASS_MAX_CELLS!"), NumX, NumY);
+		return true;
+	}
+
+	CellHeads.Init(INDEX_NONE, NumX * NumY);
+
+	ClassReach.Init(0, ClassRadii.Num());
+	for (const int32 ClassIndex : ClassOrder)
+	{
+		double MaxDistance = 0.0;
+		for (const int32 OtherIndex : ClassOrder)
+		{
+			MaxDistance = FMath::Max(MaxDistance, GetDistance(ClassIndex, OtherIndex));
+		}
+
+		ClassReach[ClassIndex] = FMath::CeilToInt32(MaxDistance * InvCellSize);
+	}
+
+	TArray<int32> ActivePoints;
+	int32 NumVisited = 0;
+
+	const auto IsCancelled = [&]()
+	{
+		return bCancelled && ++NumVisited % MULTI_CLASS_CANCEL_CHECK_POINTS == 0 && *bCancelled;
+	};
+
+	// A single seed may grow over the whole polygon, so the growth checks for cancellation as it goes
+	const auto Grow = [&]()
+	{
+		while (ActivePoints.Num() > 0)
+		{
+			if (IsCancelled())
+			{
+				return false;
+			}
+
+			const int32 ActiveIndex = RandomStream.RandRange(0, ActivePoints.Num() - 1);
+			const FVector2D ActivePoint = Points[ActivePoints[ActiveIndex]];
+			const int32 ActiveClass = PointClasses[ActivePoints[ActiveIndex]];
+
+			bool bAcceptedCandidate = false;
+
+			// Candidates of each class sit between its own radius (or the distance it keeps from the active
+			// point's class, if larger) and twice that away
+			for (int32 OrderIndex = 0; OrderIndex < ClassOrder.Num() && !bAcceptedCandidate; ++OrderIndex)
+			{
+				const int32 ClassIndex = ClassOrder[OrderIndex];
+				const double Radius = FMath::Max(ClassRadii[ClassIndex], GetDistance(ActiveClass, ClassIndex));
+
+				for (int32 i = 0; i < RejectionThreshold; ++i)
+				{
+					const double Angle = RandomStream.FRand() * PI * 2.0;
+					const double Length = RandomStream.FRandRange(Radius, Radius * 2.0);
+
+					if (TryAdd(ActivePoint + FVector2D(FMath::Sin(Angle), FMath::Cos(Angle)) * Length, ClassIndex,
+					           ActivePoints))
+					{
+						bAcceptedCandidate = true;
+						break;
+					}
+				}
+			}
+
+			if (!bAcceptedCandidate)
+			{
+				ActivePoints.RemoveAtSwap(ActiveIndex);
+			}
+		}
+
+		return true;
+	};
+
+	// A dart per cell of the largest radius reaches every part of the polygon, the sparsest class that fits there
+	// takes it and the growth from it fills in every class
+	TArray<FSpatialPolygonSpan> Spans;
+	int32 NumSpanX = 0;
+	int32 NumSpanY = 0;
+	if (!Polygon.GetScanlineSpans(LargestRadius, Spans, NumSpanX, NumSpanY))
+	{
+		return true;
+	}
+
+	for (const FSpatialPolygonSpan& Span : Spans)
+	{
+		for (int32 x = Span.Begin; x < Span.End; ++x)
+		{
+			const FVector2D Seed = Origin + FVector2D(x + RandomStream.FRand(), Span.Row + RandomStream.FRand()) *
+				LargestRadius;
+
+			if (IsCancelled())
+			{
+				return false;
+			}
+
+			for (const int32 ClassIndex : ClassOrder)
+			{
+				if (TryAdd(Seed, ClassIndex, ActivePoints))
+				{
+					if (!Grow())
+					{
+						return false;
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+TArray<FVector2D> FMultiClassPoissonSampler::GetPoints(int32 ClassIndex) const
+{
+	TArray<FVector2D> ClassPoints;
+
+	for (int32 PointIndex = 0; PointIndex < Points.Num(); ++PointIndex)
+	{
+		if (PointClasses[PointIndex] == ClassIndex)
+		{
+			ClassPoints.Add(Points[PointIndex]);
+		}
+	}
+
+	return ClassPoints;
+}
+
+#undef MULTI_CLASS_MAX_CELLS
+#undef MULTI_CLASS_CANCEL_CHECK_POINTS
@@ -0,0 +1,364 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#include "PoissonCornerTiles.h"
+
+#include "GenericFoliage.h"
+#include "SpatialPolygon.h"
+
+/** Width of a tile in radii */
+#define CORNER_TILE_SIZE 10.0
+
+/** Half width of the square patch around each corner */
+#define CORNER_PATCH_EXTENT 2.5
+
+/**
+ * Half width of the strip along each edge between the corner patches. At least half a radius so the interiors of
+ * neighbouring tiles stay apart, and a radius narrower than the corner patches so the strips of one corner do too
+ */
+#define CORNER_EDGE_EXTENT 1.0
+
+/** Darts missing in a row before a patch counts as full */
+#define CORNER_TILE_MAX_MISSES 1000
+
+/** Candidates tried around an active point before it is retired */
+#define CORNER_TILE_REJECTION_THRESHOLD 30
+
+/** Points one fill may produce, beyond which it is refused rather than running out of memory */
+#define CORNER_TILE_MAX_POINTS 67108864
+
+namespace
+{
+	/**
+	 * Poisson points a unit apart inside a region of the box, which also keep a unit away from the fixed points.
+	 * Patches hold a few hundred points at most, so candidates are checked against every point
+	 */
+	template <typename InsideType>
+	void SamplePatch(const FBox2D& Box, InsideType&& IsInside, TArrayView<const FVector2D> Fixed,
+	                 const FRandomStream& RandomStream, TArray<FVector2D>& OutPoints)
+	{
+		TArray<int32> ActivePoints;
+
+		const auto TryAdd = [&](const FVector2D& Candidate)
+		{
+			if (!IsInside(Candidate))
+			{
+				return false;
+			}
+
+			for (const FVector2D& Point : Fixed)
+			{
+				if (FVector2D::DistSquared(Candidate, Point) < 1.0)
+				{
+					return false;
+				}
+			}
+
+			for (const FVector2D& Point : OutPoints)
+			{
+				if (FVector2D::DistSquared(Candidate, Point) < 1.0)
+				{
+					return false;
+				}
+			}
+
+			ActivePoints.Add(OutPoints.Add(Candidate));
+			return true;
+		};
+
+		// Darts reach the parts growth can't get to across the fixed points, each hit is grown as far as it goes
+		for (int32 Misses = 0; Misses < CORNER_TILE_MAX_MISSES;)
+		{
+			const FVector2D Seed(
+				FMath::Lerp(Box.Min.X, Box.Max.X, static_cast<double>(RandomStream.FRand())),
+				FMath::Lerp(Box.Min.Y, Box.Max.Y, static_cast<double>(RandomStream.FRand()))
+			);
+
+			if (!TryAdd(Seed))
+			{
+				++Misses;
+				continue;
+			}
+			Misses = 0;
+
+			while (ActivePoints.Num() > 0)
+			{
+				const int32 ActiveIndex = RandomStream.RandRange(0, ActivePoints.Num() - 1);
+				const FVector2D ActivePoint = OutPoints[ActivePoints[ActiveIndex]];
+
+				bool bAcceptedCandidate = false;
+
+				for (int32 i = 0; i < CORNER_TILE_REJECTION_THRESHOLD; ++i)
+				{
+					const double Angle = RandomStream.FRand() * PI * 2.0;
+					const double Length = 1.0 + RandomStream.FRand();
+
+					if (TryAdd(ActivePoint + FVector2D(FMath::Sin(Angle), FMath::Cos(Angle)) * Length))
+					{
+						bAcceptedCandidate = true;
+						break;
+					}
+				}
+
+				if (!bAcceptedCandidate)
+				{
+					ActivePoints.RemoveAtSwap(ActiveIndex);
+				}
+			}
+		}
+	}
+
+	void AppendShifted(TArrayView<const FVector2D> Points, const FVector2D& Offset, TArray<FVector2D>& OutPoints)
+	{
+		for (const FVector2D& Point : Points)
+		{
+			OutPoints.Add(Point + Offset);
+		}
+	}
+}
+
+FPoissonCornerTiles::FPoissonCornerTiles(int32 Seed, int32 InNumColours)
+	: NumColours(FMath::Clamp(InNumColours, 1, 4))
+{
+	const FRandomStream RandomStream(Seed);
+	const double TileSize = CORNER_TILE_SIZE;
+	const double CornerExtent = CORNER_PATCH_EXTENT;
+	const double EdgeExtent = CORNER_EDGE_EXTENT;
+
+	// Patches around a corner, centred on it
+	TArray<TArray<FVector2D>> Corners;
+	Corners.SetNum(NumColours);
+
+	for (TArray<FVector2D>& Corner : Corners)
+	{
+		SamplePatch(FBox2D(FVector2D(-CornerExtent), FVector2D(CornerExtent)), [CornerExtent](const FVector2D& Point)
+		{
+			return FMath::Abs(Point.X) < CornerExtent && FMath::Abs(Point.Y) < CornerExtent;
+		}, {}, RandomStream, Corner);
+	}
+
+	// Strips along an edge between the patches of its two corners, from the first corner's position
+	TArray<TArray<FVector2D>> HorizontalEdges;
+	TArray<TArray<FVector2D>> VerticalEdges;
+	HorizontalEdges.SetNum(NumColours * NumColours);
+	VerticalEdges.SetNum(NumColours * NumColours);
+
+	TArray<FVector2D> Fixed;
+
+	for (int32 Edge = 0; Edge < NumColours * NumColours; ++Edge)
+	{
+		const TArray<FVector2D>& First = Corners[Edge % NumColours];
+		const TArray<FVector2D>& Second = Corners[Edge / NumColours];
+
+		Fixed.Reset();
+		AppendShifted(First, FVector2D::ZeroVector, Fixed);
+		AppendShifted(Second, FVector2D(TileSize, 0.0), Fixed);
+
+		SamplePatch(FBox2D(FVector2D(CornerExtent, -EdgeExtent), FVector2D(TileSize - CornerExtent, EdgeExtent)),
+		            [=](const FVector2D& Point)
+		            {
+			            return Point.X >= CornerExtent && Point.X < TileSize - CornerExtent &&
+				            FMath::Abs(Point.Y) < EdgeExtent;
+		            }, Fixed, RandomStream, HorizontalEdges[Edge]);
+
+		Fixed.Reset();
+		AppendShifted(First, FVector2D::ZeroVector, Fixed);
+		AppendShifted(Second, FVector2D(0.0, TileSize), Fixed);
+
+		SamplePatch(FBox2D(FVector2D(-EdgeExtent, CornerExtent), FVector2D(EdgeExtent, TileSize - CornerExtent)),
+		            [=](const FVector2D& Point)
+		            {
+			            return Point.Y >= CornerExtent && Point.Y < TileSize - CornerExtent &&
+				            FMath::Abs(Point.X) < EdgeExtent;
+		            }, Fixed, RandomStream, VerticalEdges[Edge]);
+	}
+
+	// Each tile is what its corner and edge patches leave inside it, plus its own interior
+	const int32 NumTiles = NumColours * NumColours * NumColours * NumColours;
+	Tiles.SetNum(NumTiles);
+
+	for (int32 TileIndex = 0; TileIndex < NumTiles; ++TileIndex)
+	{
+		const int32 Colour00 = TileIndex % NumColours;
+		const int32 Colour10 = (TileIndex / NumColours) % NumColours;
+		const int32 Colour01 = (TileIndex / (NumColours * NumColours)) % NumColours;
+		const int32 Colour11 = TileIndex / (NumColours * NumColours * NumColours);
+
+		Fixed.Reset();
+		AppendShifted(Corners[Colour00], FVector2D(0.0, 0.0), Fixed);
+		AppendShifted(Corners[Colour10], FVector2D(TileSize, 0.0), Fixed);
+		AppendShifted(Corners[Colour01], FVector2D(0.0, TileSize), Fixed);
+		AppendShifted(Corners[Colour11], FVector2D(TileSize, TileSize), Fixed);
+		AppendShifted(HorizontalEdges[Colour00 + Colour10 * NumColours], FVector2D(0.0, 0.0), Fixed);
+		AppendShifted(HorizontalEdges[Colour01 + Colour11 * NumColours], FVector2D(0.0, TileSize), Fixed);
+		AppendShifted(VerticalEdges[Colour00 + Colour01 * NumColours], FVector2D(0.0, 0.0), Fixed);
+		AppendShifted(VerticalEdges[Colour10 + Colour11 * NumColours], FVector2D(TileSize, 0.0), Fixed);
+
+		TArray<FVector2D>& Tile = Tiles[TileIndex];
+
+		SamplePatch(FBox2D(FVector2D::ZeroVector, FVector2D(TileSize)), [=](const FVector2D& Point)
+		{
+			const double EdgeDistanceX = FMath::Min(Point.X, TileSize - Point.X);
+			const double EdgeDistanceY = FMath::Min(Point.Y, TileSize - Point.Y);
+
+			return EdgeDistanceX >= EdgeExtent && EdgeDistanceY >= EdgeExtent &&
+				(EdgeDistanceX >= CornerExtent || EdgeDistanceY >= CornerExtent);
+		}, Fixed, RandomStream, Tile);
+
+		for (const FVector2D& Point : Fixed)
+		{
+			if (Point.X >= 0.0 && Point.X < TileSize && Point.Y >= 0.0 && Point.Y < TileSize)
+			{
+				Tile.Add(Point);
+			}
+		}
+
+		MaxTilePoints = FMath::Max(MaxTilePoints, Tile.Num());
+	}
+}
+
+const FPoissonCornerTiles& FPoissonCornerTiles::Get()
+{
+	static const FPoissonCornerTiles SharedTiles;
+	return SharedTiles;
+}
+
+double FPoissonCornerTiles::GetTileSize()
+{
+	return CORNER_TILE_SIZE;
+}
+
+bool FPoissonCornerTiles::Fill(const FVector2D& Size, int32 Seed, TArray<FVector2D>& OutPoints) const
+{
+	if (Size.X <= 0.0 || Size.Y <= 0.0)
+	{
+		return true;
+	}
+
+	const double TileSize = CORNER_TILE_SIZE;
+	const double NumTilesX = FMath::CeilToDouble(Size.X / TileSize);
+	const double NumTilesY = FMath::CeilToDouble(Size.Y / TileSize);
+
+	if (NumTilesX * NumTilesY > static_cast<double>(MAX_int32) ||
+		!CanFill(static_cast<int64>(NumTilesX) * static_cast<int64>(NumTilesY)))
+	{
+		return false;
+	}
+
+	const int32 NumX = static_cast<int32>(NumTilesX);
+	const int32 NumY = static_cast<int32>(NumTilesY);
+
+	// Colours of the corners below and above the current row of tiles
+	TArray<int32> BottomColours;
+	TArray<int32> TopColours;
+	BottomColours.SetNumUninitialized(NumX + 1);
+	TopColours.SetNumUninitialized(NumX + 1);
+
+	for (int32 X = 0; X <= NumX; ++X)
+	{
+		BottomColours[X] = GetCornerColour(X, 0, Seed);
+	}
+
+	const int32 PointsPerTile = Tiles.Num() > 0 ? Tiles[0].Num() : 0;
+	OutPoints.Reserve(OutPoints.Num() + static_cast<int32>(FMath::Min<int64>(
+		static_cast<int64>(NumX) * NumY * PointsPerTile, MAX_int32 - OutPoints.Num())));
+
+	for (int32 Y = 0; Y < NumY; ++Y)
+	{
+		for (int32 X = 0; X <= NumX; ++X)
+		{
+			TopColours[X] = GetCornerColour(X, Y + 1, Seed);
+		}
+
+		for (int32 X = 0; X < NumX; ++X)
+		{
+			const TArray<FVector2D>& Tile = GetTile(BottomColours[X], BottomColours[X + 1], TopColours[X],
+			                                        TopColours[X + 1]);
+			const FVector2D Offset(X * TileSize, Y * TileSize);
+
+			// Only the last row and column of tiles reach past the size
+			if (X < NumX - 1 && Y < NumY - 1)
+			{
+				AppendShifted(Tile, Offset, OutPoints);
+				continue;
+			}
+
+			for (const FVector2D& Point : Tile)
+			{
+				const FVector2D Shifted = Point + Offset;
+				if (Shifted.X < Size.X && Shifted.Y < Size.Y)
+				{
+					OutPoints.Add(Shifted);
+				}
+			}
+		}
+
+		Swap(BottomColours, TopColours);
+	}
+
+	return true;
+}
+
+bool FPoissonCornerTiles::FillSpans(TArrayView<const FSpatialPolygonSpan> Spans, int32 Seed,
+                                    TArray<FVector2D>& OutPoints, TArray<FVector2D>* OutBoundaryPoints) const
+{
+	int64 NumTiles = 0;
+	for (const FSpatialPolygonSpan& Span : Spans)
+	{
+		NumTiles += Span.End - Span.Begin;
+	}
+
+	if (!CanFill(NumTiles))
+	{
+		return false;
+	}
+
+	const double TileSize = CORNER_TILE_SIZE;
+
+	for (const FSpatialPolygonSpan& Span : Spans)
+	{
+		TArray<FVector2D>& SpanPoints = Span.bBoundary && OutBoundaryPoints ? *OutBoundaryPoints : OutPoints;
+
+		for (int32 X = Span.Begin; X < Span.End; ++X)
+		{
+			const TArray<FVector2D>& Tile = GetTile(GetCornerColour(X, Span.Row, Seed),
+			                                        GetCornerColour(X + 1, Span.Row, Seed),
+			                                        GetCornerColour(X, Span.Row + 1, Seed),
+			                                        GetCornerColour(X + 1, Span.Row + 1, Seed));
+
+			AppendShifted(Tile, FVector2D(X * TileSize, Span.Row * TileSize), SpanPoints);
+		}
+	}
+
+	return true;
+}
+
+int32 FPoissonCornerTiles::GetCornerColour(int32 X, int32 Y, int32 Seed) const
+{
+	return static_cast<int32>(HashCombine(HashCombine(GetTypeHash(X), GetTypeHash(Y)), GetTypeHash(Seed)) %
+		static_cast<uint32>(NumColours));
+}
+
+bool FPoissonCornerTiles::CanFill(int64 NumTiles) const
+{
+	if (NumTiles * MaxTilePoints > CORNER_TILE_MAX_POINTS)
+	{
+		UE_LOG(LogGenericFoliage, Error, TEXT("Corner tile fill (%lld tiles) exceeds CORNER_TILE_MAX_POINTS!"),
+		       NumTiles);
+		return false;
+	}
+
+	return true;
+}
+
+const TArray<FVector2D>& FPoissonCornerTiles::GetTile(int32 Colour00, int32 Colour10, int32 Colour01,
+                                                      int32 Colour11) const
+{
+	return Tiles[Colour00 + NumColours * (Colour10 + NumColours * (Colour01 + NumColours * Colour11))];
+}
+
+#undef CORNER_TILE_SIZE
+#undef CORNER_PATCH_EXTENT
+#undef CORNER_EDGE_EXTENT
+#undef CORNER_TILE_MAX_MISSES
+#undef CORNER_TILE_REJECTION_THRESHOLD
+#undef CORNER_TILE_MAX_POINTS
@@ -2,14 +2,21 @@
 
 
 #include "SamplerLibrary.h"
+#include "GeographicTangentPlane.h"
+#include "PoissonCornerTiles.h"
 #include "SpatialLibrary.h"
+#include "SpatialPolygon.h"
 #include "GenericFoliage.h"
+#include "Async/ParallelFor.h"
 
 #define MAX_GRID_SIZE 67108864
 
+/** Block width in grid cells for parallel sampling, about a thousand points per job */
+#define PARALLEL_BLOCK_CELLS 64
+
 bool IsValidCandidate(const FVector2D& Candidate, const FVector2D& RegionSize, const double& CellSize,
                       const double& Radius, const TArray<FVector2D>& Points, const int32* Grid, const int32& GridSizeX,
-                      const int32& GridSizeY, const FPoissonDiscSamplingSettings& Settings)
+                      const int32& GridSizeY)
 {
 	if (Candidate.X >= 0.0 && Candidate.X < RegionSize.X &&
 		Candidate.Y >= 0.0 && Candidate.Y < RegionSize.Y
@@ -32,28 +39,14 @@ bool IsValidCandidate(const FVector2D& Candidate, const FVector2D& RegionSize, c
 
 				if (PointIndex != -1)
 				{
-					if (Settings.bUseGeographicCoordinates)
-					{
-						const double Distance = USpatialLibrary::HaversineDistance(
-							Candidate + Settings.Origin,
-							Points[PointIndex] + Settings.Origin
-						);
-						
-						if (Distance < Settings.Radius)
-						{
-							return false;
-						}
-					} else
+					const double Distance = FVector2d::DistSquared(
+						Candidate,
+						Points[PointIndex]
+					);
+
+					if (Distance < Radius * Radius)
 					{
-						const double Distance = FVector2d::DistSquared(
-							Candidate,
-							Points[PointIndex]
-						);
-
-						if (Distance < Radius * Radius)
-						{
-							return false;
-						}
+						return false;
 					}
 				}
 			}
@@ -65,11 +58,72 @@ bool IsValidCandidate(const FVector2D& Candidate, const FVector2D& RegionSize, c
 	return false;
 }
 
+namespace
+{
+	void MakeRegion(const FVector2D& Min, const FVector2D& Size, FSpatialPolygon& OutRegion)
+	{
+		const FVector2D Max = Min + Size;
+		const TArray<FVector2D> Ring = {Min, FVector2D(Max.X, Min.Y), Max, FVector2D(Min.X, Max.Y)};
+
+		OutRegion.AddRing(Ring);
+		OutRegion.Build();
+	}
+
+	/**
+	 * Samples a polygon in degrees on the tangent plane at its centre, Settings.Radius metres apart with planar
+	 * distances, and maps the points back to degrees
+	 */
+	TArray<FVector2D> SampleGeographicPolygon(const FSpatialPolygon& Polygon, int32 RejectionThreshold,
+	                                          const FPoissonDiscSamplingSettings& Settings, int32 BlockCells)
+	{
+		const FGeographicTangentPlane Plane(Polygon.GetBounds().GetCenter());
+
+		FSpatialPolygon LocalPolygon;
+		Plane.ToLocal(Polygon, LocalPolygon);
+
+		FPoissonDiscSamplingSettings LocalSettings;
+		LocalSettings.Radius = Settings.Radius;
+		LocalSettings.Seed = Settings.Seed;
+
+		FPolygonPoissonSampler Sampler(LocalPolygon, Settings.Radius, RejectionThreshold, LocalSettings, BlockCells);
+		if (BlockCells > 0)
+		{
+			Sampler.SampleAllParallel();
+		}
+		else
+		{
+			Sampler.SampleAll();
+		}
+
+		TArray<FVector2D> Points = Sampler.GetPoints();
+		for (FVector2D& Point : Points)
+		{
+			Point = Plane.ToGeographic(Point);
+		}
+
+		return Points;
+	}
+}
+
 TArray<FVector2D> USamplerLibrary::PoissonDiscSampling(const double Radius,
                                                        const FVector2D RegionSize,
                                                        const int32 RejectionThreshold,
                                                        const FPoissonDiscSamplingSettings Settings)
 {
+	if (Settings.bUseGeographicCoordinates)
+	{
+		FSpatialPolygon Region;
+		MakeRegion(Settings.Origin, RegionSize, Region);
+
+		TArray<FVector2D> Points = SampleGeographicPolygon(Region, RejectionThreshold, Settings, 0);
+		for (FVector2D& Point : Points)
+		{
+			Point -= Settings.Origin;
+		}
+
+		return Points;
+	}
+
 	const double CellSize = Radius / FMath::Sqrt(2.0);
 	const int32 GridSizeX = static_cast<int32>(ceil(RegionSize.X / CellSize));
 	const int32 GridSizeY = static_cast<int32>(ceil(RegionSize.Y / CellSize));
@@ -86,11 +140,12 @@ TArray<FVector2D> USamplerLibrary::PoissonDiscSampling(const double Radius,
 	TArray<FVector2D> ActivePoints = {RegionSize / 2.0};
 
 	int32* Grid = new int32[GridSizeX * GridSizeY]{0};
+	const FRandomStream RandomStream(Settings.Seed);
 
 	while (ActivePoints.Num() > 0)
 	{
 		// Sample a point
-		const int32 ActiveIndex = FMath::RandRange(0, ActivePoints.Num() - 1);
+		const int32 ActiveIndex = RandomStream.RandRange(0, ActivePoints.Num() - 1);
 		const FVector2D& ActivePoint = ActivePoints[
 			ActiveIndex
 		];
@@ -99,13 +154,13 @@ TArray<FVector2D> USamplerLibrary::PoissonDiscSampling(const double Radius,
 
 		for (int i = 0; i < RejectionThreshold; ++i)
 		{
-			const double Angle = FMath::FRand() * PI * 2.0;
+			const double Angle = RandomStream.FRand() * PI * 2.0;
 			const FVector2D Direction = FVector2d(sin(Angle), cos(Angle));
-			const double Length = FMath::FRandRange(Radius, Radius * 2.0);
+			const double Length = RandomStream.FRandRange(Radius, Radius * 2.0);
 
 			const FVector2D Candidate = ActivePoint + (Direction * Length);
 
-			if (IsValidCandidate(Candidate, RegionSize, CellSize, Radius, Points, Grid, GridSizeX, GridSizeY, Settings))
+			if (IsValidCandidate(Candidate, RegionSize, CellSize, Radius, Points, Grid, GridSizeX, GridSizeY))
 			{
 				Points.Add(Candidate);
 				ActivePoints.Add(Candidate);
@@ -123,7 +178,8 @@ TArray<FVector2D> USamplerLibrary::PoissonDiscSampling(const double Radius,
 
 		if (!bAcceptedCandidate)
 		{
-			ActivePoints.RemoveAt(ActiveIndex);
+			// The active list is unordered, the pick is random anyway
+			ActivePoints.RemoveAtSwap(ActiveIndex);
 		}
 	}
 
@@ -132,10 +188,375 @@ TArray<FVector2D> USamplerLibrary::PoissonDiscSampling(const double Radius,
 	return Points;
 }
 
+/** Sampling grid which only has cells for the spans of a polygon */
+struct FPolygonPoissonSampler::FSpanGrid
+{
+	TArray<FSpatialPolygonSpan> Spans;
+
+	/** Spans of row y are [RowStart[y], RowStart[y + 1]) */
+	TArray<int32> RowStart;
+
+	/** Index of the first cell of each span */
+	TArray<int32> SpanOffset;
+
+	/** Index + 1 of the point in each cell within its block's points, 0 when empty */
+	TArray<int32> Cells;
+
+	int32 NumX = 0;
+	int32 NumY = 0;
+
+	/** False when the polygon's bounds or spans have too many cells, which are then never allocated */
+	bool Build(const FSpatialPolygon& Polygon, double CellSize)
+	{
+		if (!Polygon.GetScanlineSpans(CellSize, Spans, NumX, NumY))
+		{
+			return false;
+		}
+
+		RowStart.Init(0, NumY + 1);
+		SpanOffset.SetNumUninitialized(Spans.Num());
+
+		int64 NumCells = 0;
+		for (int32 i = 0; i < Spans.Num(); ++i)
+		{
+			++RowStart[Spans[i].Row + 1];
+			SpanOffset[i] = static_cast<int32>(NumCells);
+			NumCells += Spans[i].End - Spans[i].Begin;
+		}
+
+		if (NumCells > MAX_GRID_SIZE)
+		{
+			UE_LOG(LogGenericFoliage, Error, TEXT("Polygon grid (%lld cells) exceeds MAX_GRID_SIZE!"), NumCells);
+			return false;
+		}
+
+		for (int32 y = 0; y < NumY; ++y)
+		{
+			RowStart[y + 1] += RowStart[y];
+		}
+
+		Cells.SetNumUninitialized(static_cast<int32>(NumCells));
+		return true;
+	}
+
+	/** Cell index at (x, y), INDEX_NONE outside of the spans */
+	int32 Find(int32 x, int32 y, int32& OutSpanIndex) const
+	{
+		if (y < 0 || y >= NumY)
+		{
+			return INDEX_NONE;
+		}
+
+		for (int32 i = RowStart[y]; i < RowStart[y + 1]; ++i)
+		{
+			if (x < Spans[i].Begin)
+			{
+				break;
+			}
+
+			if (x < Spans[i].End)
+			{
+				OutSpanIndex = i;
+				return SpanOffset[i] + x - Spans[i].Begin;
+			}
+		}
+
+		return INDEX_NONE;
+	}
+};
+
+FPolygonPoissonSampler::FPolygonPoissonSampler(const FSpatialPolygon& InPolygon, double InRadius,
+                                               int32 InRejectionThreshold, FPoissonDiscSamplingSettings InSettings,
+                                               int32 InBlockCells)
+	: Polygon(InPolygon), Radius(InRadius), RejectionThreshold(InRejectionThreshold), Settings(InSettings),
+	  Grid(MakeUnique<FSpanGrid>())
+{
+	if (Polygon.IsEmpty() || Radius <= 0.0)
+	{
+		return;
+	}
+
+	CellSize = Radius / FMath::Sqrt(2.0);
+	InvCellSize = 1.0 / CellSize;
+	Origin = Polygon.GetBounds().Min;
+
+	if (!Grid->Build(Polygon, CellSize))
+	{
+		return;
+	}
+
+	FMemory::Memzero(Grid->Cells.GetData(), Grid->Cells.Num() * sizeof(int32));
+
+	// A block must be wider than the two cells a candidate looks around itself, or blocks of one phase would touch
+	BlockCells = InBlockCells > 0 ? FMath::Max(InBlockCells, 3) : FMath::Max3(Grid->NumX, Grid->NumY, 1);
+	NumBlocksX = FMath::DivideAndRoundUp(FMath::Max(Grid->NumX, 1), BlockCells);
+	NumBlocksY = FMath::DivideAndRoundUp(FMath::Max(Grid->NumY, 1), BlockCells);
+	BlockPoints.SetNum(NumBlocksX * NumBlocksY);
+
+	TBitArray<> BlockUsed(false, BlockPoints.Num());
+	for (const FSpatialPolygonSpan& Span : Grid->Spans)
+	{
+		for (int32 BlockX = Span.Begin / BlockCells; BlockX <= (Span.End - 1) / BlockCells; ++BlockX)
+		{
+			BlockUsed[(Span.Row / BlockCells) * NumBlocksX + BlockX] = true;
+		}
+	}
+
+	// 2x2 colouring, blocks of one colour are a whole block apart
+	for (TConstSetBitIterator<> It(BlockUsed); It; ++It)
+	{
+		const int32 BlockX = It.GetIndex() % NumBlocksX;
+		const int32 BlockY = It.GetIndex() / NumBlocksX;
+		PhaseBlocks[(BlockX & 1) | ((BlockY & 1) << 1)].Add(It.GetIndex());
+	}
+}
+
+FPolygonPoissonSampler::~FPolygonPoissonSampler() = default;
+
+int32 FPolygonPoissonSampler::GetNumCells() const
+{
+	return Grid->Cells.Num();
+}
+
+void FPolygonPoissonSampler::SampleBlock(int32 BlockIndex)
+{
+	const int32 BlockX = BlockIndex % NumBlocksX;
+	const int32 BlockY = BlockIndex / NumBlocksX;
+	const int32 FirstX = BlockX * BlockCells;
+	const int32 FirstY = BlockY * BlockCells;
+	const int32 EndX = FirstX + BlockCells;
+	const int32 EndY = FMath::Min(FirstY + BlockCells, Grid->NumY);
+
+	FSpanGrid& SpanGrid = *Grid;
+	TArray<FVector2D>& Points = BlockPoints[BlockIndex];
+	TArray<int32> ActivePoints;
+	const FRandomStream RandomStream(static_cast<int32>(HashCombine(static_cast<uint32>(Settings.Seed),
+	                                                                static_cast<uint32>(BlockIndex))));
+
+	const auto TryAdd = [&](const FVector2D& Candidate)
+	{
+		const int32 CellX = FMath::FloorToInt32((Candidate.X - Origin.X) * InvCellSize);
+		const int32 CellY = FMath::FloorToInt32((Candidate.Y - Origin.Y) * InvCellSize);
+
+		// Other blocks' cells are only read, they're filled by their own job
+		if (CellX < FirstX || CellX >= EndX || CellY < FirstY || CellY >= EndY)
+		{
+			return false;
+		}
+
+		int32 SpanIndex = INDEX_NONE;
+		const int32 Cell = SpanGrid.Find(CellX, CellY, SpanIndex);
+
+		// Anything off the spans is outside the polygon without further checks, a cell holds one point at most
+		if (Cell == INDEX_NONE || SpanGrid.Cells[Cell] != 0)
+		{
+			return false;
+		}
+
+		if (SpanGrid.Spans[SpanIndex].bBoundary && !Polygon.Contains(Candidate))
+		{
+			return false;
+		}
+
+		for (int32 y = FMath::Max(CellY - 2, 0); y <= FMath::Min(CellY + 2, SpanGrid.NumY - 1); ++y)
+		{
+			for (int32 i = SpanGrid.RowStart[y]; i < SpanGrid.RowStart[y + 1]; ++i)
+			{
+				const FSpatialPolygonSpan& Span = SpanGrid.Spans[i];
+				const int32 SearchFirstX = FMath::Max(Span.Begin, CellX - 2);
+				const int32 SearchLastX = FMath::Min(Span.End - 1, CellX + 2);
+
+				for (int32 x = SearchFirstX; x <= SearchLastX; ++x)
+				{
+					const int32 PointIndex = SpanGrid.Cells[SpanGrid.SpanOffset[i] + x - Span.Begin] - 1;
+
+					if (PointIndex != -1 &&
+						FVector2D::DistSquared(Candidate, GetBlockPoints(x, y)[PointIndex]) < Radius * Radius)
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		SpanGrid.Cells[Cell] = Points.Add(Candidate) + 1;
+		ActivePoints.Add(Points.Num() - 1);
+		return true;
+	};
+
+	const auto Grow = [&]()
+	{
+		while (ActivePoints.Num() > 0)
+		{
+			const int32 ActiveIndex = RandomStream.RandRange(0, ActivePoints.Num() - 1);
+			const FVector2D ActivePoint = Points[ActivePoints[ActiveIndex]];
+
+			bool bAcceptedCandidate = false;
+
+			for (int i = 0; i < RejectionThreshold; ++i)
+			{
+				const double Angle = RandomStream.FRand() * PI * 2.0;
+				const FVector2D Direction = FVector2d(sin(Angle), cos(Angle));
+				const double Length = RandomStream.FRandRange(Radius, Radius * 2.0);
+
+				if (TryAdd(ActivePoint + (Direction * Length)))
+				{
+					bAcceptedCandidate = true;
+					break;
+				}
+			}
+
+			if (!bAcceptedCandidate)
+			{
+				ActivePoints.RemoveAtSwap(ActiveIndex);
+			}
+		}
+	};
+
+	// Seed from every cell of the block still empty after the last growth. That reaches the separate parts of a
+	// multipolygon, anything the growth couldn't get to across a narrow neck and the gaps along earlier blocks
+	for (int32 y = FirstY; y < EndY; ++y)
+	{
+		for (int32 SpanIndex = SpanGrid.RowStart[y]; SpanIndex < SpanGrid.RowStart[y + 1]; ++SpanIndex)
+		{
+			const FSpatialPolygonSpan& Span = SpanGrid.Spans[SpanIndex];
+
+			for (int32 x = FMath::Max(Span.Begin, FirstX); x < FMath::Min(Span.End, EndX); ++x)
+			{
+				if (SpanGrid.Cells[SpanGrid.SpanOffset[SpanIndex] + x - Span.Begin] != 0)
+				{
+					continue;
+				}
+
+				const FVector2D Seed = Origin + FVector2D(x + RandomStream.FRand(), y + RandomStream.FRand()) * CellSize;
+				if (TryAdd(Seed))
+				{
+					Grow();
+				}
+			}
+		}
+	}
+}
+
+void FPolygonPoissonSampler::SampleAll()
+{
+	for (int32 Phase = 0; Phase < NumPhases; ++Phase)
+	{
+		for (const int32 BlockIndex : PhaseBlocks[Phase])
+		{
+			SampleBlock(BlockIndex);
+		}
+	}
+}
+
+void FPolygonPoissonSampler::SampleAllParallel()
+{
+	for (int32 Phase = 0; Phase < NumPhases; ++Phase)
+	{
+		const TArray<int32>& Blocks = PhaseBlocks[Phase];
+		ParallelFor(Blocks.Num(), [this, &Blocks](int32 Index)
+		{
+			SampleBlock(Blocks[Index]);
+		});
+	}
+}
+
+TArray<FVector2D> FPolygonPoissonSampler::GetPoints() const
+{
+	int32 NumPoints = 0;
+	for (const TArray<FVector2D>& Points : BlockPoints)
+	{
+		NumPoints += Points.Num();
+	}
+
+	TArray<FVector2D> AllPoints;
+	AllPoints.Reserve(NumPoints);
+	for (const TArray<FVector2D>& Points : BlockPoints)
+	{
+		AllPoints.Append(Points);
+	}
+
+	return AllPoints;
+}
+
+const TArray<FVector2D>& FPolygonPoissonSampler::GetBlockPoints(int32 CellX, int32 CellY) const
+{
+	return BlockPoints[(CellY / BlockCells) * NumBlocksX + CellX / BlockCells];
+}
+
+TArray<FVector2D> USamplerLibrary::PoissonDiscSamplingInPolygon(const FSpatialPolygon& Polygon,
+                                                                const double Radius,
+                                                                const int32 RejectionThreshold,
+                                                                FPoissonDiscSamplingSettings Settings)
+{
+	if (Settings.bUseGeographicCoordinates)
+	{
+		return SampleGeographicPolygon(Polygon, RejectionThreshold, Settings, 0);
+	}
+
+	FPolygonPoissonSampler Sampler(Polygon, Radius, RejectionThreshold, Settings);
+	Sampler.SampleAll();
+	return Sampler.GetPoints();
+}
+
+TArray<FVector2D> USamplerLibrary::ParallelPoissonDiscSampling(const double Radius, const FVector2D RegionSize,
+                                                               const int32 RejectionThreshold,
+                                                               const FPoissonDiscSamplingSettings Settings)
+{
+	// The region as a polygon at its origin, the sampler's points are absolute
+	FSpatialPolygon Region;
+	MakeRegion(Settings.Origin, RegionSize, Region);
+
+	TArray<FVector2D> Points;
+
+	if (Settings.bUseGeographicCoordinates)
+	{
+		Points = SampleGeographicPolygon(Region, RejectionThreshold, Settings, PARALLEL_BLOCK_CELLS);
+	}
+	else
+	{
+		FPolygonPoissonSampler Sampler(Region, Radius, RejectionThreshold, Settings, PARALLEL_BLOCK_CELLS);
+		Sampler.SampleAllParallel();
+		Points = Sampler.GetPoints();
+	}
+
+	for (FVector2D& Point : Points)
+	{
+		Point -= Settings.Origin;
+	}
+
+	return Points;
+}
+
+TArray<FVector2D> USamplerLibrary::TiledPoissonDiscSampling(const double Radius, const FVector2D RegionSize,
+                                                            const FPoissonDiscSamplingSettings Settings)
+{
+	if (Radius <= 0.0)
+	{
+		return {};
+	}
+
+	TArray<FVector2D> Points;
+	if (!FPoissonCornerTiles::Get().Fill(RegionSize / Radius, Settings.Seed, Points))
+	{
+		return {};
+	}
+
+	for (FVector2D& Point : Points)
+	{
+		Point *= Radius;
+	}
+
+	return Points;
+}
+
 TArray<FVector2D> USamplerLibrary::K2_PoissonDiscSampling2d(const double Radius, const FVector2D RegionSize,
-                                                            const int32 RejectionThreshold)
+                                                            const int32 RejectionThreshold, const int32 Seed)
 {
-	return PoissonDiscSampling(Radius, RegionSize, RejectionThreshold);
+	FPoissonDiscSamplingSettings Settings;
+	Settings.Seed = Seed;
+	return PoissonDiscSampling(Radius, RegionSize, RejectionThreshold, Settings);
 }
 
 #undef MAX_GRID_SIZE
+#undef PARALLEL_BLOCK_CELLS
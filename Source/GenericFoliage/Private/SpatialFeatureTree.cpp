@@ -0,0 +1,198 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#include "SpatialFeatureTree.h"
+
+#define FEATURE_TREE_FANOUT 16
+#define FEATURE_TREE_MIN_PENDING 64
+
+namespace
+{
+	/**
+	 * Orders the items so that every run of FEATURE_TREE_FANOUT makes a compact node: sorted on x into vertical
+	 * slices of about sqrt(nodes) nodes each, then on y within each slice.
+	 */
+	template <typename ItemType>
+	void SortTileRecursive(TArrayView<ItemType> Items)
+	{
+		const int32 NumNodes = FMath::DivideAndRoundUp(Items.Num(), FEATURE_TREE_FANOUT);
+		const int32 NumSlices = FMath::CeilToInt32(FMath::Sqrt(static_cast<double>(NumNodes)));
+		const int32 SliceSize = NumSlices * FEATURE_TREE_FANOUT;
+
+		Items.Sort([](const ItemType& A, const ItemType& B)
+		{
+			return A.Bounds.Min.X + A.Bounds.Max.X < B.Bounds.Min.X + B.Bounds.Max.X;
+		});
+
+		for (int32 SliceStart = 0; SliceStart < Items.Num(); SliceStart += SliceSize)
+		{
+			Items.Slice(SliceStart, FMath::Min(SliceSize, Items.Num() - SliceStart)).Sort(
+				[](const ItemType& A, const ItemType& B)
+				{
+					return A.Bounds.Min.Y + A.Bounds.Max.Y < B.Bounds.Min.Y + B.Bounds.Max.Y;
+				});
+		}
+	}
+}
+
+void FSpatialFeatureTree::Insert(int32 Value, const FBox2D& Bounds)
+{
+	Pending.Add({Bounds, Value});
+
+	if (Pending.Num() > FMath::Max(FEATURE_TREE_MIN_PENDING, Entries.Num() / 4))
+	{
+		Build();
+	}
+}
+
+bool FSpatialFeatureTree::Remove(int32 Value, const FBox2D& Bounds)
+{
+	const int32 PendingIndex = Pending.IndexOfByPredicate([Value](const FEntry& Entry)
+	{
+		return Entry.Value == Value;
+	});
+
+	if (PendingIndex != INDEX_NONE)
+	{
+		Pending.RemoveAtSwap(PendingIndex);
+		return true;
+	}
+
+	if (Nodes.Num() == 0)
+	{
+		return false;
+	}
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(Nodes.Num() - 1);
+
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+		if (!Node.Bounds.Intersect(Bounds))
+		{
+			continue;
+		}
+
+		for (int32 Index = Node.First; Index < Node.First + Node.Count; ++Index)
+		{
+			if (!Node.bIsLeaf)
+			{
+				Stack.Add(Index);
+			}
+			else if (Entries[Index].Value == Value)
+			{
+				Entries[Index].Value = INDEX_NONE;
+
+				if (++NumRemoved > FMath::Max(FEATURE_TREE_MIN_PENDING, Entries.Num() / 4))
+				{
+					Build();
+				}
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void FSpatialFeatureTree::Reset()
+{
+	Entries.Reset();
+	Pending.Reset();
+	Nodes.Reset();
+	NumRemoved = 0;
+}
+
+void FSpatialFeatureTree::Build()
+{
+	if (NumRemoved > 0)
+	{
+		Entries.RemoveAllSwap([](const FEntry& Entry)
+		{
+			return Entry.Value == INDEX_NONE;
+		});
+		NumRemoved = 0;
+	}
+
+	Entries.Append(Pending);
+	Pending.Reset();
+	Nodes.Reset();
+
+	if (Entries.Num() == 0)
+	{
+		return;
+	}
+
+	SortTileRecursive(TArrayView<FEntry>(Entries));
+
+	for (int32 First = 0; First < Entries.Num(); First += FEATURE_TREE_FANOUT)
+	{
+		FNode Leaf = {FBox2D(ForceInit), First, FMath::Min(FEATURE_TREE_FANOUT, Entries.Num() - First), true};
+		for (int32 Index = First; Index < First + Leaf.Count; ++Index)
+		{
+			Leaf.Bounds += Entries[Index].Bounds;
+		}
+		Nodes.Add(Leaf);
+	}
+
+	// Each level only points into the one below, so a level can be reordered before its parents are made
+	int32 LevelStart = 0;
+	while (Nodes.Num() - LevelStart > 1)
+	{
+		const int32 LevelEnd = Nodes.Num();
+		SortTileRecursive(TArrayView<FNode>(Nodes).Slice(LevelStart, LevelEnd - LevelStart));
+
+		for (int32 First = LevelStart; First < LevelEnd; First += FEATURE_TREE_FANOUT)
+		{
+			FNode Parent = {FBox2D(ForceInit), First, FMath::Min(FEATURE_TREE_FANOUT, LevelEnd - First), false};
+			for (int32 Index = First; Index < First + Parent.Count; ++Index)
+			{
+				Parent.Bounds += Nodes[Index].Bounds;
+			}
+			Nodes.Add(Parent);
+		}
+
+		LevelStart = LevelEnd;
+	}
+}
+
+void FSpatialFeatureTree::Query(const FBox2D& Box, TArray<int32>& OutValues) const
+{
+	if (Nodes.Num() > 0)
+	{
+		TArray<int32, TInlineAllocator<64>> Stack;
+		Stack.Add(Nodes.Num() - 1);
+
+		while (Stack.Num() > 0)
+		{
+			const FNode& Node = Nodes[Stack.Pop(false)];
+			if (!Node.Bounds.Intersect(Box))
+			{
+				continue;
+			}
+
+			for (int32 Index = Node.First; Index < Node.First + Node.Count; ++Index)
+			{
+				if (!Node.bIsLeaf)
+				{
+					Stack.Add(Index);
+				}
+				else if (Entries[Index].Value != INDEX_NONE && Entries[Index].Bounds.Intersect(Box))
+				{
+					OutValues.Add(Entries[Index].Value);
+				}
+			}
+		}
+	}
+
+	for (const FEntry& Entry : Pending)
+	{
+		if (Entry.Bounds.Intersect(Box))
+		{
+			OutValues.Add(Entry.Value);
+		}
+	}
+}
+
+#undef FEATURE_TREE_FANOUT
+#undef FEATURE_TREE_MIN_PENDING
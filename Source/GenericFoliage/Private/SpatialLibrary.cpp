@@ -4,93 +4,109 @@
 #include "SpatialLibrary.h"
 
 #include "GenericFoliage.h"
-#include "JsonObjectWrapper.h"
-#include "Dom/JsonObject.h"
+#include "GeoJSONReader.h"
 #include "GeometryScript/MeshPrimitiveFunctions.h"
 #include "GeometryScript/MeshSpatialFunctions.h"
 
 TArray<FSpatialFeature> USpatialLibrary::ParseGeoJSON(const FString& InGeoJSON, UDynamicMeshPool* MeshPool)
 {
-	FJsonObjectWrapper Wrapper;
-	if (!ensure(Wrapper.JsonObjectFromString(InGeoJSON)))
+	FGeoJSONReader Reader;
+	Reader.OpenString(InGeoJSON);
+	return ReadFeatures(Reader, MeshPool);
+}
+
+TArray<FSpatialFeature> USpatialLibrary::ParseGeoJSONFile(const FString& FilePath, UDynamicMeshPool* MeshPool)
+{
+	FGeoJSONReader Reader;
+	if (!Reader.OpenFile(FilePath))
 	{
-		UE_LOG(LogGenericFoliage, Error, TEXT("Failed to parse GeoJSON"))
+		UE_LOG(LogGenericFoliage, Error, TEXT("Failed to read GeoJSON: %s"), *Reader.GetError())
 		return {};
 	}
 
-	auto Object = Wrapper.JsonObject;
+	return ReadFeatures(Reader, MeshPool);
+}
+
+TArray<FSpatialFeature> USpatialLibrary::ReadFeatures(FGeoJSONReader& Reader, UDynamicMeshPool* MeshPool)
+{
+	TArray<FSpatialFeature> Features;
+
+	const bool bSuccess = Reader.ReadFeatures([&Features, MeshPool](const FGeoJSONFeature& Feature)
+	{
+		Features.Emplace(MakeSpatialFeature(Feature, MeshPool));
+		return true;
+	});
 
-	if (!(Object->GetStringField("type") == TEXT("FeatureCollection")))
+	if (!bSuccess)
 	{
-		UE_LOG(LogGenericFoliage, Error, TEXT("GeoJSON type is not of type 'FeatureCollection'!"))
+		UE_LOG(LogGenericFoliage, Error, TEXT("Failed to parse GeoJSON: %s"), *Reader.GetError())
 		return {};
 	}
 
-	TArray<FSpatialFeature> Features;
-	int32 Id = 0;
-	
-	for (auto FeatureJsonValue: Object->GetArrayField("features")) {
-		auto FeatureJsonObject = FeatureJsonValue->AsObject();
-		auto GeometryJsonObject = FeatureJsonObject->GetObjectField("geometry");
-		auto PropertiesJsonObject = FeatureJsonObject->GetObjectField("properties");
-		
-		
-		TMap<FString, FString> Properties;
-		UDynamicMesh* Mesh = nullptr;
-
-		if (GeometryJsonObject->GetStringField("type") == TEXT("Polygon"))
-		{
-			TArray<FVector2D> Coordinates;
-
-			for (auto CoordinateValues: GeometryJsonObject->GetArrayField("coordinates")[0]->AsArray())
-			{
-				auto CoordinateValue = CoordinateValues->AsArray();
-				Coordinates.Add(FVector2D(
-					CoordinateValue[0]->AsNumber(),
-					CoordinateValue[1]->AsNumber()
-				));
-			}
-
-			Mesh = MeshPool->RequestMesh();
-			Mesh->Reset();
-			
-			UGeometryScriptLibrary_MeshPrimitiveFunctions::AppendSimpleExtrudePolygon(
-				Mesh,
-				FGeometryScriptPrimitiveOptions{},
-				FTransform(),
-				Coordinates,
-				400.0f
-			);
-		}
+	return Features;
+}
+
+FSpatialFeature USpatialLibrary::MakeSpatialFeature(const FGeoJSONFeature& Feature, UDynamicMeshPool* MeshPool)
+{
+	FSpatialFeature SpatialFeature;
+	SpatialFeature.Properties = Feature.Properties;
+	SpatialFeature.Id = Feature.Id;
+	SpatialFeature.Hash = Feature.GetContentHash();
 
-		FGeometryScriptDynamicMeshBVH BVH;
-		UGeometryScriptLibrary_MeshSpatial::BuildBVHForMesh(Mesh, BVH);
+	const FString* Type = Feature.Properties.Find(TEXT("type"));
+	SpatialFeature.Type = Type ? FCString::Atoi(**Type) : 0;
 
-		for (auto Property: PropertiesJsonObject->Values)
+	if (Feature.GeometryType != EGeoJSONGeometryType::Polygon &&
+		Feature.GeometryType != EGeoJSONGeometryType::MultiPolygon)
+	{
+		return SpatialFeature;
+	}
+
+	const TSharedRef<FSpatialPolygon, ESPMode::ThreadSafe> Polygon = MakeShared<FSpatialPolygon, ESPMode::ThreadSafe>(
+		Feature);
+
+	if (Polygon->IsEmpty())
+	{
+		return SpatialFeature;
+	}
+
+	SpatialFeature.Bounds = Polygon->GetBounds();
+	SpatialFeature.Polygon = Polygon;
+
+	if (!IsValid(MeshPool))
+	{
+		return SpatialFeature;
+	}
+
+	UDynamicMesh* Mesh = MeshPool->RequestMesh();
+	Mesh->Reset();
+
+	// Outer rings only, the mesh is for display and holes would need a proper triangulation
+	for (int32 PolygonIndex = 0; PolygonIndex < Feature.GetNumPolygons(); ++PolygonIndex)
+	{
+		int32 FirstRing, LastRing;
+		Feature.GetPolygonRings(PolygonIndex, FirstRing, LastRing);
+
+		if (FirstRing == LastRing)
 		{
-			if (Property.Value->Type == EJson::String)
-			{
-				Properties.Add(Property.Key, Property.Value->AsString());
-			} else if (Property.Value->Type == EJson::Number)
-			{
-				Properties.Add(Property.Key, FString::SanitizeFloat(Property.Value->AsNumber()));
-			} else if (Property.Value->Type == EJson::Boolean)
-			{
-				Properties.Add(Property.Key, Property.Value->AsBool() ? TEXT("true") : TEXT("false"));
-			}
+			continue;
 		}
 
-		Features.Emplace(FSpatialFeature {
-			MoveTemp(Mesh),
-			MoveTemp(BVH),
-			Properties,
-			PropertiesJsonObject->HasField("type") ? PropertiesJsonObject->GetIntegerField("type") : 0,
-			Id
-		});
-		Id ++;
+		const TArrayView<const FVector2D> OuterRing = Feature.GetRing(FirstRing);
+
+		UGeometryScriptLibrary_MeshPrimitiveFunctions::AppendSimpleExtrudePolygon(
+			Mesh,
+			FGeometryScriptPrimitiveOptions{},
+			FTransform(),
+			TArray<FVector2D>(OuterRing.GetData(), OuterRing.Num()),
+			400.0f
+		);
 	}
 
-	return Features;
+	UGeometryScriptLibrary_MeshSpatial::BuildBVHForMesh(Mesh, SpatialFeature.BVH);
+	SpatialFeature.Geometry = Mesh;
+
+	return SpatialFeature;
 }
 
 double USpatialLibrary::HaversineDistance(const FVector2D& PointA, const FVector2D& PointB, double Radius)
@@ -98,8 +114,8 @@ double USpatialLibrary::HaversineDistance(const FVector2D& PointA, const FVector
 	const FVector2D PointARadians = FMath::DegreesToRadians(PointA);
 	const FVector2D PointBRadians = FMath::DegreesToRadians(PointB);
 
-	const FVector2D Diff = PointB - PointA;
-	const double a = FMath::Pow(FMath::Sin(Diff.Y / 2.0), 2.0) + FMath::Cos(PointA.Y) * FMath::Cos(PointB.Y) * FMath::Pow(FMath::Sin(Diff.X/2.0), 2.0);
+	const FVector2D Diff = PointBRadians - PointARadians;
+	const double a = FMath::Pow(FMath::Sin(Diff.Y / 2.0), 2.0) + FMath::Cos(PointARadians.Y) * FMath::Cos(PointBRadians.Y) * FMath::Pow(FMath::Sin(Diff.X/2.0), 2.0);
 	const double c = 2.0 * FMath::Asin(FMath::Sqrt(a));
 
 	return c * Radius;
@@ -109,12 +125,15 @@ FVector2D USpatialLibrary::HaversineDeltaDegrees(const FVector2D& Origin, const
 {
 	// https://math.stackexchange.com/questions/474602/reverse-use-of-haversine-formula
 	const double DeltaLatitude = Distance / Radius;
-	const double DeltaLongitude = 2 * FMath::Asin(FMath::Sqrt(
-		(FMath::Pow(FMath::Sin((Distance / Radius) / 2.0), 2.0)) / FMath::Cos(FMath::DegreesToRadians(Origin.Y))
-	));
+	const double DeltaLongitude = 2 * FMath::Asin(FMath::Sqrt(FMath::Min(
+		FMath::Pow(FMath::Sin((Distance / Radius) / 2.0), 2.0) /
+		FMath::Square(FMath::Cos(FMath::DegreesToRadians(Origin.Y))),
+		1.0
+	)));
 
+	// Both are angles in radians until here
 	return FVector2D(
-	DeltaLongitude,
-	DeltaLatitude
+	FMath::RadiansToDegrees(DeltaLongitude),
+	FMath::RadiansToDegrees(DeltaLatitude)
 	);
 }
@@ -0,0 +1,498 @@
+// Copyright Aiden. S. All Rights Reserved
+
+
+#include "SpatialPolygon.h"
+
+#include "GenericFoliage.h"
+#include "GeoJSONReader.h"
+
+// Aim for this many edges per cell on average, empty cells are the cheap ones
+#define POLYGON_CELLS_PER_EDGE 2
+#define POLYGON_MAX_CELLS (512 * 512)
+
+/** Cells of the bounds beyond which scanline spans are refused, e.g. metre cells over bounds in degrees */
+#define SCANLINE_MAX_CELLS 67108864
+
+FSpatialPolygon::FSpatialPolygon(const FGeoJSONFeature& Feature)
+{
+	for (int32 RingIndex = 0; RingIndex < Feature.GetNumRings(); ++RingIndex)
+	{
+		AddRing(Feature.GetRing(RingIndex));
+	}
+
+	Build();
+}
+
+void FSpatialPolygon::AddRing(TArrayView<const FVector2D> Ring)
+{
+	if (Ring.Num() < 3)
+	{
+		return;
+	}
+
+	RingOffsets.Add(Vertices.Num());
+	Vertices.Append(Ring.GetData(), Ring.Num());
+
+	for (int32 i = 0; i < Ring.Num(); ++i)
+	{
+		const FVector2D& A = Ring[i];
+		const FVector2D& B = Ring[(i + 1) % Ring.Num()];
+
+		// The closing position repeats the first one, that edge has no length
+		if (A != B)
+		{
+			Edges.Add({A, B});
+		}
+
+		Bounds += A;
+	}
+}
+
+TArrayView<const FVector2D> FSpatialPolygon::GetRing(int32 RingIndex) const
+{
+	const int32 First = RingOffsets[RingIndex];
+	const int32 Last = RingIndex + 1 < RingOffsets.Num() ? RingOffsets[RingIndex + 1] : Vertices.Num();
+	return TArrayView<const FVector2D>(Vertices.GetData() + First, Last - First);
+}
+
+template <typename FuncType>
+void FSpatialPolygon::ForEachCell(const FEdge& Edge, const FVector2D& GridCellSize, int32 GridNumX, int32 GridNumY,
+                                  FuncType&& Func) const
+{
+	const FVector2D InvGridCellSize(1.0 / GridCellSize.X, 1.0 / GridCellSize.Y);
+	const double MinY = FMath::Min(Edge.A.Y, Edge.B.Y);
+	const double MaxY = FMath::Max(Edge.A.Y, Edge.B.Y);
+
+	const int32 FirstRow = FMath::Clamp(FMath::FloorToInt32((MinY - Bounds.Min.Y) * InvGridCellSize.Y), 0,
+	                                    GridNumY - 1);
+	const int32 LastRow = FMath::Clamp(FMath::FloorToInt32((MaxY - Bounds.Min.Y) * InvGridCellSize.Y), 0,
+	                                   GridNumY - 1);
+	const double DeltaY = Edge.B.Y - Edge.A.Y;
+
+	for (int32 Row = FirstRow; Row <= LastRow; ++Row)
+	{
+		// Part of the edge within this row
+		const double RowMinY = FMath::Max(MinY, Bounds.Min.Y + Row * GridCellSize.Y);
+		const double RowMaxY = FMath::Min(MaxY, Bounds.Min.Y + (Row + 1) * GridCellSize.Y);
+
+		double X0 = Edge.A.X;
+		double X1 = Edge.B.X;
+
+		if (DeltaY != 0.0)
+		{
+			X0 = Edge.A.X + (RowMinY - Edge.A.Y) * (Edge.B.X - Edge.A.X) / DeltaY;
+			X1 = Edge.A.X + (RowMaxY - Edge.A.Y) * (Edge.B.X - Edge.A.X) / DeltaY;
+		}
+
+		const int32 FirstColumn = FMath::Clamp(
+			FMath::FloorToInt32((FMath::Min(X0, X1) - Bounds.Min.X) * InvGridCellSize.X), 0, GridNumX - 1);
+		const int32 LastColumn = FMath::Clamp(
+			FMath::FloorToInt32((FMath::Max(X0, X1) - Bounds.Min.X) * InvGridCellSize.X), 0, GridNumX - 1);
+
+		for (int32 Column = FirstColumn; Column <= LastColumn; ++Column)
+		{
+			Func(Row, Column);
+		}
+	}
+}
+
+void FSpatialPolygon::Build()
+{
+	CellEdgeStart.Reset();
+	CellEdges.Reset();
+	CellCentreInside.Reset();
+	NumCellsX = NumCellsY = 0;
+
+	const FVector2D Size = Bounds.bIsValid ? Bounds.GetSize() : FVector2D::ZeroVector;
+
+	if (Edges.Num() < 3 || Size.X <= 0.0 || Size.Y <= 0.0)
+	{
+		Bounds = FBox2D(ForceInit);
+		return;
+	}
+
+	// Square-ish cells whatever the aspect of the bounds
+	const int32 TargetCells = FMath::Clamp(Edges.Num() * POLYGON_CELLS_PER_EDGE, 16, POLYGON_MAX_CELLS);
+	NumCellsX = FMath::Clamp(FMath::CeilToInt32(FMath::Sqrt(TargetCells * Size.X / Size.Y)), 1, TargetCells);
+	NumCellsY = FMath::Clamp(FMath::CeilToInt32(static_cast<float>(TargetCells) / NumCellsX), 1, TargetCells);
+
+	CellSize = FVector2D(Size.X / NumCellsX, Size.Y / NumCellsY);
+	InvCellSize = FVector2D(1.0 / CellSize.X, 1.0 / CellSize.Y);
+
+	const int32 NumCells = NumCellsX * NumCellsY;
+
+	// Counting pass then filling pass, so the buckets live in one flat array
+	CellEdgeStart.SetNumZeroed(NumCells + 1);
+
+	for (const FEdge& Edge : Edges)
+	{
+		ForEachCell(Edge, CellSize, NumCellsX, NumCellsY, [this](int32 Row, int32 Column)
+		{
+			++CellEdgeStart[Row * NumCellsX + Column + 1];
+		});
+	}
+
+	for (int32 i = 0; i < NumCells; ++i)
+	{
+		CellEdgeStart[i + 1] += CellEdgeStart[i];
+	}
+
+	CellEdges.SetNumUninitialized(CellEdgeStart[NumCells]);
+	TArray<int32> Cursor(CellEdgeStart.GetData(), NumCells);
+
+	for (int32 EdgeIndex = 0; EdgeIndex < Edges.Num(); ++EdgeIndex)
+	{
+		ForEachCell(Edges[EdgeIndex], CellSize, NumCellsX, NumCellsY, [this, &Cursor, EdgeIndex](int32 Row, int32 Column)
+		{
+			CellEdges[Cursor[Row * NumCellsX + Column]++] = EdgeIndex;
+		});
+	}
+
+	ClassifyCellCentres();
+}
+
+void FSpatialPolygon::ClassifyCellCentres()
+{
+	CellCentreInside.Init(false, NumCellsX * NumCellsY);
+
+	TArray<int32> RowEdges;
+	TArray<double> Crossings;
+
+	for (int32 Row = 0; Row < NumCellsY; ++Row)
+	{
+		// Any edge crossing the row's centre line is bucketed in one of the row's cells
+		RowEdges.Reset();
+		for (int32 CellIndex = Row * NumCellsX; CellIndex < (Row + 1) * NumCellsX; ++CellIndex)
+		{
+			for (int32 i = CellEdgeStart[CellIndex]; i < CellEdgeStart[CellIndex + 1]; ++i)
+			{
+				RowEdges.Add(CellEdges[i]);
+			}
+		}
+
+		RowEdges.Sort();
+
+		const double CentreY = Bounds.Min.Y + (Row + 0.5) * CellSize.Y;
+		Crossings.Reset();
+
+		for (int32 i = 0; i < RowEdges.Num(); ++i)
+		{
+			if (i > 0 && RowEdges[i] == RowEdges[i - 1])
+			{
+				continue;
+			}
+
+			const FEdge& Edge = Edges[RowEdges[i]];
+			if ((Edge.A.Y > CentreY) != (Edge.B.Y > CentreY))
+			{
+				Crossings.Add(Edge.A.X + (CentreY - Edge.A.Y) * (Edge.B.X - Edge.A.X) / (Edge.B.Y - Edge.A.Y));
+			}
+		}
+
+		Crossings.Sort();
+
+		// Walk the centres left to right, every crossing passed flips the state
+		int32 NumPassed = 0;
+		for (int32 Column = 0; Column < NumCellsX; ++Column)
+		{
+			const double CentreX = Bounds.Min.X + (Column + 0.5) * CellSize.X;
+			while (NumPassed < Crossings.Num() && Crossings[NumPassed] < CentreX)
+			{
+				++NumPassed;
+			}
+
+			CellCentreInside[Row * NumCellsX + Column] = (NumPassed & 1) != 0;
+		}
+	}
+}
+
+int32 FSpatialPolygon::GetCellIndex(const FVector2D& Point) const
+{
+	const int32 Column = FMath::Clamp(FMath::FloorToInt32((Point.X - Bounds.Min.X) * InvCellSize.X), 0, NumCellsX - 1);
+	const int32 Row = FMath::Clamp(FMath::FloorToInt32((Point.Y - Bounds.Min.Y) * InvCellSize.Y), 0, NumCellsY - 1);
+	return Row * NumCellsX + Column;
+}
+
+FVector2D FSpatialPolygon::GetCellCentre(int32 CellIndex) const
+{
+	const int32 Row = CellIndex / NumCellsX;
+	const int32 Column = CellIndex - Row * NumCellsX;
+	return Bounds.Min + FVector2D(Column + 0.5, Row + 0.5) * CellSize;
+}
+
+bool FSpatialPolygon::ContainsInCell(const FVector2D& Point, int32 CellIndex) const
+{
+	bool bInside = CellCentreInside[CellIndex];
+
+	const int32 First = CellEdgeStart[CellIndex];
+	const int32 Last = CellEdgeStart[CellIndex + 1];
+
+	if (First == Last)
+	{
+		return bInside;
+	}
+
+	// The cell is convex, so the segment from its centre to the point only meets edges bucketed in it
+	const FVector2D Centre = GetCellCentre(CellIndex);
+	const FVector2D Segment = Point - Centre;
+
+	for (int32 i = First; i < Last; ++i)
+	{
+		const FEdge& Edge = Edges[CellEdges[i]];
+
+		// Half open on the segment's side so a vertex lying on it is only counted once
+		const bool bASide = FVector2D::CrossProduct(Segment, Edge.A - Centre) > 0.0;
+		const bool bBSide = FVector2D::CrossProduct(Segment, Edge.B - Centre) > 0.0;
+		if (bASide == bBSide)
+		{
+			continue;
+		}
+
+		const FVector2D EdgeDirection = Edge.B - Edge.A;
+		const bool bCentreSide = FVector2D::CrossProduct(EdgeDirection, Centre - Edge.A) > 0.0;
+		const bool bPointSide = FVector2D::CrossProduct(EdgeDirection, Point - Edge.A) > 0.0;
+		if (bCentreSide != bPointSide)
+		{
+			bInside = !bInside;
+		}
+	}
+
+	return bInside;
+}
+
+bool FSpatialPolygon::Contains(const FVector2D& Point) const
+{
+	if (NumCellsX == 0 || !Bounds.IsInsideOrOn(Point))
+	{
+		return false;
+	}
+
+	return ContainsInCell(Point, GetCellIndex(Point));
+}
+
+void FSpatialPolygon::ContainsBatch(TArrayView<const FVector2D> Points, TArray<bool>& OutInside) const
+{
+	OutInside.SetNumUninitialized(Points.Num());
+
+	if (NumCellsX == 0)
+	{
+		FMemory::Memzero(OutInside.GetData(), OutInside.Num() * sizeof(bool));
+		return;
+	}
+
+	// Straight line pass over the points first, most of them land in cells without edges and never reach the
+	// second loop
+	TArray<int32, TInlineAllocator<256>> Pending;
+
+	for (int32 i = 0; i < Points.Num(); ++i)
+	{
+		const FVector2D& Point = Points[i];
+
+		if (!Bounds.IsInsideOrOn(Point))
+		{
+			OutInside[i] = false;
+			continue;
+		}
+
+		const int32 CellIndex = GetCellIndex(Point);
+		if (CellEdgeStart[CellIndex] == CellEdgeStart[CellIndex + 1])
+		{
+			OutInside[i] = CellCentreInside[CellIndex];
+		}
+		else
+		{
+			Pending.Add(i);
+		}
+	}
+
+	for (const int32 i : Pending)
+	{
+		OutInside[i] = ContainsInCell(Points[i], GetCellIndex(Points[i]));
+	}
+}
+
+int32 FSpatialPolygon::RemoveOutside(TArray<FVector2D>& Points) const
+{
+	TArray<bool> Inside;
+	ContainsBatch(Points, Inside);
+
+	int32 NumKept = 0;
+	for (int32 i = 0; i < Points.Num(); ++i)
+	{
+		if (Inside[i])
+		{
+			Points[NumKept++] = Points[i];
+		}
+	}
+
+	const int32 NumRemoved = Points.Num() - NumKept;
+	Points.SetNum(NumKept, false);
+	return NumRemoved;
+}
+
+double FSpatialPolygon::GetDistanceToEdge(const FVector2D& Point, double MaxDistance) const
+{
+	if (IsEmpty() || MaxDistance <= 0.0)
+	{
+		return FMath::Max(MaxDistance, 0.0);
+	}
+
+	// Every edge within MaxDistance crosses one of these cells
+	const FVector2D Min = (Point - MaxDistance - Bounds.Min) * InvCellSize;
+	const FVector2D Max = (Point + MaxDistance - Bounds.Min) * InvCellSize;
+	const int32 FirstColumn = FMath::Clamp(FMath::FloorToInt32(Min.X), 0, NumCellsX - 1);
+	const int32 LastColumn = FMath::Clamp(FMath::FloorToInt32(Max.X), 0, NumCellsX - 1);
+	const int32 FirstRow = FMath::Clamp(FMath::FloorToInt32(Min.Y), 0, NumCellsY - 1);
+	const int32 LastRow = FMath::Clamp(FMath::FloorToInt32(Max.Y), 0, NumCellsY - 1);
+
+	double DistanceSquared = FMath::Square(MaxDistance);
+
+	for (int32 Row = FirstRow; Row <= LastRow; ++Row)
+	{
+		for (int32 Column = FirstColumn; Column <= LastColumn; ++Column)
+		{
+			const int32 CellIndex = Row * NumCellsX + Column;
+
+			// An edge crossing several cells is measured once per cell, which is cheaper than remembering it
+			for (int32 i = CellEdgeStart[CellIndex]; i < CellEdgeStart[CellIndex + 1]; ++i)
+			{
+				const FEdge& Edge = Edges[CellEdges[i]];
+				const FVector2D Direction = Edge.B - Edge.A;
+				const double LengthSquared = Direction.SizeSquared();
+				const double Alpha = LengthSquared > 0.0
+					                     ? FMath::Clamp(((Point - Edge.A) | Direction) / LengthSquared, 0.0, 1.0)
+					                     : 0.0;
+
+				DistanceSquared = FMath::Min(DistanceSquared,
+				                             FVector2D::DistSquared(Point, Edge.A + Direction * Alpha));
+			}
+		}
+	}
+
+	return FMath::Sqrt(DistanceSquared);
+}
+
+bool FSpatialPolygon::GetScanlineSpans(double InCellSize, TArray<FSpatialPolygonSpan>& OutSpans, int32& OutNumX,
+                                      int32& OutNumY) const
+{
+	OutSpans.Reset();
+	OutNumX = OutNumY = 0;
+
+	if (IsEmpty() || InCellSize <= 0.0)
+	{
+		return true;
+	}
+
+	// Checked in doubles before anything is allocated per row, the counts may not even fit an int32
+	const FVector2D Size = Bounds.GetSize();
+	const double NumX = FMath::Max(FMath::CeilToDouble(Size.X / InCellSize), 1.0);
+	const double NumY = FMath::Max(FMath::CeilToDouble(Size.Y / InCellSize), 1.0);
+
+	if (NumX * NumY > SCANLINE_MAX_CELLS)
+	{
+		UE_LOG(LogGenericFoliage, Error, TEXT("Scanline grid (%.0f %.0f) exceeds SCANLINE_MAX_CELLS!"), NumX, NumY);
+		return false;
+	}
+
+	OutNumX = static_cast<int32>(NumX);
+	OutNumY = static_cast<int32>(NumY);
+
+	const FVector2D GridCellSize(InCellSize, InCellSize);
+
+	// Per row, the columns an edge passes through and the edges themselves. Together that is proportional to the
+	// perimeter, not to the area of the bounds
+	TArray<TArray<int32>> RowColumns;
+	TArray<TArray<int32>> RowEdges;
+	RowColumns.SetNum(OutNumY);
+	RowEdges.SetNum(OutNumY);
+
+	for (int32 EdgeIndex = 0; EdgeIndex < Edges.Num(); ++EdgeIndex)
+	{
+		ForEachCell(Edges[EdgeIndex], GridCellSize, OutNumX, OutNumY, [&](int32 Row, int32 Column)
+		{
+			RowColumns[Row].Add(Column);
+			if (RowEdges[Row].Num() == 0 || RowEdges[Row].Last() != EdgeIndex)
+			{
+				RowEdges[Row].Add(EdgeIndex);
+			}
+		});
+	}
+
+	TArray<double> Crossings;
+
+	for (int32 Row = 0; Row < OutNumY; ++Row)
+	{
+		TArray<int32>& Columns = RowColumns[Row];
+		Columns.Sort();
+
+		// The cells an edge doesn't touch are wholly inside or outside, their centre tells which
+		const double CentreY = Bounds.Min.Y + (Row + 0.5) * InCellSize;
+		Crossings.Reset();
+
+		for (const int32 EdgeIndex : RowEdges[Row])
+		{
+			const FEdge& Edge = Edges[EdgeIndex];
+			if ((Edge.A.Y > CentreY) != (Edge.B.Y > CentreY))
+			{
+				Crossings.Add(Edge.A.X + (CentreY - Edge.A.Y) * (Edge.B.X - Edge.A.X) / (Edge.B.Y - Edge.A.Y));
+			}
+		}
+
+		Crossings.Sort();
+
+		// Sweep left to right, boundary runs split the inside intervals
+		int32 ColumnIndex = 0;
+		int32 Covered = 0;
+
+		const auto EmitBoundaryRun = [&]()
+		{
+			const int32 Begin = Columns[ColumnIndex];
+			int32 End = Begin + 1;
+
+			for (++ColumnIndex; ColumnIndex < Columns.Num() && Columns[ColumnIndex] <= End; ++ColumnIndex)
+			{
+				End = Columns[ColumnIndex] + 1;
+			}
+
+			OutSpans.Add({Row, Begin, End, true});
+			Covered = End;
+		};
+
+		for (int32 i = 0; i + 1 < Crossings.Num(); i += 2)
+		{
+			// Columns whose centre lies between the two crossings
+			const int32 Begin = FMath::Max(FMath::CeilToInt32((Crossings[i] - Bounds.Min.X) / InCellSize - 0.5), 0);
+			const int32 End = FMath::Min(
+				FMath::FloorToInt32((Crossings[i + 1] - Bounds.Min.X) / InCellSize - 0.5) + 1, OutNumX);
+
+			while (ColumnIndex < Columns.Num() && Columns[ColumnIndex] < Begin)
+			{
+				EmitBoundaryRun();
+			}
+
+			for (int32 Column = FMath::Max(Begin, Covered); Column < End; Column = Covered)
+			{
+				if (ColumnIndex < Columns.Num() && Columns[ColumnIndex] == Column)
+				{
+					EmitBoundaryRun();
+					continue;
+				}
+
+				const int32 Stop = ColumnIndex < Columns.Num() ? FMath::Min(Columns[ColumnIndex], End) : End;
+				OutSpans.Add({Row, Column, Stop, false});
+				Covered = Stop;
+			}
+		}
+
+		while (ColumnIndex < Columns.Num())
+		{
+			EmitBoundaryRun();
+		}
+	}
+
+	return true;
+}
+
+#undef POLYGON_CELLS_PER_EDGE
+#undef POLYGON_MAX_CELLS
+#undef SCANLINE_MAX_CELLS
@@ -0,0 +1,139 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#include "TerrainHeightCache.h"
+
+#define TERRAIN_CACHE_DEFAULT_MAX_TILES 256
+
+FTerrainHeightCache::FTerrainHeightCache()
+	: Tiles(TERRAIN_CACHE_DEFAULT_MAX_TILES)
+{
+}
+
+void FTerrainHeightCache::Reset(const FVector2D& InTileSize, int32 InResolution, int32 InMaxTiles)
+{
+	TileSize = FVector2D::Max(InTileSize.GetAbs(), FVector2D(UE_SMALL_NUMBER));
+	Resolution = FMath::Max(InResolution, 2);
+	Tiles.Empty(FMath::Max(InMaxTiles, 1));
+	++Generation;
+}
+
+void FTerrainHeightCache::Invalidate()
+{
+	Tiles.Empty(Tiles.Max());
+	++Generation;
+}
+
+void FTerrainHeightCache::Invalidate(const FBox2D& Bounds)
+{
+	const FIntPoint MinKey = GetTileKey(Bounds.Min);
+	const FIntPoint MaxKey = GetTileKey(Bounds.Max);
+	const int64 NumKeys = static_cast<int64>(MaxKey.X - MinKey.X + 1) * (MaxKey.Y - MinKey.Y + 1);
+
+	// Walking a range larger than the cache costs more than refilling it
+	if (NumKeys > Tiles.Max())
+	{
+		Invalidate();
+		return;
+	}
+
+	for (int32 Y = MinKey.Y; Y <= MaxKey.Y; ++Y)
+	{
+		for (int32 X = MinKey.X; X <= MaxKey.X; ++X)
+		{
+			Tiles.Remove(FIntPoint(X, Y));
+		}
+	}
+	++Generation;
+}
+
+FIntPoint FTerrainHeightCache::GetTileKey(const FVector2D& Point) const
+{
+	return FIntPoint(
+		FMath::FloorToInt32(Point.X / TileSize.X),
+		FMath::FloorToInt32(Point.Y / TileSize.Y)
+	);
+}
+
+void FTerrainHeightCache::GetTileSamplePoints(const FIntPoint& TileKey, TArray<FVector2D>& OutPoints) const
+{
+	const FVector2D Origin = FVector2D(TileKey) * TileSize;
+	const FVector2D Spacing = TileSize / (Resolution - 1);
+
+	OutPoints.Reserve(OutPoints.Num() + Resolution * Resolution);
+	for (int32 Y = 0; Y < Resolution; ++Y)
+	{
+		for (int32 X = 0; X < Resolution; ++X)
+		{
+			OutPoints.Add(Origin + FVector2D(X, Y) * Spacing);
+		}
+	}
+}
+
+void FTerrainHeightCache::AddTile(const FIntPoint& TileKey, TArrayView<const double> Heights,
+                                  TArrayView<const FVector> Normals, uint32 InGeneration)
+{
+	const int32 NumSamples = Resolution * Resolution;
+	if (InGeneration != Generation || Heights.Num() != NumSamples || Normals.Num() != NumSamples)
+	{
+		return;
+	}
+
+	const TSharedPtr<FTile> Tile = MakeShared<FTile>();
+	Tile->Heights.SetNumUninitialized(NumSamples);
+	Tile->Normals.SetNumUninitialized(NumSamples);
+
+	bool bAnyHit = false;
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		Tile->Heights[Index] = static_cast<float>(Heights[Index]);
+		Tile->Normals[Index] = FVector3f(Normals[Index]);
+		bAnyHit |= !Tile->Normals[Index].IsZero();
+	}
+
+	// Terrain that isn't there yet, e.g. a level still streaming in, is sampled again on the next query
+	if (bAnyHit)
+	{
+		Tiles.Add(TileKey, Tile);
+	}
+}
+
+bool FTerrainHeightCache::Sample(const FVector2D& Point, double& OutHeight, FVector& OutNormal)
+{
+	if (!IsInitialized())
+	{
+		return false;
+	}
+
+	const FIntPoint TileKey = GetTileKey(Point);
+	const TSharedPtr<const FTile>* Tile = Tiles.FindAndTouch(TileKey);
+	if (!Tile)
+	{
+		return false;
+	}
+
+	// Position in samples, the last row and column are shared with the next tile
+	const FVector2D Local = (Point / TileSize - FVector2D(TileKey)) * (Resolution - 1);
+	const int32 X = FMath::Clamp(FMath::FloorToInt32(Local.X), 0, Resolution - 2);
+	const int32 Y = FMath::Clamp(FMath::FloorToInt32(Local.Y), 0, Resolution - 2);
+	const float AlphaX = FMath::Clamp(static_cast<float>(Local.X - X), 0.f, 1.f);
+	const float AlphaY = FMath::Clamp(static_cast<float>(Local.Y - Y), 0.f, 1.f);
+
+	const int32 Index = Y * Resolution + X;
+	const TArray<float>& Heights = (*Tile)->Heights;
+	const TArray<FVector3f>& Normals = (*Tile)->Normals;
+
+	// Missed samples hold no height, the point is traced on its own instead
+	if (Normals[Index].IsZero() || Normals[Index + 1].IsZero() || Normals[Index + Resolution].IsZero() ||
+		Normals[Index + Resolution + 1].IsZero())
+	{
+		return false;
+	}
+
+	OutHeight = FMath::BiLerp(Heights[Index], Heights[Index + 1], Heights[Index + Resolution],
+	                          Heights[Index + Resolution + 1], AlphaX, AlphaY);
+	OutNormal = FVector(FMath::BiLerp(Normals[Index], Normals[Index + 1], Normals[Index + Resolution],
+	                                  Normals[Index + Resolution + 1], AlphaX, AlphaY).GetSafeNormal());
+	return true;
+}
+
+#undef TERRAIN_CACHE_DEFAULT_MAX_TILES
@@ -0,0 +1,220 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#include "VariablePoissonSampler.h"
+
+#include "GenericFoliage.h"
+#include "SpatialPolygon.h"
+
+/** Cells of every level together, beyond which sampling is refused rather than running out of memory */
+#define VARIABLE_POISSON_MAX_CELLS 67108864
+
+/** Octaves of radius, a wider spread shares the last level */
+#define VARIABLE_POISSON_MAX_LEVELS 16
+
+FVariablePoissonSampler::FVariablePoissonSampler(const FSpatialPolygon& InPolygon, double InMinRadius,
+                                                 double InMaxRadius, FRadiusFunction InRadiusAt,
+                                                 int32 InRejectionThreshold, int32 InSeed)
+	: Polygon(InPolygon), MinRadius(InMinRadius), MaxRadius(FMath::Max(InMinRadius, InMaxRadius)),
+	  RadiusAt(MoveTemp(InRadiusAt)), RejectionThreshold(InRejectionThreshold), RandomStream(InSeed)
+{
+	if (Polygon.IsEmpty() || MinRadius <= 0.0)
+	{
+		return;
+	}
+
+	Origin = Polygon.GetBounds().Min;
+	const FVector2D Size = Polygon.GetBounds().GetSize();
+
+	// Level L holds the points with radii in [MinRadius * 2^L, MinRadius * 2^(L + 1)), the last one up to MaxRadius
+	const int32 NumLevels = FMath::Clamp(1 + FMath::FloorToInt32(FMath::Log2(MaxRadius / MinRadius)), 1,
+	                                     VARIABLE_POISSON_MAX_LEVELS);
+	Levels.SetNum(NumLevels);
+
+	int64 NumCells = 0;
+
+	for (int32 LevelIndex = 0; LevelIndex < NumLevels; ++LevelIndex)
+	{
+		FLevel& Level = Levels[LevelIndex];
+		const double LevelMinRadius = MinRadius * FMath::Pow(2.0, LevelIndex);
+
+		// Points of a level are at least its smallest radius apart, so a cell holds one at most
+		Level.CellSize = LevelMinRadius / FMath::Sqrt(2.0);
+		Level.InvCellSize = 1.0 / Level.CellSize;
+		Level.MaxRadius = LevelIndex == NumLevels - 1 ? MaxRadius : FMath::Min(LevelMinRadius * 2.0, MaxRadius);
+		Level.NumX = FMath::Max(FMath::CeilToInt32(Size.X * Level.InvCellSize), 1);
+		Level.NumY = FMath::Max(FMath::CeilToInt32(Size.Y * Level.InvCellSize), 1);
+
+		NumCells += static_cast<int64>(Level.NumX) * Level.NumY;
+	}
+
+	if (NumCells > VARIABLE_POISSON_MAX_CELLS)
+	{
+		UE_LOG(LogGenericFoliage, Error, TEXT("Variable radius grids (%lld cells) exceed VARIABLE_POISSON_MAX_CELLS!"),
+		       NumCells);
+		Levels.Reset();
+		return;
+	}
+
+	for (FLevel& Level : Levels)
+	{
+		Level.Cells.SetNumZeroed(Level.NumX * Level.NumY);
+	}
+}
+
+bool FVariablePoissonSampler::TryAdd(const FVector2D& Candidate, TArray<int32>& ActivePoints)
+{
+	if (!Polygon.Contains(Candidate))
+	{
+		return false;
+	}
+
+	const double Radius = FMath::Clamp(RadiusAt ? RadiusAt(Candidate) : MinRadius, MinRadius, MaxRadius);
+	const FVector2D Local = Candidate - Origin;
+
+	// Points clash within the smaller of their radii, so each level is searched as far as the smaller of the
+	// candidate's radius and the level's largest
+	for (const FLevel& Level : Levels)
+	{
+		const double Reach = FMath::Min(Radius, Level.MaxRadius);
+		const int32 CellX = FMath::FloorToInt32(Local.X * Level.InvCellSize);
+		const int32 CellY = FMath::FloorToInt32(Local.Y * Level.InvCellSize);
+		const int32 ReachCells = FMath::CeilToInt32(Reach * Level.InvCellSize);
+
+		for (int32 y = FMath::Max(CellY - ReachCells, 0); y <= FMath::Min(CellY + ReachCells, Level.NumY - 1); ++y)
+		{
+			for (int32 x = FMath::Max(CellX - ReachCells, 0); x <= FMath::Min(CellX + ReachCells, Level.NumX - 1); ++x)
+			{
+				const int32 PointIndex = Level.Cells[y * Level.NumX + x] - 1;
+
+				if (PointIndex != -1 && FVector2D::DistSquared(Candidate, Points[PointIndex]) <
+					FMath::Square(FMath::Min(Radius, Radii[PointIndex])))
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	FLevel& Level = Levels[FMath::Clamp(FMath::FloorToInt32(FMath::Log2(Radius / MinRadius)), 0, Levels.Num() - 1)];
+	const int32 CellX = FMath::Clamp(FMath::FloorToInt32(Local.X * Level.InvCellSize), 0, Level.NumX - 1);
+	const int32 CellY = FMath::Clamp(FMath::FloorToInt32(Local.Y * Level.InvCellSize), 0, Level.NumY - 1);
+
+	Level.Cells[CellY * Level.NumX + CellX] = Points.Add(Candidate) + 1;
+	Radii.Add(Radius);
+	ActivePoints.Add(Points.Num() - 1);
+	return true;
+}
+
+void FVariablePoissonSampler::Sample()
+{
+	if (Levels.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<int32> ActivePoints;
+
+	// A dart per cell of the largest radius reaches every part of the polygon, each hit grows as far as it goes
+	TArray<FSpatialPolygonSpan> Spans;
+	int32 NumX = 0;
+	int32 NumY = 0;
+	if (!Polygon.GetScanlineSpans(MaxRadius, Spans, NumX, NumY))
+	{
+		return;
+	}
+
+	for (const FSpatialPolygonSpan& Span : Spans)
+	{
+		for (int32 x = Span.Begin; x < Span.End; ++x)
+		{
+			const FVector2D Seed = Origin + FVector2D(x + RandomStream.FRand(), Span.Row + RandomStream.FRand()) *
+				MaxRadius;
+
+			if (!TryAdd(Seed, ActivePoints))
+			{
+				continue;
+			}
+
+			while (ActivePoints.Num() > 0)
+			{
+				const int32 ActiveIndex = RandomStream.RandRange(0, ActivePoints.Num() - 1);
+				const FVector2D ActivePoint = Points[ActivePoints[ActiveIndex]];
+				const double Radius = Radii[ActivePoints[ActiveIndex]];
+
+				bool bAcceptedCandidate = false;
+
+				for (int32 i = 0; i < RejectionThreshold; ++i)
+				{
+					const double Angle = RandomStream.FRand() * PI * 2.0;
+					const double Length = RandomStream.FRandRange(Radius, Radius * 2.0);
+
+					if (TryAdd(ActivePoint + FVector2D(FMath::Sin(Angle), FMath::Cos(Angle)) * Length, ActivePoints))
+					{
+						bAcceptedCandidate = true;
+						break;
+					}
+				}
+
+				if (!bAcceptedCandidate)
+				{
+					ActivePoints.RemoveAtSwap(ActiveIndex);
+				}
+			}
+		}
+	}
+}
+
+double FVariablePoissonSampler::GetRadiusForDensity(double Density, double MinRadius, double MaxRadius)
+{
+	const double MinDensity = FMath::Square(MinRadius / FMath::Max(MaxRadius, MinRadius));
+	return MinRadius / FMath::Sqrt(FMath::Lerp(MinDensity, 1.0, FMath::Clamp(Density, 0.0, 1.0)));
+}
+
+FVariablePoissonSampler::FRadiusFunction FVariablePoissonSampler::MakeEdgeFalloff(
+	const FSpatialPolygon& Polygon, double MinRadius, double MaxRadius, double FalloffDistance)
+{
+	if (FalloffDistance <= 0.0)
+	{
+		return [MinRadius](const FVector2D&) { return MinRadius; };
+	}
+
+	return [&Polygon, MinRadius, MaxRadius, FalloffDistance](const FVector2D& Point)
+	{
+		const double Distance = Polygon.GetDistanceToEdge(Point, FalloffDistance);
+		return GetRadiusForDensity(Distance / FalloffDistance, MinRadius, MaxRadius);
+	};
+}
+
+FVariablePoissonSampler::FRadiusFunction FVariablePoissonSampler::MakeDensityRaster(
+	TArray<float> Densities, const FIntPoint& Size, const FBox2D& Bounds, double MinRadius, double MaxRadius)
+{
+	if (Size.X <= 0 || Size.Y <= 0 || Densities.Num() != Size.X * Size.Y || !Bounds.bIsValid)
+	{
+		return [MinRadius](const FVector2D&) { return MinRadius; };
+	}
+
+	const FVector2D Scale = FVector2D(Size) / Bounds.GetSize().ComponentMax(FVector2D(UE_SMALL_NUMBER));
+
+	return [Densities = MoveTemp(Densities), Size, Bounds, Scale, MinRadius, MaxRadius](const FVector2D& Point)
+	{
+		// Texel centres sit at half texels, the edges hold their outermost values
+		const FVector2D Texel = (Point - Bounds.Min) * Scale - 0.5;
+		const int32 X0 = FMath::Clamp(FMath::FloorToInt32(Texel.X), 0, Size.X - 1);
+		const int32 Y0 = FMath::Clamp(FMath::FloorToInt32(Texel.Y), 0, Size.Y - 1);
+		const int32 X1 = FMath::Min(X0 + 1, Size.X - 1);
+		const int32 Y1 = FMath::Min(Y0 + 1, Size.Y - 1);
+		const double AlphaX = FMath::Clamp(Texel.X - X0, 0.0, 1.0);
+		const double AlphaY = FMath::Clamp(Texel.Y - Y0, 0.0, 1.0);
+
+		const double Density = FMath::Lerp(
+			FMath::Lerp<double>(Densities[Y0 * Size.X + X0], Densities[Y0 * Size.X + X1], AlphaX),
+			FMath::Lerp<double>(Densities[Y1 * Size.X + X0], Densities[Y1 * Size.X + X1], AlphaX),
+			AlphaY
+		);
+
+		return GetRadiusForDensity(Density, MinRadius, MaxRadius);
+	};
+}
+
+#undef VARIABLE_POISSON_MAX_CELLS
+#undef VARIABLE_POISSON_MAX_LEVELS
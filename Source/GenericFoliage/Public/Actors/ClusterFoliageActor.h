@@ -3,15 +3,31 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "SpatialFeatureTree.h"
 #include "SpatialLibrary.h"
+#include "TerrainHeightCache.h"
 #include "Components/DynamicMeshComponent.h"
 #include "Foliage/GenericFoliageCollection.h"
 #include "GameFramework/Actor.h"
+
+#include <atomic>
+
 #include "ClusterFoliageActor.generated.h"
 
+class FFeatureCache;
 class UDynamicMeshPool;
 class UFoliageInstancedMeshPool;
 
+/** Terrain under a batch of geographic points, one entry per point in the order they were given */
+struct FClusterTerrainSamples
+{
+	/** Geographic altitude of the terrain */
+	TArray<double> Heights;
+
+	/** Zero where the trace missed the terrain, the height is 0 there */
+	TArray<FVector> Normals;
+};
+
 UCLASS()
 class GENERICFOLIAGE_API AClusterFoliageActor : public AActor
 {
@@ -24,8 +40,9 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
-	// virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void BeginDestroy() override;
+	virtual bool IsReadyForFinishDestroy() override;
 
 public:	
 	// Called every frame
@@ -35,15 +52,54 @@ public:
 	virtual FVector EngineToGeographicLocation(const FVector& EngineLocation);
 	virtual FVector GetUpVectorFromGeographicLocation(const FVector& GeographicLocation);
 	virtual FVector GetUpVectorFromEngineLocation(const FVector& EngineLocation);
+
+	/** Terrain height and normal under a single point, game thread */
 	virtual double GetTerrainBaseHeight(const FVector& GeographicLocation, FVector& OutNormal);
 
+	/**
+	 * Terrain under a batch of points, which is what spawning goes through. Called on the game thread, OnComplete
+	 * can be called straight away or on a later frame, also on the game thread. The points are only valid during
+	 * the call. By default the points are looked up in the terrain cache, tiles it is missing are filled with
+	 * async line traces.
+	 */
+	virtual void QueryTerrainHeights(TArrayView<const FVector2D> GeographicPoints,
+	                                 TFunction<void(FClusterTerrainSamples&& Samples)> OnComplete);
+
+	/** Drops every cached terrain tile, call when the terrain has changed */
+	UFUNCTION(BlueprintCallable)
+	void InvalidateTerrainCache();
+
+	/** Drops the cached terrain tiles overlapping the geographic bounds */
+	UFUNCTION(BlueprintCallable)
+	void InvalidateTerrainCacheInBounds(const FBox2D& GeographicBounds);
+
 	void SetupInstancedMeshPool();
 	FSpatialFeature GetFeatureById(int32 Id);
 	
 
+	/** Streams the features in on a foliage worker, each one starts spawning as soon as it has been read */
 	UFUNCTION(BlueprintCallable)
 	void LoadGeoJSON(const FString& Data);
-	
+
+	/** Like LoadGeoJSON, but the file is memory mapped and read in place */
+	UFUNCTION(BlueprintCallable)
+	void LoadGeoJSONFile(const FString& FilePath);
+
+	/**
+	 * Reads a new version of the loaded GeoJSON and only respawns what changed. Features are matched by content, new
+	 * or edited ones spawn as they are read and the ones missing from the new version are removed at the end
+	 */
+	UFUNCTION(BlueprintCallable)
+	void UpdateGeoJSON(const FString& Data);
+
+	/** Like UpdateGeoJSON, but the file is memory mapped and read in place */
+	UFUNCTION(BlueprintCallable)
+	void UpdateGeoJSONFile(const FString& FilePath);
+
+	/** True while a GeoJSON is being read */
+	UFUNCTION(BlueprintPure)
+	bool IsLoadingGeoJSON() const { return bIsLoadingGeoJSON; }
+
 public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 		FString JsonData;
@@ -51,7 +107,10 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 		bool bShowBoundary = false;
 
-	/** If enabled, then estimate the radius in metres for  the sampler. */
+	/**
+	 * If enabled, features are in longitude and latitude and foliage densities in metres. Each feature is sampled on
+	 * its local tangent plane, which stays within 1e-6 of the distances on the globe for features up to 10 km across
+	 */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 		bool bEstimationTransform = true;
 	
@@ -61,6 +120,53 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 		UGenericFoliageCollection* Collection = nullptr;
 
+	/** Game thread time per frame spent adding spawned instances to the HISMs, the rest carries over */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Performance", meta = (ClampMin=0.0))
+		float InstanceApplyBudgetMs = 2.f;
+
+	/** Fill features from precomputed Poisson corner tiles instead of sampling each one, much faster on large features */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Performance")
+		bool bUseTiledSampling = false;
+
+	/**
+	 * Sample every foliage type of a feature in one pass over a shared grid, keeping the types' clearances from
+	 * each other, rather than once per type. Ignored with tiled sampling, edge falloff types are sampled on their own
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Performance")
+		bool bSampleTypesJointly = false;
+
+	/** Only spawn the features near the camera and release their instances once it moves away. Set before loading */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Streaming")
+		bool bStreamFeatures = false;
+
+	/** Features this close to the camera are spawned, in metres with bEstimationTransform, otherwise in GeoJSON units */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Streaming", meta = (ClampMin=0.0, EditCondition="bStreamFeatures"))
+		double StreamingRadius = 5000.0;
+
+	/** How far past the radius (fraction of it) a feature must be before it is released, so edge features don't churn */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Streaming", meta = (ClampMin=0.0, EditCondition="bStreamFeatures"))
+		float StreamingHysteresis = 0.25f;
+
+	/** Sample the terrain into cached tiles rather than tracing every point. Levels streaming in or out clear it */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Terrain")
+		bool bCacheTerrain = true;
+
+	/** Distance between terrain samples, in metres with bEstimationTransform, otherwise in GeoJSON units */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Terrain", meta = (ClampMin=0.0, EditCondition="bCacheTerrain"))
+		double TerrainCacheSpacing = 4.0;
+
+	/** Samples along each side of a terrain tile */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Terrain", meta = (ClampMin=2, ClampMax=257, EditCondition="bCacheTerrain"))
+		int32 TerrainCacheResolution = 33;
+
+	/** Terrain tiles kept before the least recently used ones are dropped */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Terrain", meta = (ClampMin=1, EditCondition="bCacheTerrain"))
+		int32 TerrainCacheMaxTiles = 256;
+
+	/** Seconds between streaming updates */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Streaming", meta = (ClampMin=0.0, EditCondition="bStreamFeatures"))
+		float StreamingUpdateInterval = 0.25f;
+
 private:
 	UPROPERTY(Transient)
 	UDynamicMeshPool* MeshPool = nullptr;
@@ -68,14 +174,116 @@ private:
 	UPROPERTY(Transient)
 	TArray<FSpatialFeature> Features;
 
+	/** Boundary meshes by feature index */
 	UPROPERTY(Transient)
-	TArray<UDynamicMeshComponent*> MeshComponents;
+	TMap<int32, UDynamicMeshComponent*> MeshComponents;
 
 	UPROPERTY(Transient)
 	UFoliageInstancedMeshPool* InstancedMeshPool = nullptr;
 
-	TMap<int32, TSharedPtr<class FClusterFoliageSpawnerThread>> Threads;
+	/** Running spawner tasks by feature index */
+	TMap<int32, TSharedPtr<class FClusterFoliageSpawnerTask, ESPMode::ThreadSafe>> SpawnerTasks;
+
+	/** Cancelled tasks with jobs still on the pool, the actor isn't destroyed before they return */
+	TArray<TSharedPtr<class FClusterFoliageSpawnerTask, ESPMode::ThreadSafe>> RetiredTasks;
+
+	/** Bounds of the spawnable features, by index into Features */
+	FSpatialFeatureTree FeatureTree;
+
+	/** Features spawning or spawned while streaming */
+	TSet<int32> StreamedFeatures;
+	float StreamingUpdateTime = 0.f;
+
+	/** Incremented on every load, features still arriving from an older load are dropped */
+	int32 LoadId = 0;
+
+	/** Set when the load in progress is superseded, its reader stops at the next feature */
+	TSharedPtr<std::atomic<bool>, ESPMode::ThreadSafe> LoadCancelled;
+
+	/** Incremented whenever the features are cleared, feature indices from before refer to other features */
+	int32 FeatureListId = 0;
+
+	/** Indices of the current features by content hash, removed features leave an empty slot in Features */
+	TMultiMap<uint64, int32> FeaturesByHash;
+
+	/** Features found again by the update being read, by index */
+	TBitArray<> UpdatedFeatures;
+	bool bIsLoadingGeoJSON = false;
+
+	/**
+	 * Feature cache a streamed load was read from. Its features only have their bounds, id, hash and type until they
+	 * come into range, they are read from the cache and built then
+	 */
+	TSharedPtr<FFeatureCache, ESPMode::ThreadSafe> StreamingCache;
+
+	/** Features of the streaming cache that have been built or removed, by index */
+	TBitArray<> CachedFeaturesBuilt;
+
+	bool AnyJobsInFlight() const;
+
+	/** Stops spawning a feature, its results are dropped */
+	void CancelTask(int32 FeatureIndex);
+	void CancelAllTasks();
+
+	/** Forgets the retired tasks whose jobs have all returned */
+	void PruneRetiredTasks();
+
+	/** Stops reading the load in progress and drops its features still on the way */
+	void CancelLoad();
+
+	/** Removes the current features, their boundary meshes and resets the instanced meshes */
+	void ResetFeatures();
+
+	/**
+	 * Reads the features on a foliage worker and hands each one to the game thread as it is parsed, to AddFeature
+	 * or to UpdateFeature for an update
+	 */
+	void StreamFeatures(const TSharedRef<class FGeoJSONReader, ESPMode::ThreadSafe>& Reader, bool bUpdate);
+
+	/** Matches a feature of an update against the current ones, adding it if it is new, game thread */
+	void UpdateFeature(const struct FGeoJSONFeature& GeoJSONFeature);
+
+	/** Removes the features the update didn't find */
+	void FinishUpdate();
+
+	/** Stops spawning the features and removes their instances and boundary meshes */
+	void RemoveFeatures(const TSet<int32>& FeatureIndices);
+
+	/** Builds a streamed feature and starts spawning its foliage, game thread */
+	void AddFeature(const struct FGeoJSONFeature& GeoJSONFeature);
+
+	/** Puts a built feature in the tree and starts spawning it, or waits for the camera while streaming */
+	void RegisterFeature(int32 FeatureIndex);
+
+	/** Takes the features of a cache as placeholders, they are built by BuildCachedFeature once in range */
+	void SetStreamingCache(const TSharedRef<FFeatureCache, ESPMode::ThreadSafe>& Cache);
+
+	/** Reads a feature of the streaming cache and builds it in its placeholder's slot */
+	void BuildCachedFeature(int32 FeatureIndex);
+
+	/** Starts a spawner task for a feature, its instances are owned by the feature index */
+	void SpawnFeature(int32 FeatureIndex);
+
+	/** Spawns the features that came into range of the camera and releases the ones that left it */
+	void UpdateStreaming();
+
+	bool GetCameraLocation(FVector& OutLocation) const;
+
+	/** One async line trace per point, what the terrain cache is filled with */
+	void TraceTerrainHeights(TArrayView<const FVector2D> GeographicPoints,
+	                         TFunction<void(FClusterTerrainSamples&& Samples)> OnComplete);
+
+	/** Answers the points from the terrain cache, tracing the ones whose tile was evicted in the meantime */
+	void SampleTerrainCache(TArrayView<const FVector2D> GeographicPoints,
+	                        TFunction<void(FClusterTerrainSamples&& Samples)> OnComplete);
+
+	void OnLevelsChanged(ULevel* Level, UWorld* World);
+
+	FTerrainHeightCache TerrainCache;
+
+	/** TerrainCacheSpacing the cache's tiles were sized with */
+	double TerrainCacheLayoutSpacing = 0.0;
 
-	bool AnyThreadsRunning() const;
-	void KillAllThreads();
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
 };
@@ -5,12 +5,24 @@
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
 #include "LidarPointCloudComponent.h"
+
+#include <atomic>
+
 #include "FoliageCaptureComponent.generated.h"
 
+class FFoliagePipelineTicket;
+class FFoliageTaskQueue;
 class IProjectionInterface;
 class UDynamicMeshComponent;
+class UHierarchicalInstancedStaticMeshComponent;
 class ULidarPointCloudComponent;
 
+/** Generation of a tile's work, shared with in-flight work so it can tell when it has gone stale */
+struct FFoliageTileGeneration
+{
+	std::atomic<uint32> Value{0};
+};
+
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent), Transient)
 class GENERICFOLIAGE_API UFoliageCaptureComponent : public USceneComponent
 {
@@ -40,8 +52,8 @@ public:
 	/** Captures the scene */
 	void Capture();
 
-	/** Entry point to our foliage spawner */
-	void Compute();
+	/** Entry point to our foliage spawner. DensityScale multiplies each foliage type's density */
+	void Compute(float InDensityScale = 1.f);
 
 	/** Called at the end of the capture, sets any shared variables here to null */
 	void Finish();
@@ -52,6 +64,12 @@ public:
 	/** Is this component ready to be updated [foliage compute/capture]. False if an update is in progress */
 	bool IsReadyToUpdate() const;
 
+	/** Generation of this tile's work, bumped whenever queued or in-flight work becomes obsolete */
+	uint32 GetGeneration() const;
+
+	/** Marks all queued and in-flight work for this tile as stale, every pipeline stage drops it when it checks */
+	void InvalidateWork();
+
 	bool IsUsingSharedResources() const;
 
 	/** Sets the tile size in cm */
@@ -60,8 +78,20 @@ public:
 	ULidarPointCloudComponent* ResolvePointCloudComponent();
 	
 public:
+	/** Slot of this component in the tile grid */
 	UPROPERTY(VisibleAnywhere, Category = "ProceduralFoliage")
 	FIntPoint TileID = FIntPoint::ZeroValue;
+
+	/** World anchored tile this slot currently covers */
+	UPROPERTY(VisibleAnywhere, Category = "ProceduralFoliage")
+	FIntPoint WorldTileID = FIntPoint::ZeroValue;
+
+	UPROPERTY(VisibleAnywhere, Category = "ProceduralFoliage")
+	bool bHasWorldTile = false;
+
+	/** Density multiplier the current world tile was (or is being) built with */
+	UPROPERTY(VisibleAnywhere, Category = "ProceduralFoliage")
+	float DensityScale = 0.f;
 	
 	UPROPERTY(VisibleAnywhere, Category = "ProceduralFoliage")
 	AActor* Projection;
@@ -97,7 +127,12 @@ public:
 	double DistanceAboveSurface = 2000.0;
 
 private:
-	void Compute_Internal(
+	/**
+	 * Pipeline stages after the readback. They run on workers (apply only queues game thread tasks) and must only
+	 * touch the context, as the component may be gone by now. Each stage submits the next one.
+	 */
+	static void Compute_Internal(
+		const TSharedRef<struct FFoliageTileWorkContext, ESPMode::ThreadSafe>& ContextRef,
 		const TArray<FLinearColor>& SceneColourData,
 		const TArray<FLinearColor>& SceneNormalData,
 		const TArray<float>& SceneDepthData,
@@ -105,10 +140,36 @@ private:
 		int32 Height
 	);
 
+	static void Build_Internal(
+		const TSharedRef<struct FFoliageTileWorkContext, ESPMode::ThreadSafe>& ContextRef,
+		TMap<FGuid, TArray<FTransform>>&& FoliageTransforms
+	);
+
+	static void Apply_Internal(
+		const struct FFoliageTileWorkContext& Context,
+		TMap<FGuid, TArray<FTransform>>&& FoliageTransforms,
+		const TSharedPtr<FFoliagePipelineTicket, ESPMode::ThreadSafe>& Ticket
+	);
+
+	/**
+	 * Queues the tile's release for its next update behind its apply tasks, unless the work generation is stale.
+	 * Every update that gets past the readback ends here, including the ones that fail on the way. The ticket, if
+	 * any, is held until then
+	 */
+	static void ReleaseTile(const struct FFoliageTileWorkContext& Context,
+	                        const TSharedPtr<FFoliagePipelineTicket, ESPMode::ThreadSafe>& Ticket = nullptr);
+
 	TMap<FGuid, TSharedPtr<struct FTiledFoliageBuilder>> CreateFoliageBuilders() const;
 
+	/** Finds the HISM for a foliage type in this tile's mesh pool, null if the work generation is stale. Game thread only */
+	static UHierarchicalInstancedStaticMeshComponent* GetTileHISM(
+		const TWeakObjectPtr<UFoliageCaptureComponent>& WeakComponent, uint32 Generation, const FGuid& Guid);
+
 	FName CreateComponentName(const FString& ComponentName) const;
 
+	/** Updates bReadyToUpdate and the owning actor's tile state */
+	void SetReadyToUpdate(bool bNewState);
+
 private:
 	UPROPERTY()
 	TArray<FLidarPointCloudPoint> Viz_Points;
@@ -118,6 +179,7 @@ private:
 	bool bReadyToUpdate = true;
 	UPROPERTY()
 	ULidarPointCloud* PointCloud;
-	
-	TMap<FGuid, TSharedPtr<struct FTiledFoliageBuilder>> Builders;
+
+	TSharedRef<FFoliageTileGeneration, ESPMode::ThreadSafe> GenerationState = MakeShared<
+		FFoliageTileGeneration, ESPMode::ThreadSafe>();
 };
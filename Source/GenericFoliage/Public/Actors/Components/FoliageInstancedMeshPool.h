@@ -33,8 +33,28 @@ public:
 	/** Toggles collision on this tile */
 	virtual void ToggleCollision(bool bNewEnableCollision);
 
+	/** True if there is a HISM for every foliage type in this tile */
+	bool HasAllFoliageTypes() const;
+
 	/** Returns the total instance count of this tile */
 	int32 GetTotalInstanceCount() const;
+
+	/** Adds instances of a foliage type on behalf of an owner, so they can be removed together later */
+	void AddOwnedInstances(const FGuid& FoliageTypeGuid, int32 Owner, const TArray<FTransform>& Transforms);
+
+	/** Removes every instance added or staged for the owners, one RemoveInstances call per foliage type */
+	void RemoveOwnedInstances(const TSet<int32>& Owners);
+
+	/** Queues instances to be added by a later FlushStagedInstances rather than straight away */
+	void StageOwnedInstances(const FGuid& FoliageTypeGuid, int32 Owner, TArray<FTransform>&& Transforms);
+
+	/**
+	 * Adds staged instances with at most one AddInstances call per foliage type, until the budget is spent. What
+	 * doesn't fit stays staged for the next flush. Returns the number of instances added
+	 */
+	int32 FlushStagedInstances(double BudgetSeconds);
+
+	int32 GetNumStagedInstances() const { return NumStagedInstances; }
 	
 public:
 	// Map that stores our ISMs. these are mapped against a GUID which comes from a foliage type 
@@ -48,4 +68,26 @@ public:
 	/** Foliage types in this tile */
 	UPROPERTY()
 	TArray<UGenericFoliageType*> FoliageTypes;
+
+private:
+	struct FStagedInstances
+	{
+		TArray<FTransform> Transforms;
+		TArray<int32> Owners;
+	};
+
+	void AddInstancesWithOwners(const FGuid& FoliageTypeGuid, const TArray<FTransform>& Transforms,
+	                            TArrayView<const int32> Owners);
+
+	/** Owner of each instance of a foliage type's HISM, in instance order */
+	TMap<FGuid, TArray<int32>> InstanceOwners;
+
+	TMap<FGuid, FStagedInstances> StagedInstances;
+	int32 NumStagedInstances = 0;
+
+	/** Foliage type the next flush starts at, so every type gets its turn when the budget is tight */
+	int32 NextStagedType = 0;
+
+	/** Smoothed cost of adding one instance, what a flush sizes its batches with */
+	double SecondsPerInstance = 1e-6;
 };
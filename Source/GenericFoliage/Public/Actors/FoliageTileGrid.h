@@ -0,0 +1,80 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FoliageTileGrid.generated.h"
+
+class UFoliageCaptureComponent;
+class UFoliageInstancedMeshPool;
+
+/** Everything belonging to one slot of the tile grid */
+USTRUCT()
+struct GENERICFOLIAGE_API FFoliageTile
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FIntPoint TileID = FIntPoint::ZeroValue;
+
+	UPROPERTY()
+	UFoliageCaptureComponent* CaptureComponent = nullptr;
+
+	UPROPERTY()
+	UFoliageInstancedMeshPool* MeshPool = nullptr;
+
+	/** An update is in progress, from Compute until its last apply task */
+	UPROPERTY()
+	bool bIsBuilding = false;
+
+	/** The mesh pool has a HISM for every foliage type */
+	UPROPERTY()
+	bool bHasAllMeshes = false;
+};
+
+/**
+ * Flat (2X+1) x (2Y+1) grid of tiles indexed by tile ID.
+ *
+ * Tile state is only changed through the setters so the grid can keep counts of building and incomplete tiles,
+ * answering whether the whole grid is ready in constant time regardless of the tile count or foliage types.
+ */
+USTRUCT()
+struct GENERICFOLIAGE_API FFoliageTileGrid
+{
+	GENERATED_BODY()
+
+	/** Allocates empty tiles for the extent, tile IDs range from -Extent to +Extent */
+	void Reset(const FIntPoint& InExtent);
+
+	/** Removes every tile */
+	void Empty();
+
+	FFoliageTile* Find(const FIntPoint& TileID);
+	const FFoliageTile* Find(const FIntPoint& TileID) const;
+
+	TArray<FFoliageTile>& GetTiles() { return Tiles; }
+	const TArray<FFoliageTile>& GetTiles() const { return Tiles; }
+
+	int32 Num() const { return Tiles.Num(); }
+
+	void SetIsBuilding(const FIntPoint& TileID, bool bIsBuilding);
+	void SetHasAllMeshes(const FIntPoint& TileID, bool bHasAllMeshes);
+
+	int32 GetNumBuilding() const { return NumBuilding; }
+
+	/** True if there are tiles and every mesh pool is complete */
+	bool HasAllMeshes() const { return Tiles.Num() > 0 && NumMissingMeshes == 0; }
+
+	/** True if there are tiles, none of them are building and every mesh pool is complete */
+	bool IsIdle() const { return Tiles.Num() > 0 && NumBuilding == 0 && NumMissingMeshes == 0; }
+
+private:
+	int32 GetIndex(const FIntPoint& TileID) const;
+
+	UPROPERTY()
+	TArray<FFoliageTile> Tiles;
+
+	FIntPoint Extent = FIntPoint::ZeroValue;
+	int32 NumBuilding = 0;
+	int32 NumMissingMeshes = 0;
+};
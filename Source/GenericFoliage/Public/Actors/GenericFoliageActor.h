@@ -3,6 +3,9 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Actors/FoliageTileGrid.h"
+#include "Async/FoliageTaskQueue.h"
+#include "Async/FoliageTilePipeline.h"
 #include "Components/FoliageInstancedMeshPool.h"
 #include "Foliage/GenericFoliageType.h"
 #include "GameFramework/Actor.h"
@@ -35,9 +38,15 @@ public:
 	virtual void Tick(float DeltaTime) override;
 
 private:
-	void GetCameraInfo(FVector& Location, FRotator& Rotation, bool& bSuccess) const;
+	void GetCameraInfo(FVector& Location, FRotator& Rotation, float& FOV, bool& bSuccess) const;
 
 	bool IsReadyToUpdate() const;
+
+	/** Mesh pools are complete and the capture stage of the pipeline has room for another tile */
+	bool CanCapture() const;
+
+	/** Pushes the stage limits to the pipeline */
+	void UpdatePipelineLimits();
 	
 	void SetupTextureTargets();
 
@@ -45,9 +54,47 @@ private:
 
 	void RebuildInstancedMeshPool( bool bImmediate = false );
 
+	/** Capture components of every tile, in grid order */
 	TArray<UFoliageCaptureComponent*> GetFoliageCaptureComponents() const;
 
+	/** Destroys the capture components and mesh pools of the current grid, and any left over from a previous one */
+	void DestroyTiles();
+
 	void UpdateNearestTileID(const FVector& InWorldLocation);
+
+	/** Drops all queued work and marks every tile's in-flight work as stale */
+	void CancelPendingWork();
+
+	/**
+	 * Moves the grid so it is centred on a world tile. Tiles are world anchored and wrap around the slots
+	 * toroidally, so only slots whose world tile left coverage (or that were built at a lower density) are
+	 * recaptured. Returns the number of tiles queued.
+	 */
+	int32 RecenterTileGrid(const FIntPoint& CenterTile, float DensityScale, bool bRebuildAll);
+
+	void PlaceCaptureComponent(UFoliageCaptureComponent* CaptureComponent, const FIntPoint& WorldTile) const;
+
+	/** Location in units of tiles, in the actor's local frame */
+	FVector2D WorldToTileCoordinates(const FVector& InWorldLocation) const;
+
+	FIntPoint GetWorldTileAt(const FVector& InWorldLocation) const;
+
+	FVector GetWorldTileCenter(const FIntPoint& WorldTile) const;
+
+	/** Slot (capture component TileID) that covers a world tile */
+	FIntPoint GetTileSlot(const FIntPoint& WorldTile) const;
+
+	void RecordCameraSample(const FVector& Location);
+
+	/** Extrapolates the camera position from its recent samples */
+	FVector PredictCameraLocation(double LookAheadTime) const;
+
+	/** Recomputes the priority of each tile from the view, queued capture and foliage work is reordered to match */
+	void UpdateTilePriorities(const FVector& ViewLocation, const FRotator& ViewRotation, float FOV);
+
+	/** Tiles in the view frustum come first, then by how much of the screen they cover and how close they are */
+	double CalculateTilePriority(const UFoliageCaptureComponent* CaptureComponent, const FVector& ViewLocation,
+	                             const FVector& ViewDirection, double HalfFOV) const;
 	
 	TArray<FIntPoint> GetBuildingTiles() const;
 
@@ -55,8 +102,25 @@ private:
 
 public:
 
+	/** Queues work to run on the game thread alongside the captures. Safe to call from any thread */
 	void EnqueueCaptureTickTask(TFunction<void()>&& InFunc);
+
+	/** Queues work to run on the game thread when applying foliage. Safe to call from any thread */
 	void EnqueueFoliageTickTask(TFunction<void()>&& InFunc);
+
+	/** Queues foliage work for a tile, it runs in order of the tile's priority. Safe to call from any thread */
+	void EnqueueFoliageTickTask(const FIntPoint& TileID, TFunction<void()>&& InFunc);
+
+	/** Queue the foliage apply work goes into, workers hold on to it so they never need the actor itself */
+	TSharedRef<FFoliageTaskQueue, ESPMode::ThreadSafe> GetFoliageTickQueue() const;
+
+	FFoliageTaskQueueStats GetCaptureQueueStats() const;
+	FFoliageTaskQueueStats GetFoliageQueueStats() const;
+
+	/** Pipeline the tile updates run through, workers hold on to it so they never need the actor itself */
+	TSharedRef<FFoliageTilePipeline, ESPMode::ThreadSafe> GetTilePipeline() const;
+
+	FFoliagePipelineStageStats GetPipelineStageStats(EFoliagePipelineStage Stage) const;
 	
 	/** Transforms */
 
@@ -76,6 +140,15 @@ public:
 
 	void SetIsReadyToUpdate(bool bNewState);
 
+	/** Mesh pool of a tile, null if the tile doesn't exist */
+	UFoliageInstancedMeshPool* GetTileMeshPool(const FIntPoint& TileID) const;
+
+	/** Called by the capture components when an update starts or finishes */
+	void SetTileIsBuilding(const FIntPoint& TileID, bool bIsBuilding);
+
+	/** World tile the grid is currently centred on */
+	FIntPoint GetGridCenter() const;
+
 	bool HasAnyFoliageTypes();
 
 public:
@@ -101,10 +174,30 @@ public:
 	UPROPERTY(EditAnywhere, Category = "ProceduralFoliage")
 	FIntPoint TileCount = FIntPoint(1, 1);
 
+	/** How far (fraction of a tile) the camera must move past the centre tile's edge before the grid recenters */
+	UPROPERTY(EditAnywhere, Category = "ProceduralFoliage", meta = (ClampMin=0.0, ClampMax=0.5))
+	float RecenterHysteresis = 0.1f;
+
 	/** Foliage will only regenerate if the camera velocity is below this threshold  */
 	UPROPERTY(EditAnywhere, Category = "ProceduralFoliage")
 	double VelocityUpdateThreshold = 12500;
 
+	/** While the camera is moving too fast to update, build reduced density tiles along its predicted path */
+	UPROPERTY(EditAnywhere, Category = "Prefetch")
+	bool bEnablePredictivePrefetch = false;
+
+	/** How far ahead (in seconds) to extrapolate the camera path */
+	UPROPERTY(EditAnywhere, Category = "Prefetch", meta = (ClampMin=0.0, EditCondition="bEnablePredictivePrefetch"))
+	double PrefetchLookAheadTime = 1.5;
+
+	/** Density multiplier for prefetched tiles, they are rebuilt at full density once the camera settles */
+	UPROPERTY(EditAnywhere, Category = "Prefetch", meta = (ClampMin=0.01, ClampMax=1.0, EditCondition="bEnablePredictivePrefetch"))
+	float PrefetchDensityScale = 0.25f;
+
+	/** Minimum time (in seconds) between prefetches */
+	UPROPERTY(EditAnywhere, Category = "Prefetch", meta = (ClampMin=0.0, EditCondition="bEnablePredictivePrefetch"))
+	double PrefetchInterval = 0.5;
+
 	/** Maximum foliage tasks that can be run per tick */
 	UPROPERTY(EditAnywhere, Category = "Async", meta = (UIMin=1))
 	int32 FoliageTasksPerTick = 1;
@@ -113,8 +206,25 @@ public:
 	UPROPERTY(EditAnywhere, Category = "Async", meta = (UIMin=1))
 	int32 CaptureTasksPerTick = 1;
 
+	/** Maximum tiles between capture and readback at once */
+	UPROPERTY(EditAnywhere, Category = "Async", meta = (ClampMin=1))
+	int32 MaxTilesCapturing = 1;
+
+	/** Maximum tiles being sampled on workers at once */
+	UPROPERTY(EditAnywhere, Category = "Async", meta = (ClampMin=1))
+	int32 MaxTilesComputing = 4;
+
+	/** Maximum tiles preparing their builders on workers at once */
+	UPROPERTY(EditAnywhere, Category = "Async", meta = (ClampMin=1))
+	int32 MaxTilesBuilding = 4;
+
+	/** Maximum tiles with instances queued for the game thread at once */
+	UPROPERTY(EditAnywhere, Category = "Async", meta = (ClampMin=1))
+	int32 MaxTilesApplying = 2;
+
+	/** Capture component, mesh pool and state of each tile */
 	UPROPERTY(Transient)
-	TMap<FIntPoint, UFoliageInstancedMeshPool*> TileInstancedMeshPools;
+	FFoliageTileGrid TileGrid;
 
 	/** ID of the tile nearest to the camera */
 	UPROPERTY(Transient)
@@ -145,11 +255,31 @@ private:
 	FIntPoint LastNearestTileID;
 	FVector LastCameraPosition = FVector::ZeroVector;
 
+	struct FCameraSample
+	{
+		FVector Location;
+		double Time;
+	};
+
+	TArray<FCameraSample> CameraSamples;
+
+	/** World tile the grid is centred on */
+	FIntPoint GridCenter = FIntPoint::ZeroValue;
+	bool bHasGridCenter = false;
+	double LastPrefetchTime = 0.0;
+
 	bool bReadyToUpdate = false;
 	bool bForceUpdate = false;
+
+	/** Tiles were last built by a prefetch and need rebuilding at full density */
+	bool bRefinePending = false;
 private:
 	bool bUsingSharedResources = true;
-	TArray<TFunction<void()>> CaptureTickQueue;
-	TArray<TFunction<void()>> FoliageTickQueue;
+	TSharedRef<FFoliageTaskQueue, ESPMode::ThreadSafe> CaptureTickQueue = MakeShared<
+		FFoliageTaskQueue, ESPMode::ThreadSafe>(1024);
+	TSharedRef<FFoliageTaskQueue, ESPMode::ThreadSafe> FoliageTickQueue = MakeShared<
+		FFoliageTaskQueue, ESPMode::ThreadSafe>(8192);
+	TSharedRef<FFoliageTilePipeline, ESPMode::ThreadSafe> TilePipeline = MakeShared<
+		FFoliageTilePipeline, ESPMode::ThreadSafe>();
 #pragma endregion 
 };
@@ -0,0 +1,123 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Containers/RingBuffer.h"
+
+#include <atomic>
+
+/** Snapshot of a task queue's depth and latency */
+struct GENERICFOLIAGE_API FFoliageTaskQueueStats
+{
+	/** Tasks waiting to be executed, including overflow */
+	int32 Depth = 0;
+
+	/** Tasks which didn't fit in the ring and were spilled into the overflow queue */
+	int32 OverflowDepth = 0;
+
+	/** Smoothed time between a task being enqueued and executed (seconds) */
+	double AverageLatency = 0.0;
+
+	/** Worst latency seen since the queue was created or emptied (seconds) */
+	double MaxLatency = 0.0;
+
+	/** Total number of tasks executed */
+	uint64 NumExecuted = 0;
+};
+
+/**
+ * Bounded multi-producer, single-consumer task queue.
+ *
+ * Any thread may enqueue, only the owning thread (the game thread for the foliage actors) may dequeue.
+ * Tasks live in a power of two ring of slots, each slot carries a sequence number so producers can claim it
+ * without taking a lock, and popping is O(1). If the ring fills up, tasks spill into an unbounded overflow queue
+ * so nothing is dropped, the ring is always drained before the overflow to keep each producer's tasks in order.
+ *
+ * Tasks may be tagged with a tile. On the consumer side up to a ring's worth of them are staged per tile and
+ * executed in order of the tile priorities, which can be changed at any time to reorder work that is already
+ * staged. The rest wait in the ring until there is room. Untagged tasks always run first, and tasks of the same
+ * tile always run in the order they were enqueued.
+ */
+class GENERICFOLIAGE_API FFoliageTaskQueue
+{
+public:
+	explicit FFoliageTaskQueue(uint32 InCapacity = 4096);
+
+	FFoliageTaskQueue(const FFoliageTaskQueue&) = delete;
+	FFoliageTaskQueue& operator=(const FFoliageTaskQueue&) = delete;
+
+	/** Enqueues a task, safe to call from any thread */
+	void Enqueue(TFunction<void()>&& InTask);
+
+	/** Enqueues a task belonging to a tile, safe to call from any thread */
+	void Enqueue(const FIntPoint& TileID, TFunction<void()>&& InTask);
+
+	/** Runs up to MaxTasks tasks, highest priority tile first. Returns how many were run. Consumer thread only */
+	int32 Execute(int32 MaxTasks);
+
+	/** Replaces the tile priorities, higher runs first. Tiles missing from the map have the lowest priority. Consumer thread only */
+	void SetTilePriorities(TMap<FIntPoint, double>&& InTilePriorities);
+
+	/** Discards every pending task. Consumer thread only */
+	void Empty();
+
+	/** Approximate number of pending tasks */
+	int32 Num() const;
+
+	bool IsEmpty() const;
+
+	FFoliageTaskQueueStats GetStats() const;
+
+private:
+	struct FTask
+	{
+		TFunction<void()> Function;
+		double EnqueueTime = 0.0;
+		FIntPoint TileID = FIntPoint::ZeroValue;
+		bool bHasTile = false;
+	};
+
+	struct FSlot
+	{
+		std::atomic<uint64> Sequence{0};
+		FTask Task;
+	};
+
+	void Enqueue(FTask&& InTask);
+	bool TryEnqueueRing(FTask& InTask);
+	bool TryDequeueRing(FTask& OutTask);
+
+	/** Moves tasks produced so far into the staging lists, until a ring's worth are staged */
+	void Stage();
+	bool PopStaged(FTask& OutTask);
+	void RecordLatency(double EnqueueTime);
+
+	TUniquePtr<FSlot[]> Slots;
+	uint64 Capacity;
+	uint64 Mask;
+
+	std::atomic<uint64> EnqueuePos{0};
+	std::atomic<uint64> DequeuePos{0};
+
+	TQueue<FTask, EQueueMode::Mpsc> Overflow;
+	std::atomic<int64> OverflowNum{0};
+
+	/** Consumer owned staging */
+	TRingBuffer<FTask> StagedUntiled;
+	TMap<FIntPoint, TRingBuffer<FTask>> StagedTiles;
+	TMap<FIntPoint, double> TilePriorities;
+
+	/** Tile the staged tasks are popped from until it runs out, or a tile or priority change calls for a rescan */
+	FIntPoint BestTileID = FIntPoint::ZeroValue;
+	bool bHasBestTile = false;
+
+	/** Written by the consumer, read by Num from any thread */
+	std::atomic<int32> NumStaged{0};
+
+	/** Consumer owned stats */
+	double AverageLatency = 0.0;
+	double MaxLatency = 0.0;
+	uint64 NumExecuted = 0;
+};
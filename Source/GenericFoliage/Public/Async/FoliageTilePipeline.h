@@ -0,0 +1,135 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/RingBuffer.h"
+
+/** Stages a tile passes through, in order */
+enum class EFoliagePipelineStage : uint8
+{
+	/** Scene captures, game thread */
+	Capture,
+	/** GPU readback of the render targets, render thread */
+	Readback,
+	/** Sampling the captures into foliage transforms, foliage worker pool */
+	Compute,
+	/** Preparing the per HISM builders, foliage worker pool */
+	Build,
+	/** Adding instances to the HISMs through the foliage queue, game thread */
+	Apply,
+	Num
+};
+
+/** Snapshot of one stage's load and timing */
+struct GENERICFOLIAGE_API FFoliagePipelineStageStats
+{
+	/** Tiles currently in the stage */
+	int32 InFlight = 0;
+
+	/** Tiles waiting for a free slot in the stage */
+	int32 Pending = 0;
+
+	/** Maximum tiles in the stage at once, 0 is unbounded */
+	int32 Limit = 0;
+
+	/** Tiles which have left the stage */
+	uint64 NumCompleted = 0;
+
+	/** Smoothed time a tile spends in the stage (seconds) */
+	double AverageTime = 0.0;
+
+	/** Longest time a tile has spent in the stage (seconds) */
+	double MaxTime = 0.0;
+};
+
+class FFoliageTilePipeline;
+
+/** Holds a slot in a pipeline stage, the slot is released and timed when the last reference goes away */
+class GENERICFOLIAGE_API FFoliagePipelineTicket
+{
+public:
+	FFoliagePipelineTicket(const TSharedRef<FFoliageTilePipeline, ESPMode::ThreadSafe>& InPipeline,
+	                       EFoliagePipelineStage InStage);
+	~FFoliagePipelineTicket();
+
+	FFoliagePipelineTicket(const FFoliagePipelineTicket&) = delete;
+	FFoliagePipelineTicket& operator=(const FFoliagePipelineTicket&) = delete;
+
+	EFoliagePipelineStage GetStage() const { return Stage; }
+
+private:
+	TSharedRef<FFoliageTilePipeline, ESPMode::ThreadSafe> Pipeline;
+	EFoliagePipelineStage Stage;
+	double StartTime;
+};
+
+using FFoliagePipelineTicketPtr = TSharedPtr<FFoliagePipelineTicket, ESPMode::ThreadSafe>;
+
+/**
+ * Tile update pipeline: capture -> readback -> compute -> build -> apply.
+ *
+ * Every stage has a bounded number of tiles in flight. Work submitted to a full stage waits in that stage's
+ * pending list and is dispatched as soon as a tile leaves it, so tiles overlap across stages without unbounded
+ * concurrency. Compute and build run on the foliage worker pool, apply is dispatched inline (the job only queues
+ * game thread work). Capture and readback are driven by their own threads through TryAcquire/Acquire.
+ *
+ * A job receives the ticket for its slot. The slot stays taken until every copy of the ticket is gone, so an apply
+ * job can hand it to the queued game thread tasks and the stage is only left when the last one has run (or been
+ * discarded).
+ */
+class GENERICFOLIAGE_API FFoliageTilePipeline : public TSharedFromThis<FFoliageTilePipeline, ESPMode::ThreadSafe>
+{
+public:
+	FFoliageTilePipeline();
+
+	FFoliageTilePipeline(const FFoliageTilePipeline&) = delete;
+	FFoliageTilePipeline& operator=(const FFoliageTilePipeline&) = delete;
+
+	/** Sets the maximum tiles in a stage at once, 0 is unbounded. Pending work is dispatched if the limit grew */
+	void SetStageLimit(EFoliagePipelineStage Stage, int32 InLimit);
+
+	/** True if a tile could enter the stage right now */
+	bool HasCapacity(EFoliagePipelineStage Stage) const;
+
+	/** Takes a slot in the stage if one is free, null otherwise. For stages driven by a fixed thread */
+	FFoliagePipelineTicketPtr TryAcquire(EFoliagePipelineStage Stage);
+
+	/** Takes a slot regardless of the limit. For stages whose concurrency is already fixed by the thread they run on */
+	FFoliagePipelineTicketPtr Acquire(EFoliagePipelineStage Stage);
+
+	/** Queues a job for a worker stage (compute, build or apply), it runs once the stage has a free slot */
+	void Submit(EFoliagePipelineStage Stage, TFunction<void(FFoliagePipelineTicketPtr)>&& Job);
+
+	FFoliagePipelineStageStats GetStats(EFoliagePipelineStage Stage) const;
+
+	static const TCHAR* GetStageName(EFoliagePipelineStage Stage);
+
+private:
+	friend class FFoliagePipelineTicket;
+
+	struct FStage
+	{
+		mutable FCriticalSection Lock;
+		TRingBuffer<TFunction<void(FFoliagePipelineTicketPtr)>> Pending;
+		int32 InFlight = 0;
+		int32 Limit = 0;
+		uint64 NumCompleted = 0;
+		double AverageTime = 0.0;
+		double MaxTime = 0.0;
+	};
+
+	/** Called by a ticket when it is destroyed */
+	void Release(EFoliagePipelineStage Stage, double StartTime);
+
+	/** Dispatches pending jobs while the stage has free slots */
+	void Pump(EFoliagePipelineStage Stage);
+
+	void Dispatch(EFoliagePipelineStage Stage, TFunction<void(FFoliagePipelineTicketPtr)>&& Job,
+	              FFoliagePipelineTicketPtr&& Ticket);
+
+	FStage& GetStage(EFoliagePipelineStage Stage) { return Stages[static_cast<int32>(Stage)]; }
+	const FStage& GetStage(EFoliagePipelineStage Stage) const { return Stages[static_cast<int32>(Stage)]; }
+
+	FStage Stages[static_cast<int32>(EFoliagePipelineStage::Num)];
+};
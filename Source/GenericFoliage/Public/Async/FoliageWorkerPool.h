@@ -0,0 +1,102 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/RingBuffer.h"
+#include "HAL/Runnable.h"
+
+#include <atomic>
+
+class FEvent;
+class FRunnableThread;
+
+/** How the worker pool is set up, read from UGenericFoliageSettings when the pool starts */
+struct GENERICFOLIAGE_API FFoliageWorkerPoolConfig
+{
+	int32 NumWorkers = 1;
+	EThreadPriority Priority = TPri_BelowNormal;
+	uint32 StackSize = 512 * 1024;
+
+	/** Pins worker i to core FirstCore + i */
+	bool bPinToCores = false;
+	int32 FirstCore = 0;
+
+	/** Builds the config from the project settings */
+	static FFoliageWorkerPoolConfig FromSettings();
+};
+
+/**
+ * Fixed set of worker threads shared by every foliage spawner.
+ *
+ * Each worker owns a job deque. Jobs submitted from a worker go to its own deque and are popped newest first,
+ * which keeps a chain of dependent jobs on warm caches. Jobs submitted from any other thread are spread over the
+ * workers round robin. An idle worker steals the oldest job from the other deques before going to sleep.
+ */
+class GENERICFOLIAGE_API FFoliageWorkerPool
+{
+public:
+	/** The shared pool, started on first use. Once shut down it stays stopped and runs every job inline */
+	static FFoliageWorkerPool& Get();
+
+	/** Stops the shared pool, called when the module shuts down. Pending jobs are run before it returns */
+	static void Shutdown();
+
+	/** A config without workers makes a stopped pool, which runs every job inline on the submitting thread */
+	explicit FFoliageWorkerPool(const FFoliageWorkerPoolConfig& InConfig);
+	~FFoliageWorkerPool();
+
+	FFoliageWorkerPool(const FFoliageWorkerPool&) = delete;
+	FFoliageWorkerPool& operator=(const FFoliageWorkerPool&) = delete;
+
+	/** Queues a job, safe to call from any thread. A stopped pool runs it straight away instead */
+	void Submit(TFunction<void()>&& Job);
+
+	int32 GetNumWorkers() const;
+
+	/** Approximate number of jobs waiting to run */
+	int32 GetNumPending() const;
+
+	/** True if the calling thread is one of this pool's workers */
+	bool IsWorkerThread() const;
+
+private:
+	struct FWorkerQueue
+	{
+		FCriticalSection Lock;
+		TRingBuffer<TFunction<void()>> Jobs;
+	};
+
+	class FWorker : public FRunnable
+	{
+	public:
+		FWorker(FFoliageWorkerPool& InPool, int32 InIndex);
+		virtual ~FWorker() override;
+
+		virtual uint32 Run() override;
+
+		FFoliageWorkerPool& Pool;
+		int32 Index;
+		FEvent* WakeEvent = nullptr;
+		std::atomic<bool> bSleeping{false};
+	};
+
+	bool PopOwn(int32 WorkerIndex, TFunction<void()>& OutJob);
+	bool Steal(int32 WorkerIndex, TFunction<void()>& OutJob);
+
+	/** Wakes the worker owning the queue, or any sleeping worker if that one is busy */
+	void Wake(int32 QueueIndex);
+
+	/** Runs the pending jobs and joins the workers, jobs submitted from then on run inline */
+	void Stop();
+
+	FFoliageWorkerPoolConfig Config;
+
+	TArray<TUniquePtr<FWorkerQueue>> Queues;
+	TArray<TUniquePtr<FWorker>> Workers;
+	TArray<FRunnableThread*> Threads;
+
+	std::atomic<int32> NumPending{0};
+	std::atomic<uint32> NextQueue{0};
+	std::atomic<bool> bStopping{false};
+};
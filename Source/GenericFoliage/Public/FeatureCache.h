@@ -0,0 +1,198 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GeoJSONReader.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * On disk layout of the feature cache. Every section starts 8 byte aligned and is an array of one of these
+ * records, so the mapped file is used as is. Little endian, like every platform the plugin runs on.
+ */
+enum class EFeatureCacheSection : uint8
+{
+	Features,
+	Rings,
+	Points,
+	Properties,
+	Strings,
+	IndexCells,
+	IndexEntries,
+	Num
+};
+
+struct FFeatureCacheSection
+{
+	uint64 Offset = 0;
+	uint64 Count = 0;
+};
+
+struct FFeatureCacheHeader
+{
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	uint64 SourceHash = 0;
+	uint64 FileSize = 0;
+	FFeatureCacheSection Sections[static_cast<int32>(EFeatureCacheSection::Num)];
+
+	/** Uniform grid over every feature's bounds, cell i lists IndexEntries[IndexCells[i] .. IndexCells[i + 1]) */
+	double IndexMinX = 0.0;
+	double IndexMinY = 0.0;
+	double IndexCellSizeX = 1.0;
+	double IndexCellSizeY = 1.0;
+	int32 IndexNumX = 0;
+	int32 IndexNumY = 0;
+};
+
+struct FFeatureCacheFeature
+{
+	/** FGeoJSONFeature::GetContentHash of the parsed feature */
+	uint64 Hash = 0;
+	double MinX = 0.0;
+	double MinY = 0.0;
+	double MaxX = 0.0;
+	double MaxY = 0.0;
+	int32 Id = 0;
+	int32 Type = 0;
+	uint32 FirstRing = 0;
+	uint32 NumRings = 0;
+	uint32 FirstProperty = 0;
+	uint32 NumProperties = 0;
+	uint8 GeometryType = 0;
+	uint8 Padding[7] = {};
+};
+
+enum class EFeatureCacheRingFlags : uint32
+{
+	None = 0,
+	/** First ring of a polygon */
+	Outer = 1 << 0
+};
+
+ENUM_CLASS_FLAGS(EFeatureCacheRingFlags)
+
+struct FFeatureCacheRing
+{
+	uint32 FirstPoint = 0;
+	uint32 NumPoints = 0;
+	EFeatureCacheRingFlags Flags = EFeatureCacheRingFlags::None;
+	uint32 Padding = 0;
+};
+
+enum class EFeatureCachePropertyType : uint8
+{
+	String,
+	Number,
+	Bool
+};
+
+struct FFeatureCacheProperty
+{
+	/** UTF-8 in the strings section */
+	uint32 KeyOffset = 0;
+	uint32 KeyLength = 0;
+	uint32 ValueOffset = 0;
+	uint32 ValueLength = 0;
+
+	/** Parsed value for numbers and bools (0 or 1) */
+	double Number = 0.0;
+	EFeatureCachePropertyType ValueType = EFeatureCachePropertyType::String;
+	uint8 Padding[7] = {};
+};
+
+/** Collects features as they are parsed and writes them out as a feature cache */
+class GENERICFOLIAGE_API FFeatureCacheWriter
+{
+public:
+	void Add(const FGeoJSONFeature& Feature);
+
+	int32 Num() const { return Features.Num(); }
+
+	/** Builds the spatial index and writes the cache, through a temporary file so a reader never sees half of it */
+	bool Save(const FString& Path, uint64 SourceHash) const;
+
+private:
+	uint32 AddString(const FString& String, uint32& OutLength);
+
+	TArray<FFeatureCacheFeature> Features;
+	TArray<FFeatureCacheRing> Rings;
+	TArray<FVector2D> Points;
+	TArray<FFeatureCacheProperty> Properties;
+	TArray<uint8> Strings;
+};
+
+/**
+ * Preprocessed features, memory mapped and read in place.
+ *
+ * The cache is keyed by a hash of the GeoJSON it was built from. Opening it only validates the header and the
+ * record ranges, rings are handed out as views into the mapping.
+ */
+class GENERICFOLIAGE_API FFeatureCache
+{
+public:
+	FFeatureCache();
+	~FFeatureCache();
+
+	FFeatureCache(const FFeatureCache&) = delete;
+	FFeatureCache& operator=(const FFeatureCache&) = delete;
+
+	/** Hash of the GeoJSON source, what a cache is keyed by */
+	static uint64 HashSource(TArrayView<const uint8> Source);
+
+	/** Where the cache for a source lives, under the project's saved directory */
+	static FString GetCachePath(uint64 SourceHash);
+
+	/** Maps the cache, false if it is missing, from another version or doesn't match the source */
+	bool Open(const FString& Path, uint64 SourceHash);
+	void Close();
+
+	bool IsOpen() const { return Header != nullptr; }
+	int32 Num() const;
+
+	int32 GetId(int32 FeatureIndex) const;
+
+	/** Content hash of the feature as it was parsed, to match features without reading their geometry */
+	uint64 GetHash(int32 FeatureIndex) const;
+
+	int32 GetType(int32 FeatureIndex) const;
+	EGeoJSONGeometryType GetGeometryType(int32 FeatureIndex) const;
+	FBox2D GetBounds(int32 FeatureIndex) const;
+
+	int32 GetNumRings(int32 FeatureIndex) const;
+	TArrayView<const FVector2D> GetRing(int32 FeatureIndex, int32 RingIndex) const;
+	bool IsOuterRing(int32 FeatureIndex, int32 RingIndex) const;
+
+	int32 GetNumProperties(int32 FeatureIndex) const;
+	const FFeatureCacheProperty& GetProperty(int32 FeatureIndex, int32 PropertyIndex) const;
+	FString GetString(uint32 Offset, uint32 Length) const;
+
+	/** Fills a reader feature from the cache, Feature keeps its allocations */
+	void GetFeature(int32 FeatureIndex, FGeoJSONFeature& OutFeature) const;
+
+	/** Same contract as FGeoJSONReader::ReadFeatures */
+	bool ReadFeatures(TFunctionRef<bool(FGeoJSONFeature& Feature)> OnFeature) const;
+
+	/** Indices of the features whose bounds intersect the box */
+	void QueryBounds(const FBox2D& Box, TArray<int32>& OutFeatureIndices) const;
+
+private:
+	bool Validate(int64 MappedSize);
+
+	template <typename RecordType>
+	TArrayView<const RecordType> GetSection(EFeatureCacheSection Section) const;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	const FFeatureCacheHeader* Header = nullptr;
+	TArrayView<const FFeatureCacheFeature> Features;
+	TArrayView<const FFeatureCacheRing> Rings;
+	TArrayView<const FVector2D> Points;
+	TArrayView<const FFeatureCacheProperty> Properties;
+	TArrayView<const uint8> Strings;
+	TArrayView<const uint32> IndexCells;
+	TArrayView<const uint32> IndexEntries;
+};
@@ -127,6 +127,29 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = General)
 	float Density = 1.f;
 
+	/**
+	 * Numeric feature property scaling the points per area of clusters, e.g. a canopy cover of 0.5 spawns half as
+	 * many. Features without it spawn at full density, a value of 0 or less spawns none. Empty to ignore properties
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = General)
+	FString DensityProperty;
+
+	/** Distance in metres over which clusters thin out towards their edges, 0 to spawn evenly up to the edge */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = General, meta = (ClampMin = 0))
+	float EdgeFalloffDistance = 0.f;
+
+	/** Points per area at the very edge of a cluster, relative to its inside */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = General,
+		meta = (ClampMin = 0.01, ClampMax = 1, EditCondition="EdgeFalloffDistance > 0"))
+	float EdgeDensity = 0.25f;
+
+	/**
+	 * Distance in metres the instances of other foliage types keep from this one's when a cluster samples its types
+	 * jointly, e.g. to keep bushes out from under trees. A pair of types keeps the larger of their two clearances
+	 */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = General, meta = (ClampMin = 0))
+	float Clearance = 0.f;
+
 	/** Whether a random local offset should be applied */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = General)
 	bool bRandomLocalOffset = false;
@@ -188,6 +211,11 @@ public:
 	UFUNCTION()
 	FVector GetRandomLocalOffset() const;
 
+	/** Draw from the given stream rather than the asset's own, which every caller shares */
+	FVector GetRandomScale(const FRandomStream& Stream) const;
+	FRotator GetRandomRotator(const FRandomStream& Stream) const;
+	FVector GetRandomLocalOffset(const FRandomStream& Stream) const;
+
 	UFUNCTION(CallInEditor)
 	void ResetGUID();
 
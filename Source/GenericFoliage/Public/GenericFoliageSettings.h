@@ -0,0 +1,53 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DeveloperSettings.h"
+#include "GenericFoliageSettings.generated.h"
+
+UENUM()
+enum class EFoliageWorkerPriority : uint8
+{
+	Lowest,
+	BelowNormal,
+	Normal
+};
+
+/** Project wide settings for the foliage spawners, found under Project Settings > Plugins > Generic Foliage */
+UCLASS(Config = Game, DefaultConfig, meta = (DisplayName = "Generic Foliage"))
+class GENERICFOLIAGE_API UGenericFoliageSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+
+public:
+	UGenericFoliageSettings();
+
+	virtual FName GetCategoryName() const override;
+
+	/** Number of foliage worker threads, 0 uses every core except the ones kept free for the game and render threads */
+	UPROPERTY(Config, EditAnywhere, Category = "Workers", meta = (ClampMin = 0, ConfigRestartRequired = true))
+	int32 NumWorkers = 0;
+
+	/** Cores left for the game and render threads when NumWorkers is 0 */
+	UPROPERTY(Config, EditAnywhere, Category = "Workers", meta = (ClampMin = 0, ConfigRestartRequired = true))
+	int32 NumReservedCores = 2;
+
+	UPROPERTY(Config, EditAnywhere, Category = "Workers", meta = (ConfigRestartRequired = true))
+	EFoliageWorkerPriority WorkerPriority = EFoliageWorkerPriority::BelowNormal;
+
+	/** Stack size of each worker (KB) */
+	UPROPERTY(Config, EditAnywhere, Category = "Workers", meta = (ClampMin = 64, ConfigRestartRequired = true))
+	int32 WorkerStackSizeKB = 512;
+
+	/** Pins each worker to its own core, starting after the reserved cores */
+	UPROPERTY(Config, EditAnywhere, Category = "Workers", meta = (ConfigRestartRequired = true))
+	bool bPinWorkersToCores = false;
+
+	/**
+	 * Keeps a preprocessed binary copy of every GeoJSON loaded by the cluster actors under
+	 * Saved/GenericFoliage/FeatureCache. Loading the same data again maps that copy instead of parsing the JSON.
+	 */
+	UPROPERTY(Config, EditAnywhere, Category = "GeoJSON")
+	bool bCacheFeatures = true;
+};
@@ -0,0 +1,138 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+enum class EGeoJSONGeometryType : uint8
+{
+	None,
+	Point,
+	MultiPoint,
+	LineString,
+	MultiLineString,
+	Polygon,
+	MultiPolygon,
+	GeometryCollection,
+	Unknown
+};
+
+/** A feature as read from the GeoJSON, positions are flattened with offsets marking where each ring/polygon starts */
+struct GENERICFOLIAGE_API FGeoJSONFeature
+{
+	EGeoJSONGeometryType GeometryType = EGeoJSONGeometryType::None;
+
+	/** Every position of the geometry in file order (longitude, latitude) */
+	TArray<FVector2D> Coordinates;
+
+	/** Index into Coordinates where each ring (or line string) starts */
+	TArray<int32> RingOffsets;
+
+	/** Index into RingOffsets where each polygon starts, the first ring of a polygon is its outer ring */
+	TArray<int32> PolygonOffsets;
+
+	/** String, number and boolean properties, as strings */
+	TMap<FString, FString> Properties;
+
+	/** Position of the feature in the collection */
+	int32 Id = 0;
+
+	int32 GetNumRings() const { return RingOffsets.Num(); }
+	int32 GetNumPolygons() const { return PolygonOffsets.Num(); }
+
+	/** Positions of a ring */
+	TArrayView<const FVector2D> GetRing(int32 RingIndex) const;
+
+	/** Rings of a polygon as [first, last) indices into RingOffsets */
+	void GetPolygonRings(int32 PolygonIndex, int32& OutFirstRing, int32& OutLastRing) const;
+
+	/** Clears the feature but keeps the allocations, so the reader can refill it without reallocating */
+	void Reset();
+
+	/** Hash of the geometry and properties, the same feature in another version of a document hashes the same */
+	uint64 GetContentHash() const;
+};
+
+/**
+ * Streaming GeoJSON FeatureCollection reader.
+ *
+ * Tokenizes UTF-8 directly from a memory mapped file (or a buffer) without building a DOM, and hands over each
+ * feature as soon as its closing brace has been read. The feature passed to the callback is reused for the next
+ * one, so its coordinate arrays keep their capacity unless the callback moves them out.
+ */
+class GENERICFOLIAGE_API FGeoJSONReader
+{
+public:
+	FGeoJSONReader();
+	~FGeoJSONReader();
+
+	FGeoJSONReader(const FGeoJSONReader&) = delete;
+	FGeoJSONReader& operator=(const FGeoJSONReader&) = delete;
+
+	/** Memory maps a file, falls back to loading it if mapping isn't supported. False if the file can't be read */
+	bool OpenFile(const FString& FilePath);
+
+	/** Reads from a string, it's converted to UTF-8 once up front */
+	void OpenString(const FString& InGeoJSON);
+
+	/** Reads from a UTF-8 buffer, it must outlive the reader */
+	void OpenBuffer(TArrayView<const uint8> InBuffer);
+
+	/**
+	 * Parses the collection, calling OnFeature for each feature as it is read. Returning false from OnFeature stops
+	 * the read. Returns false on a malformed document, see GetError.
+	 */
+	bool ReadFeatures(TFunctionRef<bool(FGeoJSONFeature& Feature)> OnFeature);
+
+	const FString& GetError() const { return Error; }
+
+	/** The whole input, e.g. to hash it */
+	TArrayView<const uint8> GetBuffer() const { return TArrayView<const uint8>(Begin, static_cast<int32>(End - Begin)); }
+
+	/** Total bytes of input and how far the reader has got */
+	int64 GetTotalSize() const { return End - Begin; }
+	int64 GetPosition() const { return Cur - Begin; }
+
+private:
+	void Close();
+
+	/** Calls OnMember for each member with its key in the scratch buffer, OnMember must consume the value */
+	bool ParseObject(TFunctionRef<bool()> OnMember);
+
+	bool ParseFeatureCollection(TFunctionRef<bool(FGeoJSONFeature& Feature)> OnFeature, bool& bOutStopped);
+	bool ParseFeature(FGeoJSONFeature& Feature);
+	bool ParseGeometry(FGeoJSONFeature& Feature);
+	bool ParseCoordinates(FGeoJSONFeature& Feature);
+	bool ParseProperties(FGeoJSONFeature& Feature);
+
+	/** Skips any value, objects and arrays included */
+	bool SkipValue();
+
+	/** Reads a string into the scratch buffer (UTF-8, escapes resolved) */
+	bool ParseString();
+	bool ParseNumber(double& OutValue);
+	bool MatchLiteral(const ANSICHAR* Literal);
+
+	/** Skips whitespace, returns the next character without consuming it (0 at the end) */
+	uint8 Peek();
+	bool Expect(uint8 Character);
+
+	bool ScratchEquals(const ANSICHAR* Literal) const;
+	FString ScratchToString() const;
+
+	bool Fail(const TCHAR* Message);
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	TArray<uint8> OwnedBuffer;
+
+	const uint8* Begin = nullptr;
+	const uint8* Cur = nullptr;
+	const uint8* End = nullptr;
+
+	TArray<ANSICHAR> Scratch;
+	FString Error;
+};
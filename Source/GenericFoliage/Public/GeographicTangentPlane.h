@@ -0,0 +1,46 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSpatialPolygon;
+
+/**
+ * Local east-north plane touching a sphere at a geographic origin, so geographic features can be worked on in metres
+ * with plain planar distances.
+ *
+ * Points are projected orthographically onto the plane. Distances are exact at the origin and shrink by up to a
+ * factor of cos(d / R) at a distance d from it, so planar distances never exceed the distances on the sphere and a
+ * minimum spacing in the plane holds on the sphere too. GetMaxDistanceError gives the relative error for points
+ * within some distance of the origin: about 1e-8 for 1 km, 1e-6 for 10 km, 1e-4 for 100 km and 1% at 1000 km.
+ */
+class GENERICFOLIAGE_API FGeographicTangentPlane
+{
+public:
+	/** Origin in degrees of longitude and latitude, Radius of the sphere in metres */
+	explicit FGeographicTangentPlane(const FVector2D& InOrigin, double InRadius = 6371e3);
+
+	/** Metres east and north of the origin */
+	FVector2D ToLocal(const FVector2D& Geographic) const;
+
+	/** Degrees of longitude and latitude, longitudes stay within 180 degrees of the origin's */
+	FVector2D ToGeographic(const FVector2D& Local) const;
+
+	/** Builds the polygon's rings projected into the plane */
+	void ToLocal(const FSpatialPolygon& Polygon, FSpatialPolygon& OutPolygon) const;
+
+	/** Relative error of planar distances between points up to Extent metres from the origin */
+	double GetMaxDistanceError(double Extent) const;
+
+	const FVector2D& GetOrigin() const { return Origin; }
+
+private:
+	FVector2D Origin;
+	double Radius;
+
+	/** Unit vectors of the plane's axes and its normal, in a frame centred on the sphere */
+	FVector East;
+	FVector North;
+	FVector Up;
+};
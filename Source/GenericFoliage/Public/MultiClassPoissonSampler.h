@@ -0,0 +1,71 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#include <atomic>
+
+class FSpatialPolygon;
+
+/**
+ * Poisson disc sampling of several classes of points at once within a polygon, e.g. every foliage type of a feature.
+ *
+ * Each class keeps its own radius between its points, and every pair of classes a distance of its own, 0 by default
+ * so classes only constrain themselves. All points share one grid and one active list: around each active point every
+ * class in turn, sparsest first, gets its tries before the point is retired, so the classes grow together and the
+ * sparse ones claim their room before the dense ones fill in around them. The polygon must outlive the sampler.
+ */
+class GENERICFOLIAGE_API FMultiClassPoissonSampler
+{
+public:
+	/** Classes with a radius of 0 or less get no points */
+	FMultiClassPoissonSampler(const FSpatialPolygon& InPolygon, TArray<double> InClassRadii,
+	                          int32 InRejectionThreshold = 30, int32 InSeed = 0);
+
+	/** Minimum distance between the points of two different classes, either way round. Set before sampling */
+	void SetClassDistance(int32 ClassA, int32 ClassB, double Distance);
+
+	/**
+	 * Samples every class, checking the flag every few hundred candidates. Returns false if it was raised, the
+	 * points sampled until then are kept
+	 */
+	bool Sample(const std::atomic<bool>* bCancelled = nullptr);
+
+	int32 GetNumClasses() const { return ClassRadii.Num(); }
+
+	/** Points of one class, in the polygon's coordinates */
+	TArray<FVector2D> GetPoints(int32 ClassIndex) const;
+
+private:
+	/** Adds the candidate to the class if it's inside and far enough from every point, false otherwise */
+	bool TryAdd(const FVector2D& Candidate, int32 ClassIndex, TArray<int32>& ActivePoints);
+
+	double GetDistance(int32 ClassA, int32 ClassB) const { return Distances[ClassA * ClassRadii.Num() + ClassB]; }
+
+	const FSpatialPolygon& Polygon;
+	TArray<double> ClassRadii;
+	int32 RejectionThreshold;
+	FRandomStream RandomStream;
+
+	/** Class by class minimum distances, the diagonal holds the class radii */
+	TArray<double> Distances;
+
+	/** Classes that get points, largest radius first */
+	TArray<int32> ClassOrder;
+
+	/** Grid cells away a candidate of each class looks for points */
+	TArray<int32> ClassReach;
+
+	FVector2D Origin = FVector2D::ZeroVector;
+	double InvCellSize = 1.0;
+	int32 NumX = 0;
+	int32 NumY = 0;
+
+	/** First point of each cell and the next one in the same cell for each point, INDEX_NONE ends a cell */
+	TArray<int32> CellHeads;
+	TArray<int32> NextInCell;
+
+	TArray<FVector2D> Points;
+	TArray<int32> PointClasses;
+};
@@ -0,0 +1,63 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FSpatialPolygonSpan;
+
+/**
+ * Poisson disc corner tiles: a small set of square tiles of points at least a unit apart that fill any rectangle
+ * when laid out on a grid, in time proportional to the points produced.
+ *
+ * Every corner of the grid gets one of a few colours from a hash of its position, and the tile placed in a cell is
+ * the one for the colours of its four corners. The points near a corner come from a patch shared by every tile
+ * around that corner, the points along an edge from a patch shared by the tiles with the same two corners on it,
+ * and each tile's interior is sampled against both. Neighbouring tiles therefore always agree along their edges and
+ * the minimum distance holds across them, while the random corner colours keep the pattern from repeating.
+ */
+class GENERICFOLIAGE_API FPoissonCornerTiles
+{
+public:
+	/** Samples the tiles, NumColours colours per corner (up to 4) make NumColours^4 tiles */
+	explicit FPoissonCornerTiles(int32 Seed = 0, int32 NumColours = 2);
+
+	/** Tiles shared by every caller, sampled on first use */
+	static const FPoissonCornerTiles& Get();
+
+	/**
+	 * Appends points covering [0, Size) at least a unit apart, scale them by the radius. Seed picks the corner
+	 * colours, so the same seed and size give the same points. False, with nothing added, when the region would take
+	 * more points than the tiles are allowed to produce
+	 */
+	bool Fill(const FVector2D& Size, int32 Seed, TArray<FVector2D>& OutPoints) const;
+
+	/**
+	 * Appends the tiles of the spans of a polygon's scanline grid with cells a tile wide, so only the tiles touching
+	 * the polygon are laid. The points of boundary spans go to OutBoundaryPoints when given, they still need testing
+	 * against the polygon. Same seed, same points as Fill where they overlap, and the same limit
+	 */
+	bool FillSpans(TArrayView<const FSpatialPolygonSpan> Spans, int32 Seed, TArray<FVector2D>& OutPoints,
+	               TArray<FVector2D>* OutBoundaryPoints = nullptr) const;
+
+	/** Width of a tile in radii */
+	static double GetTileSize();
+
+	int32 GetNumColours() const { return NumColours; }
+
+private:
+	const TArray<FVector2D>& GetTile(int32 Colour00, int32 Colour10, int32 Colour01, int32 Colour11) const;
+
+	int32 GetCornerColour(int32 X, int32 Y, int32 Seed) const;
+
+	/** False, with a log, when that many tiles could hold more points than allowed */
+	bool CanFill(int64 NumTiles) const;
+
+	int32 NumColours;
+
+	/** Points of the fullest tile */
+	int32 MaxTilePoints = 0;
+
+	/** Points of each tile in [0, TileSize)^2, by colour 00 + 10 * N + 01 * N^2 + 11 * N^3 of its corners */
+	TArray<TArray<FVector2D>> Tiles;
+};
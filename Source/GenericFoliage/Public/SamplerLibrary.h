@@ -6,15 +6,92 @@
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "SamplerLibrary.generated.h"
 
+class FSpatialPolygon;
+
 /**
  * 
  */
 
 struct FPoissonDiscSamplingSettings
 {
+	/**
+	 * Points are degrees of longitude and latitude and Radius is in metres. The library functions sample such regions
+	 * on their local tangent plane (see FGeographicTangentPlane) and ignore their own radius argument
+	 */
 	bool bUseGeographicCoordinates = false;
 	FVector2D Origin = FVector2D::ZeroVector;
+
+	/** Minimum distance in metres with geographic coordinates */
 	double Radius = 100.0;
+
+	/** Seeds the random stream, the same seed and inputs give the same points on any thread */
+	int32 Seed = 0;
+};
+
+/**
+ * Poisson disc sampling within a polygon, split into square blocks of the sampling grid so that a large polygon can
+ * be sampled by several jobs at once.
+ *
+ * Blocks are coloured in a 2x2 pattern and sampled one colour (phase) at a time. Blocks of one colour are a whole
+ * block apart, so they never touch each other's cells and can run concurrently. Each block checks its candidates
+ * against the points of neighbouring blocks from earlier phases, which keeps the minimum distance across block edges.
+ * The polygon must outlive the sampler.
+ */
+class GENERICFOLIAGE_API FPolygonPoissonSampler
+{
+public:
+	static constexpr int32 NumPhases = 4;
+
+	/**
+	 * Builds the grid, BlockCells is the block width in grid cells, 0 for a single block. Distances are planar in
+	 * the polygon's units, only the seed is taken from the settings: geographic polygons go through the library
+	 */
+	FPolygonPoissonSampler(const FSpatialPolygon& InPolygon, double InRadius, int32 InRejectionThreshold = 30,
+	                       FPoissonDiscSamplingSettings InSettings = FPoissonDiscSamplingSettings(),
+	                       int32 InBlockCells = 0);
+	~FPolygonPoissonSampler();
+
+	/** Cells of the grid, which is what sampling costs scale with */
+	int32 GetNumCells() const;
+
+	/** Blocks that overlap the polygon in a phase */
+	TArrayView<const int32> GetPhaseBlocks(int32 Phase) const { return PhaseBlocks[Phase]; }
+
+	/**
+	 * Samples a block. Blocks of a phase may run at the same time, but only once every earlier phase is done. Each
+	 * block draws from its own stream seeded from the settings and its index, so the order they run in doesn't matter
+	 */
+	void SampleBlock(int32 BlockIndex);
+
+	/** Samples every block on the calling thread */
+	void SampleAll();
+
+	/** Samples the blocks of each phase in parallel, blocking until all are done */
+	void SampleAllParallel();
+
+	/** Points of every block, in the polygon's coordinates */
+	TArray<FVector2D> GetPoints() const;
+
+private:
+	struct FSpanGrid;
+
+	const TArray<FVector2D>& GetBlockPoints(int32 CellX, int32 CellY) const;
+
+	const FSpatialPolygon& Polygon;
+	double Radius;
+	int32 RejectionThreshold;
+	FPoissonDiscSamplingSettings Settings;
+
+	double CellSize = 1.0;
+	double InvCellSize = 1.0;
+	FVector2D Origin = FVector2D::ZeroVector;
+	TUniquePtr<FSpanGrid> Grid;
+
+	int32 BlockCells = 0;
+	int32 NumBlocksX = 0;
+	int32 NumBlocksY = 0;
+	TArray<TArray<FVector2D>> BlockPoints;
+	TArray<int32> PhaseBlocks[NumPhases];
 };
 
 UCLASS()
@@ -32,10 +109,46 @@ public:
 		const FPoissonDiscSamplingSettings Settings = FPoissonDiscSamplingSettings()
 	);
 
+	/**
+	 * PoissonDiscSampling split into blocks of the grid sampled in parallel, one 2x2 colour of blocks at a time so
+	 * that the minimum distance holds across block edges. Blocks the calling thread until done, worth it from a few
+	 * thousand points. The points differ from PoissonDiscSampling's for the same seed.
+	 */
+	static TArray<FVector2D> ParallelPoissonDiscSampling(
+		const double Radius,
+		const FVector2D RegionSize,
+		const int32 RejectionThreshold = 30,
+		const FPoissonDiscSamplingSettings Settings = FPoissonDiscSamplingSettings()
+	);
+
+	/**
+	 * Fills the region from the shared Poisson corner tiles scaled to the radius, in time proportional to the points
+	 * rather than running the sampler. Distances are planar, Settings.bUseGeographicCoordinates and Origin are
+	 * ignored, Settings.Seed picks the tile layout.
+	 */
+	static TArray<FVector2D> TiledPoissonDiscSampling(
+		const double Radius,
+		const FVector2D RegionSize,
+		const FPoissonDiscSamplingSettings Settings = FPoissonDiscSamplingSettings()
+	);
+
+	/**
+	 * Poisson disc sampling within a polygon. Candidates are only generated and checked inside the polygon's
+	 * scanline spans and the grid only has cells for those spans, so the cost follows the polygon's area rather
+	 * than its bounding box. Points are in the polygon's coordinates, Settings.Origin is ignored.
+	 */
+	static TArray<FVector2D> PoissonDiscSamplingInPolygon(
+		const FSpatialPolygon& Polygon,
+		const double Radius,
+		const int32 RejectionThreshold = 30,
+		FPoissonDiscSamplingSettings Settings = FPoissonDiscSamplingSettings()
+	);
+
 	UFUNCTION(BlueprintCallable, meta=(DisplayName="PoissonDiscSampling2d"))
 	static TArray<FVector2D> K2_PoissonDiscSampling2d(
 		const double Radius,
 		const FVector2D RegionSize,
-		const int32 RejectionThreshold = 30
+		const int32 RejectionThreshold = 30,
+		const int32 Seed = 0
 	);
 };
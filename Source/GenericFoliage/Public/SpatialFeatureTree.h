@@ -0,0 +1,59 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * R-tree over feature bounds, for finding the features near a point without walking all of them.
+ *
+ * The tree is packed with sort-tile-recursive, which gives tight, barely overlapping nodes for a static set.
+ * Features inserted afterwards wait in a pending list that is scanned linearly, the tree is repacked once the
+ * list grows past a fraction of it, so streaming features in one at a time stays linear overall. Removed values
+ * are left in the tree as holes until the next repack.
+ */
+class GENERICFOLIAGE_API FSpatialFeatureTree
+{
+public:
+	/** Adds a value, it is found by every query its bounds intersect */
+	void Insert(int32 Value, const FBox2D& Bounds);
+
+	/** Removes a value, Bounds must be the ones it was inserted with */
+	bool Remove(int32 Value, const FBox2D& Bounds);
+
+	/** Removes every value */
+	void Reset();
+
+	/** Packs the pending values into the tree */
+	void Build();
+
+	/** Values whose bounds intersect the box, in no particular order */
+	void Query(const FBox2D& Box, TArray<int32>& OutValues) const;
+
+	int32 Num() const { return Entries.Num() - NumRemoved + Pending.Num(); }
+
+private:
+	struct FEntry
+	{
+		FBox2D Bounds;
+		int32 Value;
+	};
+
+	struct FNode
+	{
+		FBox2D Bounds;
+
+		/** Children are [First, First + Count) of the entries for leaves, of the nodes otherwise */
+		int32 First;
+		int32 Count;
+		bool bIsLeaf;
+	};
+
+	/** Entries in leaf order, leaf i holds entries [i * Fanout, (i + 1) * Fanout). Removed ones are INDEX_NONE */
+	TArray<FEntry> Entries;
+	TArray<FEntry> Pending;
+	int32 NumRemoved = 0;
+
+	/** One level after the other from the leaves up, the root is last */
+	TArray<FNode> Nodes;
+};
@@ -6,8 +6,12 @@
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "UDynamicMesh.h"
 #include "GeometryScript/GeometryScriptTypes.h"
+#include "SpatialPolygon.h"
 #include "SpatialLibrary.generated.h"
 
+class FGeoJSONReader;
+struct FGeoJSONFeature;
+
 /**
  * 
  */
@@ -17,8 +21,9 @@ struct GENERICFOLIAGE_API FSpatialFeature
 {
 	GENERATED_BODY()
 public:
+	/** Extruded mesh of the polygons, only built when a mesh pool is given (e.g. to show the boundary) */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
-		UDynamicMesh* Geometry;
+		UDynamicMesh* Geometry = nullptr;
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 		FGeometryScriptDynamicMeshBVH BVH;
@@ -31,6 +36,15 @@ public:
 
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 		int32 Id = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+		FBox2D Bounds = FBox2D(ForceInit);
+
+	/** Rings and containment index, what the spawners sample against. Shared as it is read from worker threads */
+	TSharedPtr<const FSpatialPolygon, ESPMode::ThreadSafe> Polygon;
+
+	/** Content hash of the GeoJSON feature, tells which features changed between two versions of a document */
+	uint64 Hash = 0;
 };
 
 UCLASS()
@@ -42,6 +56,19 @@ public:
 	UFUNCTION(BlueprintCallable)
 	static TArray<FSpatialFeature> ParseGeoJSON(const FString& InGeoJSON, UDynamicMeshPool* MeshPool);
 
+	/** Same as ParseGeoJSON but streams the file from disk instead of loading it into a string first */
+	UFUNCTION(BlueprintCallable)
+	static TArray<FSpatialFeature> ParseGeoJSONFile(const FString& FilePath, UDynamicMeshPool* MeshPool);
+
+	/** Reads every feature of an opened reader */
+	static TArray<FSpatialFeature> ReadFeatures(FGeoJSONReader& Reader, UDynamicMeshPool* MeshPool);
+
+	/**
+	 * Builds the polygon index for a feature as read by FGeoJSONReader. With a mesh pool the extruded mesh and BVH
+	 * are built too, that part is game thread only (the mesh pool isn't thread safe)
+	 */
+	static FSpatialFeature MakeSpatialFeature(const FGeoJSONFeature& Feature, UDynamicMeshPool* MeshPool = nullptr);
+
 	/** Calculates the great circle distance between two points on a planet, returns the result in metres.
 	 *
 	 * @param Radius : Radius of the planet in metres
@@ -50,7 +77,7 @@ public:
 		static double HaversineDistance(const FVector2D& PointA, const FVector2D& PointB, double Radius = 6371e3);
 
 	/**
-	 * Calculates the delta longitude and latitude needed to move a distance
+	 * Calculates the delta longitude and latitude, in degrees, needed to move a distance east or north of the origin
 	 */
 	UFUNCTION(BlueprintCallable, BlueprintPure)
 		static FVector2D HaversineDeltaDegrees(const FVector2D& Origin, const double& Distance, double Radius = 6371e3);
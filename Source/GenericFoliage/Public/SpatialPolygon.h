@@ -0,0 +1,104 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FGeoJSONFeature;
+
+/** A run of cells [Begin, End) in one row of a grid laid over a polygon */
+struct FSpatialPolygonSpan
+{
+	int32 Row = 0;
+	int32 Begin = 0;
+	int32 End = 0;
+
+	/** Cells crossed by an edge, they are only partly inside. The other spans are entirely inside */
+	bool bBoundary = false;
+};
+
+/**
+ * Planar polygon with holes (and several parts for multipolygons) and a containment index.
+ *
+ * Every ring takes part in an even-odd test, so holes and disjoint parts need no special casing. The bounds are
+ * split into a grid, each cell keeps the edges crossing it and whether its centre is inside. A point in a cell
+ * without edges is answered straight away, otherwise only the cell's edges are checked against the segment from
+ * the cell centre to the point.
+ */
+class GENERICFOLIAGE_API FSpatialPolygon
+{
+public:
+	FSpatialPolygon() = default;
+
+	/** Takes every ring of every polygon of the feature and builds the index */
+	explicit FSpatialPolygon(const FGeoJSONFeature& Feature);
+
+	/** Adds a ring, closing it if needed. Call Build once every ring is in */
+	void AddRing(TArrayView<const FVector2D> Ring);
+
+	/** Builds the containment grid */
+	void Build();
+
+	bool Contains(const FVector2D& Point) const;
+
+	/** Tests many points at once, OutInside gets one entry per point */
+	void ContainsBatch(TArrayView<const FVector2D> Points, TArray<bool>& OutInside) const;
+
+	/** Removes the points outside of the polygon in place, returns how many were removed */
+	int32 RemoveOutside(TArray<FVector2D>& Points) const;
+
+	/**
+	 * Distance from the point to the nearest edge, or MaxDistance if every edge is further. Only the cells within
+	 * MaxDistance are looked at, so keep it small
+	 */
+	double GetDistanceToEdge(const FVector2D& Point, double MaxDistance) const;
+
+	/**
+	 * Covers the polygon with square cells, starting at the bounds' minimum. Only the cells touching the polygon
+	 * come back, as spans sorted by row then column, so the cost follows the polygon's area rather than its bounds.
+	 * False, with no spans, if the bounds hold more cells than can be covered
+	 */
+	bool GetScanlineSpans(double InCellSize, TArray<FSpatialPolygonSpan>& OutSpans, int32& OutNumX,
+	                      int32& OutNumY) const;
+
+	const FBox2D& GetBounds() const { return Bounds; }
+	bool IsEmpty() const { return Edges.Num() < 3 || !Bounds.bIsValid; }
+
+	int32 GetNumRings() const { return RingOffsets.Num(); }
+	int32 GetNumEdges() const { return Edges.Num(); }
+	TArrayView<const FVector2D> GetRing(int32 RingIndex) const;
+
+private:
+	struct FEdge
+	{
+		FVector2D A;
+		FVector2D B;
+	};
+
+	/** Calls Func(Row, Column) for every cell of a grid (origin at the bounds' minimum) the edge passes through */
+	template <typename FuncType>
+	void ForEachCell(const FEdge& Edge, const FVector2D& GridCellSize, int32 GridNumX, int32 GridNumY,
+	                 FuncType&& Func) const;
+
+	/** Even-odd state of the cell centres, one horizontal scan per row */
+	void ClassifyCellCentres();
+
+	FORCEINLINE int32 GetCellIndex(const FVector2D& Point) const;
+	FORCEINLINE FVector2D GetCellCentre(int32 CellIndex) const;
+	FORCEINLINE bool ContainsInCell(const FVector2D& Point, int32 CellIndex) const;
+
+	TArray<FVector2D> Vertices;
+	TArray<int32> RingOffsets;
+	TArray<FEdge> Edges;
+	FBox2D Bounds = FBox2D(ForceInit);
+
+	int32 NumCellsX = 0;
+	int32 NumCellsY = 0;
+	FVector2D CellSize = FVector2D::ZeroVector;
+	FVector2D InvCellSize = FVector2D::ZeroVector;
+
+	/** Edges of cell i are CellEdges[CellEdgeStart[i] .. CellEdgeStart[i + 1]) */
+	TArray<int32> CellEdgeStart;
+	TArray<int32> CellEdges;
+	TBitArray<> CellCentreInside;
+};
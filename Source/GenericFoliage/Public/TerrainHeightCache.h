@@ -0,0 +1,65 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+
+/**
+ * Terrain heights and normals sampled into fixed resolution tiles over geographic coordinates.
+ *
+ * The cache doesn't sample the terrain itself: the owner asks for the sample points of the tiles it is missing,
+ * resolves them however it resolves terrain and adds the results back. Queries are bilinear lookups into the
+ * resident tiles, the least recently used tile is evicted once the cache is full.
+ */
+class GENERICFOLIAGE_API FTerrainHeightCache
+{
+public:
+	FTerrainHeightCache();
+
+	/** Drops every tile and changes the layout. Tiles are TileSize wide with Resolution x Resolution samples */
+	void Reset(const FVector2D& InTileSize, int32 InResolution, int32 InMaxTiles);
+
+	/** Drops every tile, tiles being sampled for the current generation are ignored when they come back */
+	void Invalidate();
+
+	/** Drops the tiles overlapping the bounds */
+	void Invalidate(const FBox2D& Bounds);
+
+	bool IsInitialized() const { return Resolution > 1; }
+	int32 GetResolution() const { return Resolution; }
+	int32 GetMaxTiles() const { return Tiles.Max(); }
+	int32 Num() const { return Tiles.Num(); }
+
+	/** Bumped on every invalidation */
+	uint32 GetGeneration() const { return Generation; }
+
+	FIntPoint GetTileKey(const FVector2D& Point) const;
+	bool Contains(const FIntPoint& TileKey) const { return Tiles.Contains(TileKey); }
+
+	/** Appends the tile's Resolution x Resolution sample points, row major */
+	void GetTileSamplePoints(const FIntPoint& TileKey, TArray<FVector2D>& OutPoints) const;
+
+	/**
+	 * Adds a sampled tile, unless the cache was invalidated since Generation. Samples with a zero normal are missed
+	 * traces, lookups next to them miss too, and a tile without a single hit isn't added at all
+	 */
+	void AddTile(const FIntPoint& TileKey, TArrayView<const double> Heights, TArrayView<const FVector> Normals,
+	             uint32 InGeneration);
+
+	/** Bilinear height and normal at the point, false if its tile isn't resident or a surrounding sample missed */
+	bool Sample(const FVector2D& Point, double& OutHeight, FVector& OutNormal);
+
+private:
+	struct FTile
+	{
+		TArray<float> Heights;
+		TArray<FVector3f> Normals;
+	};
+
+	FVector2D TileSize = FVector2D::UnitVector;
+	int32 Resolution = 0;
+	uint32 Generation = 0;
+
+	TLruCache<FIntPoint, TSharedPtr<const FTile>> Tiles;
+};
@@ -0,0 +1,76 @@
+// Copyright Aiden. S. All Rights Reserved
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSpatialPolygon;
+
+/**
+ * Poisson disc sampling within a polygon where the minimum distance varies over it, e.g. thinning out towards the
+ * edge of a forest or following a density raster.
+ *
+ * Each point gets its radius from the radius function where it lands, and two points are kept at least the smaller
+ * of their radii apart. Points are kept in one grid per octave of radius, with cells sized for the smallest radius of
+ * their octave, so a candidate looks at a few cells per octave whatever the spread of radii, and the sparse parts
+ * don't pay for a grid sized to the densest one. The polygon must outlive the sampler.
+ */
+class GENERICFOLIAGE_API FVariablePoissonSampler
+{
+public:
+	/** Minimum distance at a point, clamped to [MinRadius, MaxRadius] */
+	using FRadiusFunction = TFunction<double(const FVector2D&)>;
+
+	FVariablePoissonSampler(const FSpatialPolygon& InPolygon, double InMinRadius, double InMaxRadius,
+	                        FRadiusFunction InRadiusAt, int32 InRejectionThreshold = 30, int32 InSeed = 0);
+
+	void Sample();
+
+	const TArray<FVector2D>& GetPoints() const { return Points; }
+
+	/**
+	 * Radius for a relative density in [0, 1], MaxRadius at 0 and MinRadius at 1. Points per area follow the
+	 * density linearly, so the radius goes with one over its square root
+	 */
+	static double GetRadiusForDensity(double Density, double MinRadius, double MaxRadius);
+
+	/** Density ramping up from 0 at the polygon's edge to 1 at FalloffDistance inside it */
+	static FRadiusFunction MakeEdgeFalloff(const FSpatialPolygon& Polygon, double MinRadius, double MaxRadius,
+	                                       double FalloffDistance);
+
+	/** Density from a raster laid over the bounds, row major from the bounds' minimum, bilinearly filtered */
+	static FRadiusFunction MakeDensityRaster(TArray<float> Densities, const FIntPoint& Size, const FBox2D& Bounds,
+	                                         double MinRadius, double MaxRadius);
+
+private:
+	struct FLevel
+	{
+		double CellSize = 1.0;
+		double InvCellSize = 1.0;
+
+		/** Largest radius of a point in this level */
+		double MaxRadius = 1.0;
+
+		int32 NumX = 0;
+		int32 NumY = 0;
+
+		/** Index + 1 of the point in each cell, 0 for empty */
+		TArray<int32> Cells;
+	};
+
+	/** Adds the candidate if it's inside and far enough from every point, false otherwise */
+	bool TryAdd(const FVector2D& Candidate, TArray<int32>& ActivePoints);
+
+	const FSpatialPolygon& Polygon;
+	double MinRadius;
+	double MaxRadius;
+	FRadiusFunction RadiusAt;
+	int32 RejectionThreshold;
+	FRandomStream RandomStream;
+
+	FVector2D Origin = FVector2D::ZeroVector;
+	TArray<FLevel> Levels;
+
+	TArray<FVector2D> Points;
+	TArray<double> Radii;
+};